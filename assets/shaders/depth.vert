@@ -0,0 +1,20 @@
+#version 450
+#extension GL_EXT_multiview : require
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 model;
+} ubo;
+
+layout(binding = 1) uniform ViewBuffer {
+    mat4 view[2];
+    mat4 proj[2];
+} views;
+
+layout(location = 0) in vec3 inPosition;
+
+// Must compute gl_Position exactly like shader.vert.
+invariant gl_Position;
+
+void main() {
+    gl_Position = (views.proj[gl_ViewIndex] * views.view[gl_ViewIndex] * ubo.model) * vec4(inPosition, 1.0);
+}
\ No newline at end of file
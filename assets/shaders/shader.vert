@@ -1,15 +1,23 @@
 #version 450
+#extension GL_EXT_multiview : require
 
 layout(binding = 0) uniform UniformBufferObject {
     mat4 model;
-    mat4 view;
-    mat4 proj;
 } ubo;
 
+// Cameras of the views rendered by the pass, one without multiview.
+layout(binding = 1) uniform ViewBuffer {
+    mat4 view[2];
+    mat4 proj[2];
+} views;
+
 layout(location = 0) in vec3 inPosition;
 
 layout(location = 0) out vec3 fragColor;
 
+// Matches depth.vert bit for bit, so the equal test after a depth pre-pass passes.
+invariant gl_Position;
+
 vec3 colors[3] = vec3[](
     vec3(1.0, 0.0, 0.0),
     vec3(0.0, 1.0, 0.0),
@@ -17,7 +25,7 @@ vec3 colors[3] = vec3[](
 );
 
 void main() {
-    gl_Position = (ubo.proj * ubo.view * ubo.model) * vec4(inPosition, 1.0);
+    gl_Position = (views.proj[gl_ViewIndex] * views.view[gl_ViewIndex] * ubo.model) * vec4(inPosition, 1.0);
 
     fragColor = colors[gl_VertexIndex % 3];
 }
\ No newline at end of file
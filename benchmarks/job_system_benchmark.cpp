@@ -0,0 +1,141 @@
+// Measures the scheduling overhead per job of the job system: empty jobs started from outside the system,
+// jobs started by workers, parallel_for ranges and chains of dependent jobs. Every case checks that all of
+// its jobs ran.
+//
+// Usage: job_system_benchmark [jobs] [--pin]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "platform/job_system.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+using vre::platform::JobCounter;
+using vre::platform::JobSystem;
+
+constexpr int kRepetitions = 5;
+constexpr size_t kChainLength = 1000;
+
+double ToNanoseconds(Clock::duration duration) {
+  return std::chrono::duration<double, std::nano>(duration).count();
+}
+
+// Runs |fn| a few times and returns the best time per job, |fn| returns how many jobs ran.
+template <typename Fn>
+double Measure(size_t jobs, Fn fn, bool &passed) {
+  double best = 0.0;
+  for (int i = 0; i < kRepetitions; i++) {
+    const auto start = Clock::now();
+    const auto ran = fn();
+    const auto time = ToNanoseconds(Clock::now() - start) / double(jobs);
+    if (ran != jobs) {
+      SPDLOG_ERROR("{} of {} jobs ran", ran, jobs);
+      passed = false;
+    }
+    best = i == 0 ? time : std::min(best, time);
+  }
+  return best;
+}
+
+}  // namespace
+
+int main(int argc, const char **argv) {
+  size_t jobs = 100000;
+  JobSystem::Config config;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--pin") == 0) {
+      config.pin_workers = true;
+    } else {
+      jobs = std::stoul(argv[i]);
+    }
+  }
+
+  JobSystem system(config);
+  spdlog::info("{} workers{}, {} jobs", system.GetWorkerCount(), config.pin_workers ? " pinned" : "", jobs);
+
+  bool passed = true;
+  std::atomic<size_t> ran{0};
+
+  const auto external = Measure(
+      jobs,
+      [&] {
+        ran = 0;
+        JobCounter counter;
+        for (size_t i = 0; i < jobs; i++) {
+          system.Run([&ran] { ran.fetch_add(1, std::memory_order_relaxed); }, &counter);
+        }
+        system.Wait(counter);
+        return ran.load();
+      },
+      passed);
+  spdlog::info("Started from the main thread: {:.1f} ns per job", external);
+
+  // One job per worker starts its share of the jobs, which the others steal.
+  const auto nested = Measure(
+      jobs,
+      [&] {
+        ran = 0;
+        const size_t spawners = system.GetWorkerCount() + 1;
+        JobCounter counter;
+        for (size_t spawner = 0; spawner < spawners; spawner++) {
+          const auto begin = jobs * spawner / spawners;
+          const auto end = jobs * (spawner + 1) / spawners;
+          system.Run(
+              [&, begin, end] {
+                JobCounter children;
+                for (size_t i = begin; i < end; i++) {
+                  system.Run([&ran] { ran.fetch_add(1, std::memory_order_relaxed); }, &children);
+                }
+                system.Wait(children);
+              },
+              &counter);
+        }
+        system.Wait(counter);
+        return ran.load();
+      },
+      passed);
+  spdlog::info("Started from workers: {:.1f} ns per job", nested);
+
+  const auto parallel_for = Measure(
+      jobs,
+      [&] {
+        ran = 0;
+        system.ParallelFor(jobs, [&ran](size_t) { ran.fetch_add(1, std::memory_order_relaxed); });
+        return ran.load();
+      },
+      passed);
+  spdlog::info("ParallelFor: {:.1f} ns per item", parallel_for);
+
+  // Every link only starts once the previous one finished, this is the latency of a dependency.
+  const auto chain = Measure(
+      kChainLength,
+      [&] {
+        ran = 0;
+        std::vector<JobCounter> counters(kChainLength);
+        system.Run([&ran] { ran.fetch_add(1, std::memory_order_relaxed); }, &counters[0]);
+        for (size_t i = 1; i < kChainLength; i++) {
+          system.RunAfter(counters[i - 1], [&ran] { ran.fetch_add(1, std::memory_order_relaxed); },
+                          &counters[i]);
+        }
+        system.Wait(counters.back());
+        // Earlier links release their counters before starting the next one, so they are done too.
+        return ran.load();
+      },
+      passed);
+  spdlog::info("Dependency chain: {:.1f} ns per link", chain);
+
+  if (!passed) {
+    spdlog::error("Some jobs did not run");
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
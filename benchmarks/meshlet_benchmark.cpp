@@ -0,0 +1,160 @@
+// Compares triangles submitted with and without meshlet culling against the triangles that actually get
+// rasterized, for a dense sphere seen from viewpoints around it.
+//
+// Usage: meshlet_benchmark [segments]
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <spdlog/spdlog.h>
+
+#include "geometry/mesh_optimizer.hpp"
+#include "geometry/meshlets.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kViewCount = 64;
+constexpr float kViewDistance = 3.0F;
+
+void BuildSphere(uint32_t segments, std::vector<glm::vec3> &positions, std::vector<uint32_t> &indices) {
+  const auto rings = segments / 2;
+  for (uint32_t ring = 0; ring <= rings; ring++) {
+    const auto theta = glm::pi<float>() * float(ring) / float(rings);
+    for (uint32_t segment = 0; segment <= segments; segment++) {
+      const auto phi = glm::two_pi<float>() * float(segment) / float(segments);
+      positions.emplace_back(std::sin(theta) * std::cos(phi), std::cos(theta),
+                             std::sin(theta) * std::sin(phi));
+    }
+  }
+
+  for (uint32_t ring = 0; ring < rings; ring++) {
+    for (uint32_t segment = 0; segment < segments; segment++) {
+      const auto a = ring * (segments + 1) + segment;
+      const auto b = a + segments + 1;
+      // Counter-clockwise seen from outside.
+      indices.insert(indices.end(), {a, a + 1, b, a + 1, b + 1, b});
+    }
+  }
+}
+
+struct Frustum {
+  std::array<glm::vec4, 4> planes;
+
+  explicit Frustum(const glm::mat4 &view_projection) {
+    const auto row = [&](int i) {
+      return glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i],
+                       view_projection[3][i]);
+    };
+    planes = {row(3) + row(0), row(3) - row(0), row(3) + row(1), row(3) - row(1)};
+    for (auto &plane : planes) {
+      plane /= glm::length(glm::vec3(plane));
+    }
+  }
+
+  [[nodiscard]] bool IsVisible(const glm::vec3 &center, float radius) const {
+    for (const auto &plane : planes) {
+      if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+// What a rasterizer keeps with back face culling: front facing triangles that touch the frustum.
+bool IsRasterized(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c, const glm::vec3 &eye,
+                  const Frustum &frustum) {
+  if (glm::dot(glm::cross(b - a, c - a), a - eye) >= 0.0F) {
+    return false;
+  }
+  for (const auto &plane : frustum.planes) {
+    const auto outside = [&](const glm::vec3 &p) { return glm::dot(glm::vec3(plane), p) + plane.w < 0.0F; };
+    if (outside(a) && outside(b) && outside(c)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+double ToMilliseconds(Clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+}  // namespace
+
+int main(int argc, const char **argv) {
+  const uint32_t segments = argc > 1 ? static_cast<uint32_t>(std::stoul(argv[1])) : 512;
+
+  std::vector<glm::vec3> positions;
+  std::vector<uint32_t> indices;
+  BuildSphere(segments, positions, indices);
+  const auto triangle_count = indices.size() / 3;
+
+  auto start = Clock::now();
+  vre::geometry::OptimizeTriangleList(positions, indices);
+  const auto optimize_time = Clock::now() - start;
+
+  start = Clock::now();
+  vre::geometry::MeshletData data;
+  vre::geometry::BuildMeshlets(positions.data(), indices.data(), indices.size(), data);
+  const auto build_time = Clock::now() - start;
+
+  spdlog::info("{} triangles, {} meshlets ({:.1f} triangles, {:.1f} vertices on average)", triangle_count,
+               data.meshlets.size(), double(triangle_count) / double(data.meshlets.size()),
+               double(data.vertices.size()) / double(data.meshlets.size()));
+  spdlog::info("optimize {:.2f} ms, build meshlets {:.2f} ms", ToMilliseconds(optimize_time),
+               ToMilliseconds(build_time));
+
+  uint64_t frustum_triangles = 0;
+  uint64_t culled_triangles = 0;
+  uint64_t rasterized_triangles = 0;
+  Clock::duration cull_time{};
+
+  const auto projection = glm::perspective(glm::radians(45.0F), 1.0F, 0.01F, 100.0F);
+  for (int view = 0; view < kViewCount; view++) {
+    // Orbits the sphere and moves along its axis so the frustum cuts through it in some views.
+    const auto angle = glm::two_pi<float>() * float(view) / float(kViewCount);
+    const auto eye = glm::vec3(std::cos(angle) * kViewDistance, std::sin(angle * 3.0F),
+                               std::sin(angle) * kViewDistance);
+    const auto target = glm::vec3(0.0F, 0.0F, std::sin(angle * 2.0F) * 0.5F);
+    const Frustum frustum(projection * glm::lookAt(eye, target, glm::vec3(0.0F, 1.0F, 0.0F)));
+
+    start = Clock::now();
+    for (size_t i = 0; i < data.meshlets.size(); i++) {
+      const auto &bounds = data.bounds[i];
+      if (!frustum.IsVisible(bounds.center, bounds.radius)) {
+        continue;
+      }
+      frustum_triangles += data.meshlets[i].triangle_count;
+      if (!vre::geometry::IsBackfacing(bounds, eye)) {
+        culled_triangles += data.meshlets[i].triangle_count;
+      }
+    }
+    cull_time += Clock::now() - start;
+
+    for (size_t i = 0; i < indices.size(); i += 3) {
+      rasterized_triangles += IsRasterized(positions[indices[i]], positions[indices[i + 1]],
+                                           positions[indices[i + 2]], eye, frustum);
+    }
+  }
+
+  const auto per_view = [](uint64_t count) { return double(count) / kViewCount; };
+  spdlog::info("per view: submitted {:.0f} without culling, {:.0f} with frustum culling, {:.0f} with "
+               "frustum and cone culling; {:.0f} rasterized",
+               double(triangle_count), per_view(frustum_triangles), per_view(culled_triangles),
+               per_view(rasterized_triangles));
+  spdlog::info("rasterized / submitted: {:.2f} without culling, {:.2f} with meshlet culling",
+               per_view(rasterized_triangles) / double(triangle_count),
+               double(rasterized_triangles) / double(culled_triangles));
+  spdlog::info("meshlet culling {:.3f} ms per view", ToMilliseconds(cull_time) / kViewCount);
+
+  return EXIT_SUCCESS;
+}
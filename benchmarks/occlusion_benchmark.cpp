@@ -0,0 +1,123 @@
+// Times the CPU occlusion rasterizer on a street of building-sized occluders with a grid of small instances
+// behind them, and checks a few instances whose visibility is known.
+//
+// Usage: occlusion_benchmark [frames]
+
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <spdlog/spdlog.h>
+
+#include "geometry/occlusion_rasterizer.hpp"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int kBuildingCount = 32;
+constexpr int kInstanceGridSize = 128;
+
+struct Box {
+  glm::vec3 min;
+  glm::vec3 max;
+};
+
+// Unit cube around the origin, 12 triangles.
+void BuildCube(std::vector<glm::vec3> &positions, std::vector<uint32_t> &indices) {
+  for (int i = 0; i < 8; i++) {
+    positions.emplace_back((i & 1) != 0 ? 0.5F : -0.5F, (i & 2) != 0 ? 0.5F : -0.5F,
+                           (i & 4) != 0 ? 0.5F : -0.5F);
+  }
+  indices = {0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6, 0, 1, 4, 1, 5, 4,
+             2, 6, 3, 3, 6, 7, 0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5};
+}
+
+glm::mat4 BoxTransform(const Box &box) {
+  return glm::scale(glm::translate(glm::mat4(1.0F), (box.min + box.max) * 0.5F), box.max - box.min);
+}
+
+double ToMilliseconds(Clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+}  // namespace
+
+int main(int argc, const char **argv) {
+  const int frames = argc > 1 ? std::stoi(argv[1]) : 1000;
+
+  std::vector<glm::vec3> cube_positions;
+  std::vector<uint32_t> cube_indices;
+  BuildCube(cube_positions, cube_indices);
+
+  // Two rows of buildings along the street, with a wall closing it at the end.
+  std::vector<glm::mat4> occluders;
+  for (int i = 0; i < kBuildingCount; i++) {
+    const auto z = -10.0F - 12.0F * float(i / 2);
+    const auto x = (i % 2) != 0 ? 12.0F : -12.0F;
+    occluders.push_back(BoxTransform({glm::vec3(x - 6.0F, -1.0F, z - 10.0F), glm::vec3(x + 6.0F, 30.0F, z)}));
+  }
+  occluders.push_back(BoxTransform({glm::vec3(-20.0F, -1.0F, -60.0F), glm::vec3(20.0F, 30.0F, -58.0F)}));
+
+  std::vector<Box> instances;
+  for (int x = 0; x < kInstanceGridSize; x++) {
+    for (int z = 0; z < kInstanceGridSize; z++) {
+      const auto min = glm::vec3(-128.0F + 2.0F * float(x), 0.0F, -2.0F - 2.0F * float(z));
+      instances.push_back({min, min + glm::vec3(1.0F)});
+    }
+  }
+
+  const auto projection = glm::perspective(glm::radians(60.0F), 2.0F, 0.1F, 1000.0F);
+  const auto view = glm::lookAt(glm::vec3(0.0F, 2.0F, 0.0F), glm::vec3(0.0F, 2.0F, -1.0F),
+                                glm::vec3(0.0F, 1.0F, 0.0F));
+
+  vre::geometry::OcclusionRasterizer rasterizer;
+  Clock::duration rasterize_time{};
+  Clock::duration test_time{};
+  size_t visible_count = 0;
+  for (int frame = 0; frame < frames; frame++) {
+    auto start = Clock::now();
+    rasterizer.Begin(projection * view);
+    for (const auto &transform : occluders) {
+      rasterizer.RasterizeTriangles(transform, cube_positions.data(), cube_indices.data(),
+                                    cube_indices.size());
+    }
+    rasterize_time += Clock::now() - start;
+
+    start = Clock::now();
+    visible_count = 0;
+    for (const auto &box : instances) {
+      visible_count += rasterizer.IsVisible(glm::mat4(1.0F), box.min, box.max);
+    }
+    test_time += Clock::now() - start;
+  }
+
+  spdlog::info("{} occluder triangles rasterized into {}x{}, {} of {} instances visible",
+               rasterizer.GetTriangleCount(), vre::geometry::OcclusionRasterizer::kWidth,
+               vre::geometry::OcclusionRasterizer::kHeight, visible_count, instances.size());
+  spdlog::info("rasterize {:.3f} ms, test {:.3f} ms ({:.1f} ns per instance) per frame",
+               ToMilliseconds(rasterize_time) / frames, ToMilliseconds(test_time) / frames,
+               ToMilliseconds(test_time) * 1e6 / (double(frames) * double(instances.size())));
+
+  // In the street, behind the end wall, inside a building and off screen to the side.
+  const std::array<std::pair<Box, bool>, 4> checks = {{
+      {{glm::vec3(-0.5F, 0.0F, -20.5F), glm::vec3(0.5F, 1.0F, -19.5F)}, true},
+      {{glm::vec3(-0.5F, 0.0F, -80.5F), glm::vec3(0.5F, 1.0F, -79.5F)}, false},
+      {{glm::vec3(-14.0F, 0.0F, -16.0F), glm::vec3(-12.0F, 2.0F, -14.0F)}, false},
+      {{glm::vec3(200.0F, 0.0F, -10.5F), glm::vec3(201.0F, 1.0F, -9.5F)}, false},
+  }};
+  bool passed = true;
+  for (const auto &[box, expected] : checks) {
+    if (rasterizer.IsVisible(glm::mat4(1.0F), box.min, box.max) != expected) {
+      spdlog::error("box ({}, {}, {}) should be {}", box.min.x, box.min.y, box.min.z,
+                    expected ? "visible" : "occluded");
+      passed = false;
+    }
+  }
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,6 +1,7 @@
 #include "application.hpp"
 
 #include <fstream>
+#include <thread>
 
 #include <vulkan/vulkan_core.h>
 
@@ -54,12 +55,36 @@ static void MouseKeyCallback(GLFWwindow *window, int button, int action, int mod
   app->ProcessMouseKey(window, button, action, mods);
 }
 
+static void FramebufferSizeCallback(GLFWwindow *window, int width, int height) {
+  auto *app = reinterpret_cast<Application *>(glfwGetWindowUserPointer(window));
+  app->ProcessFramebufferSize(window, width, height);
+}
+
 void Application::ProcessInput(GLFWwindow *window, int key, int /*scancode*/, int action, int /*mods*/) {
   if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
     glfwSetWindowShouldClose(window, GLFW_TRUE);
     return;
   }
 
+  if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+    render_core_.SetDepthPrePass(!render_core_.IsDepthPrePassEnabled());
+    spdlog::info("Depth pre-pass {}", render_core_.IsDepthPrePassEnabled() ? "enabled" : "disabled");
+    return;
+  }
+
+  if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+    main_scene_.SetSoftwareOcclusionCulling(!main_scene_.IsSoftwareOcclusionCullingEnabled());
+    spdlog::info("CPU occlusion culling {}",
+                 main_scene_.IsSoftwareOcclusionCullingEnabled() ? "enabled" : "disabled");
+    return;
+  }
+
+  if (key == GLFW_KEY_O && action == GLFW_PRESS) {
+    main_scene_.SetOcclusionCulling(!main_scene_.IsOcclusionCullingEnabled());
+    spdlog::info("Occlusion culling {}", main_scene_.IsOcclusionCullingEnabled() ? "enabled" : "disabled");
+    return;
+  }
+
   if (action == GLFW_PRESS) {
     UpdateControlsState(controlls_state_, key, true);
   }
@@ -87,10 +112,15 @@ void Application::ProcessMouseMove(GLFWwindow *window, double xpos, double ypos)
   last_mouse_pos_ = current_pos;
 }
 
+void Application::ProcessFramebufferSize(GLFWwindow * /*window*/, int width, int height) {
+  render_core_.SetFramebufferSize(static_cast<uint32_t>(width), static_cast<uint32_t>(height));
+}
+
 void Application::Run() {
   InitWindow();
-  render_core_.InitVulkan(window_);
+  render_core_.InitVulkan(window_, render_config_);
 
+  main_scene_.SetVertexFormat(rendering::VertexFormat::kSnorm16);
   main_scene_.LoadFromFile();
   main_scene_.CreateCamera();
   main_scene_.InitializeVulkan(render_core_);
@@ -103,18 +133,35 @@ void Application::InitWindow() {
   glfwInit();
 
   glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-  glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-  
+  glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+
   window_ = glfwCreateWindow(kWidth, kHeight, "Vulkan", nullptr, nullptr);
 
   glfwSetWindowUserPointer(window_, this);
   glfwSetKeyCallback(window_, KeyCallback);
   glfwSetMouseButtonCallback(window_, MouseKeyCallback);
   glfwSetCursorPosCallback(window_, MouseMoveCallback);
+  glfwSetFramebufferSizeCallback(window_, FramebufferSizeCallback);
 }
 
 void Application::MainLoop() {
+  std::thread render_thread([this] { RenderLoop(); });
+
   while (glfwWindowShouldClose(window_) == 0) {
+    // Nothing can be presented while minimized.
+    int width;
+    int height;
+    glfwGetFramebufferSize(window_, &width, &height);
+    if (width == 0 || height == 0) {
+      glfwWaitEvents();
+      continue;
+    }
+
+    if (render_config_.low_latency) {
+      // The render thread releases a snapshot once the GPU finished its frame, so nothing is queued in front
+      // of the frame simulated next.
+      snapshots_.WaitUntilRead();
+    }
     glfwPollEvents();
 
     constexpr float kStep = 0.1F;
@@ -154,17 +201,52 @@ void Application::MainLoop() {
     }
     mouse_move_ = {0, 0};
 
-    main_scene_.GetRootNode().childrens_.front()->transform_.rotation *=
-        glm::angleAxis(glm::radians(1.f), camera.GetUp());
-
-    auto context = render_core_.BeginDraw();
+    if (auto *model = main_scene_.GetSceneModel()) {
+      model->transform_.rotation *= glm::angleAxis(glm::radians(1.f), camera.GetUp());
+    }
 
-    main_scene_.Render(context);
+    // Frames the render thread already recorded pick up the new pose right before they are submitted.
+    main_scene_.PublishCameraPose();
 
-    render_core_.Present(context);
+    // Waits for the render thread to finish the frame before the previous one.
+    auto *snapshot = snapshots_.BeginWrite();
+    if (snapshot == nullptr) {
+      break;
+    }
+    main_scene_.Update(*snapshot);
+    snapshots_.EndWrite();
   }
 
+  snapshots_.Close();
+  render_thread.join();
   render_core_.WaitDeviceIdle();
+
+  if (render_error_) {
+    std::rethrow_exception(render_error_);
+  }
+}
+
+void Application::RenderLoop() {
+  try {
+    while (const auto *snapshot = snapshots_.BeginRead()) {
+      main_scene_.UploadMeshes(*snapshot);
+
+      // Snapshots taken just before the window was minimized are dropped.
+      if (auto context = render_core_.BeginFrame()) {
+        main_scene_.PrepareFrame(*context, *snapshot);
+        main_scene_.Render(*context);
+
+        render_core_.Present(*context);
+        if (render_config_.low_latency) {
+          render_core_.WaitForSubmittedFrames();
+        }
+      }
+      snapshots_.EndRead();
+    }
+  } catch (...) {
+    render_error_ = std::current_exception();
+    snapshots_.Close();
+  }
 }
 
 void Application::Cleanup() {
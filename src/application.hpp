@@ -1,9 +1,13 @@
 #pragma once
 
+#include <exception>
+
 #include "common.hpp"
 
+#include "platform/double_buffer.hpp"
 #include "rendering/buffers.hpp"
 #include "rendering/render_core.hpp"
+#include "scene/frame_snapshot.hpp"
 #include "scene/scene.hpp"
 
 namespace vre {
@@ -24,19 +28,27 @@ struct MousePos {
 
 class Application {
  public:
+  explicit Application(const rendering::RenderCore::Config &render_config) : render_config_(render_config) {}
+
   void Run();
 
   void ProcessInput(GLFWwindow *window, int key, int scancode, int action, int mods);
   void ProcessMouseKey(GLFWwindow *window, int button, int action, int mods);
   void ProcessMouseMove(GLFWwindow *window, double xpos, double ypos);
+  void ProcessFramebufferSize(GLFWwindow *window, int width, int height);
 
  protected:
   GLFWwindow *window_ = nullptr;
 
+  rendering::RenderCore::Config render_config_;
   rendering::RenderCore render_core_;
 
   scene::Scene main_scene_;
 
+  // The main thread simulates the next frame while the render thread draws the previous snapshot.
+  platform::DoubleBuffer<scene::FrameSnapshot> snapshots_;
+  std::exception_ptr render_error_;
+
   ControlsState controlls_state_;
 
   MousePos last_mouse_pos_;
@@ -48,6 +60,7 @@ class Application {
  private:
   void InitWindow();
   void MainLoop();
+  void RenderLoop();
 };
 
 }  // namespace vre
\ No newline at end of file
@@ -0,0 +1,286 @@
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+
+namespace vre::geometry {
+
+namespace {
+
+constexpr uint32_t kInvalidIndex = ~0U;
+
+struct PositionKey {
+  std::array<uint32_t, 3> bits;
+
+  explicit PositionKey(const glm::vec3 &position) {
+    for (int i = 0; i < 3; i++) {
+      // Adding zero folds -0.0 into +0.0 so both weld together.
+      const float value = position[i] + 0.0F;
+      std::memcpy(&bits[i], &value, sizeof(float));
+    }
+  }
+
+  bool operator==(const PositionKey &other) const { return bits == other.bits; }
+};
+
+struct PositionKeyHash {
+  size_t operator()(const PositionKey &key) const {
+    return (key.bits[0] * 73856093U) ^ (key.bits[1] * 19349663U) ^ (key.bits[2] * 83492791U);
+  }
+};
+
+// Scoring constants from the original article.
+constexpr int kMaxCacheSize = 32;
+constexpr float kCacheDecayPower = 1.5F;
+constexpr float kLastTriangleScore = 0.75F;
+constexpr float kValenceBoostScale = 2.0F;
+constexpr float kValenceBoostPower = 0.5F;
+
+float GetVertexScore(int cache_position, uint32_t remaining_valence) {
+  if (remaining_valence == 0) {
+    return -1.0F;
+  }
+
+  float score = 0.0F;
+  if (cache_position >= 0) {
+    if (cache_position < 3) {
+      score = kLastTriangleScore;
+    } else {
+      const float scaler = 1.0F / (kMaxCacheSize - 3);
+      score = std::pow(1.0F - float(cache_position - 3) * scaler, kCacheDecayPower);
+    }
+  }
+
+  return score + kValenceBoostScale * std::pow(float(remaining_valence), -kValenceBoostPower);
+}
+
+}  // namespace
+
+void VertexCacheStatistics::Add(const VertexCacheStatistics &other) {
+  triangle_count += other.triangle_count;
+  vertex_count += other.vertex_count;
+  vertices_transformed += other.vertices_transformed;
+  acmr = triangle_count != 0 ? float(vertices_transformed) / float(triangle_count) : 0.0F;
+  atvr = vertex_count != 0 ? float(vertices_transformed) / float(vertex_count) : 0.0F;
+}
+
+void OptimizationReport::Add(const OptimizationReport &other) {
+  before.Add(other.before);
+  after.Add(other.after);
+  welded_vertices += other.welded_vertices;
+  removed_triangles += other.removed_triangles;
+}
+
+VertexCacheStatistics AnalyzeVertexCache(const uint32_t *indices, size_t index_count, size_t vertex_count,
+                                         uint32_t cache_size) {
+  VertexCacheStatistics statistics{};
+  statistics.triangle_count = static_cast<uint32_t>(index_count / 3);
+
+  // Timestamp of the moment each vertex entered the FIFO; it is still cached while younger than the cache.
+  std::vector<uint32_t> cached_at(vertex_count, kInvalidIndex);
+  std::vector<bool> referenced(vertex_count, false);
+  uint32_t time = 0;
+
+  for (size_t i = 0; i < index_count; i++) {
+    const auto index = indices[i];
+    if (!referenced[index]) {
+      referenced[index] = true;
+      statistics.vertex_count++;
+    }
+
+    if (cached_at[index] == kInvalidIndex || time - cached_at[index] >= cache_size) {
+      cached_at[index] = time++;
+      statistics.vertices_transformed++;
+    }
+  }
+
+  if (statistics.triangle_count != 0) {
+    statistics.acmr = float(statistics.vertices_transformed) / float(statistics.triangle_count);
+  }
+  if (statistics.vertex_count != 0) {
+    statistics.atvr = float(statistics.vertices_transformed) / float(statistics.vertex_count);
+  }
+
+  return statistics;
+}
+
+uint32_t WeldVertices(std::vector<glm::vec3> &positions, std::vector<uint32_t> &indices,
+                      uint32_t &removed_triangles) {
+  std::unordered_map<PositionKey, uint32_t, PositionKeyHash> unique;
+  unique.reserve(positions.size());
+
+  std::vector<uint32_t> remap(positions.size());
+  std::vector<glm::vec3> welded;
+  welded.reserve(positions.size());
+  for (size_t i = 0; i < positions.size(); i++) {
+    const auto next = static_cast<uint32_t>(welded.size());
+    const auto [it, inserted] = unique.emplace(PositionKey(positions[i]), next);
+    if (inserted) {
+      welded.push_back(positions[i]);
+    }
+    remap[i] = it->second;
+  }
+
+  size_t write = 0;
+  for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+    const auto a = remap[indices[i]];
+    const auto b = remap[indices[i + 1]];
+    const auto c = remap[indices[i + 2]];
+    if (a == b || b == c || a == c) {
+      removed_triangles++;
+      continue;
+    }
+
+    indices[write++] = a;
+    indices[write++] = b;
+    indices[write++] = c;
+  }
+  indices.resize(write);
+
+  const auto merged = static_cast<uint32_t>(positions.size() - welded.size());
+  positions = std::move(welded);
+  return merged;
+}
+
+void OptimizeVertexCache(std::vector<uint32_t> &indices, size_t vertex_count) {
+  const size_t triangle_count = indices.size() / 3;
+  if (triangle_count == 0) {
+    return;
+  }
+
+  // Triangles adjacent to every vertex, stored as one array with per vertex offsets.
+  std::vector<uint32_t> valence(vertex_count, 0);
+  for (const auto index : indices) {
+    valence[index]++;
+  }
+
+  std::vector<uint32_t> adjacency_offset(vertex_count + 1, 0);
+  for (size_t i = 0; i < vertex_count; i++) {
+    adjacency_offset[i + 1] = adjacency_offset[i] + valence[i];
+  }
+
+  std::vector<uint32_t> adjacency(indices.size());
+  {
+    std::vector<uint32_t> fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++) {
+      adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+  }
+
+  std::vector<int> cache_position(vertex_count, -1);
+  std::vector<float> vertex_score(vertex_count);
+  for (size_t i = 0; i < vertex_count; i++) {
+    vertex_score[i] = GetVertexScore(-1, valence[i]);
+  }
+
+  std::vector<float> triangle_score(triangle_count);
+  std::vector<bool> emitted(triangle_count, false);
+  for (size_t i = 0; i < triangle_count; i++) {
+    triangle_score[i] =
+        vertex_score[indices[i * 3]] + vertex_score[indices[i * 3 + 1]] + vertex_score[indices[i * 3 + 2]];
+  }
+
+  std::vector<uint32_t> result;
+  result.reserve(indices.size());
+
+  std::vector<uint32_t> cache;
+  std::vector<uint32_t> next_cache;
+  cache.reserve(kMaxCacheSize + 3);
+  next_cache.reserve(kMaxCacheSize + 3);
+
+  size_t scan_cursor = 0;
+  auto best_triangle = kInvalidIndex;
+
+  while (result.size() < indices.size()) {
+    if (best_triangle == kInvalidIndex) {
+      // Nothing useful in the cache, continue with the next triangle in input order.
+      while (emitted[scan_cursor]) {
+        scan_cursor++;
+      }
+      best_triangle = static_cast<uint32_t>(scan_cursor);
+    }
+
+    emitted[best_triangle] = true;
+    const uint32_t *triangle = &indices[best_triangle * 3];
+
+    next_cache.clear();
+    for (int i = 0; i < 3; i++) {
+      const auto vertex = triangle[i];
+      result.push_back(vertex);
+      next_cache.push_back(vertex);
+
+      // Remove the triangle from the vertex adjacency so only live triangles are scored.
+      auto *begin = &adjacency[adjacency_offset[vertex]];
+      auto *end = begin + valence[vertex];
+      *std::find(begin, end, best_triangle) = *(end - 1);
+      valence[vertex]--;
+    }
+    for (const auto vertex : cache) {
+      if (vertex != triangle[0] && vertex != triangle[1] && vertex != triangle[2]) {
+        next_cache.push_back(vertex);
+      }
+    }
+    std::swap(cache, next_cache);
+
+    // Vertices pushed out of the cache lose their cache bonus.
+    for (size_t i = 0; i < cache.size(); i++) {
+      const auto vertex = cache[i];
+      cache_position[vertex] = i < kMaxCacheSize ? static_cast<int>(i) : -1;
+      vertex_score[vertex] = GetVertexScore(cache_position[vertex], valence[vertex]);
+    }
+
+    best_triangle = kInvalidIndex;
+    float best_score = -1.0F;
+    for (const auto vertex : cache) {
+      for (uint32_t i = 0; i < valence[vertex]; i++) {
+        const auto t = adjacency[adjacency_offset[vertex] + i];
+        triangle_score[t] = vertex_score[indices[t * 3]] + vertex_score[indices[t * 3 + 1]] +
+                            vertex_score[indices[t * 3 + 2]];
+        if (triangle_score[t] > best_score) {
+          best_score = triangle_score[t];
+          best_triangle = t;
+        }
+      }
+    }
+
+    if (cache.size() > kMaxCacheSize) {
+      cache.resize(kMaxCacheSize);
+    }
+  }
+
+  indices = std::move(result);
+}
+
+void OptimizeVertexFetch(std::vector<glm::vec3> &positions, std::vector<uint32_t> &indices) {
+  std::vector<uint32_t> remap(positions.size(), kInvalidIndex);
+  std::vector<glm::vec3> reordered;
+  reordered.reserve(positions.size());
+
+  for (auto &index : indices) {
+    if (remap[index] == kInvalidIndex) {
+      remap[index] = static_cast<uint32_t>(reordered.size());
+      reordered.push_back(positions[index]);
+    }
+    index = remap[index];
+  }
+
+  positions = std::move(reordered);
+}
+
+OptimizationReport OptimizeTriangleList(std::vector<glm::vec3> &positions, std::vector<uint32_t> &indices) {
+  OptimizationReport report{};
+  report.before = AnalyzeVertexCache(indices.data(), indices.size(), positions.size());
+
+  report.welded_vertices = WeldVertices(positions, indices, report.removed_triangles);
+  OptimizeVertexCache(indices, positions.size());
+  OptimizeVertexFetch(positions, indices);
+
+  report.after = AnalyzeVertexCache(indices.data(), indices.size(), positions.size());
+  return report;
+}
+
+}  // namespace vre::geometry
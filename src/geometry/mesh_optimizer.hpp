@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace vre::geometry {
+
+struct VertexCacheStatistics {
+  uint32_t triangle_count = 0;
+  uint32_t vertex_count = 0;
+  uint32_t vertices_transformed = 0;
+
+  // Average cache miss ratio (transformed vertices per triangle, 0.5 at best) and average transformed
+  // vertex ratio (transformed vertices per unique vertex, 1.0 at best).
+  float acmr = 0.0F;
+  float atvr = 0.0F;
+
+  void Add(const VertexCacheStatistics &other);
+};
+
+struct OptimizationReport {
+  VertexCacheStatistics before;
+  VertexCacheStatistics after;
+  uint32_t welded_vertices = 0;
+  uint32_t removed_triangles = 0;
+
+  void Add(const OptimizationReport &other);
+};
+
+// Simulates a FIFO post-transform cache of |cache_size| entries.
+VertexCacheStatistics AnalyzeVertexCache(const uint32_t *indices, size_t index_count, size_t vertex_count,
+                                         uint32_t cache_size = 16);
+
+// Merges vertices with identical positions and drops triangles that become degenerate. Returns the
+// number of merged vertices.
+uint32_t WeldVertices(std::vector<glm::vec3> &positions, std::vector<uint32_t> &indices,
+                      uint32_t &removed_triangles);
+
+// Reorders triangles for the post-transform vertex cache (Forsyth, "Linear-Speed Vertex Cache
+// Optimisation").
+void OptimizeVertexCache(std::vector<uint32_t> &indices, size_t vertex_count);
+
+// Reorders vertices in order of first use so vertex fetch walks memory linearly; unreferenced vertices are
+// dropped.
+void OptimizeVertexFetch(std::vector<glm::vec3> &positions, std::vector<uint32_t> &indices);
+
+// Runs all of the above on a triangle list with indices local to |positions|.
+OptimizationReport OptimizeTriangleList(std::vector<glm::vec3> &positions, std::vector<uint32_t> &indices);
+
+}  // namespace vre::geometry
@@ -0,0 +1,270 @@
+#include "mesh_simplifier.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace vre::geometry {
+
+namespace {
+
+constexpr uint32_t kInvalidIndex = ~0U;
+
+// Symmetric 4x4 matrix of the plane equation products, weighted by triangle area. Dividing by the total
+// weight turns the error into a mean squared distance that does not grow with the number of planes.
+struct Quadric {
+  double a2 = 0, b2 = 0, c2 = 0, d2 = 0;
+  double ab = 0, ac = 0, ad = 0, bc = 0, bd = 0, cd = 0;
+  double weight = 0;
+
+  static Quadric FromPlane(const glm::dvec3 &normal, double d, double weight) {
+    Quadric q;
+    q.weight = weight;
+    q.a2 = normal.x * normal.x;
+    q.b2 = normal.y * normal.y;
+    q.c2 = normal.z * normal.z;
+    q.d2 = d * d;
+    q.ab = normal.x * normal.y;
+    q.ac = normal.x * normal.z;
+    q.ad = normal.x * d;
+    q.bc = normal.y * normal.z;
+    q.bd = normal.y * d;
+    q.cd = normal.z * d;
+    for (auto *value : {&q.a2, &q.b2, &q.c2, &q.d2, &q.ab, &q.ac, &q.ad, &q.bc, &q.bd, &q.cd}) {
+      *value *= weight;
+    }
+    return q;
+  }
+
+  void Add(const Quadric &other) {
+    a2 += other.a2;
+    b2 += other.b2;
+    c2 += other.c2;
+    d2 += other.d2;
+    ab += other.ab;
+    ac += other.ac;
+    ad += other.ad;
+    bc += other.bc;
+    bd += other.bd;
+    cd += other.cd;
+    weight += other.weight;
+  }
+
+  [[nodiscard]] double Evaluate(const glm::vec3 &p) const {
+    const double x = p.x;
+    const double y = p.y;
+    const double z = p.z;
+    const double result = a2 * x * x + b2 * y * y + c2 * z * z + d2 + 2 * (ab * x * y + ac * x * z + ad * x) +
+                          2 * (bc * y * z + bd * y + cd * z);
+    return weight > 0.0 ? std::max(result, 0.0) / weight : 0.0;
+  }
+};
+
+struct Collapse {
+  uint32_t from;
+  uint32_t to;
+  double cost;
+};
+
+uint64_t GetEdgeKey(uint32_t a, uint32_t b) {
+  return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+}
+
+uint32_t Resolve(std::vector<uint32_t> &remap, uint32_t vertex) {
+  while (remap[vertex] != vertex) {
+    vertex = remap[vertex];
+  }
+  return vertex;
+}
+
+glm::vec3 GetNormal(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c) {
+  return glm::cross(b - a, c - a);
+}
+
+// Rejects collapses that flip or degenerate any remaining triangle around |from|.
+bool IsCollapseValid(const glm::vec3 *positions, const std::vector<uint32_t> &indices,
+                     const std::vector<uint32_t> &adjacency_offset, const std::vector<uint32_t> &adjacency,
+                     uint32_t from, uint32_t to) {
+  for (uint32_t i = adjacency_offset[from]; i < adjacency_offset[from + 1]; i++) {
+    const uint32_t *triangle = &indices[adjacency[i] * 3];
+    if (triangle[0] == to || triangle[1] == to || triangle[2] == to) {
+      continue;
+    }
+
+    glm::vec3 corners[3];
+    for (int c = 0; c < 3; c++) {
+      corners[c] = positions[triangle[c]];
+    }
+    const auto before = GetNormal(corners[0], corners[1], corners[2]);
+    for (int c = 0; c < 3; c++) {
+      if (triangle[c] == from) {
+        corners[c] = positions[to];
+      }
+    }
+    const auto after = GetNormal(corners[0], corners[1], corners[2]);
+
+    if (glm::dot(before, after) <= 0.0F) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+std::vector<uint32_t> SimplifyTriangleList(const glm::vec3 *positions, size_t vertex_count,
+                                           const std::vector<uint32_t> &indices, size_t target_index_count,
+                                           float max_error, float &result_error) {
+  result_error = 0.0F;
+
+  std::vector<Quadric> quadrics(vertex_count);
+  std::unordered_map<uint64_t, uint32_t> edge_use;
+  edge_use.reserve(indices.size());
+  for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+    const glm::dvec3 a = positions[indices[i]];
+    const glm::dvec3 b = positions[indices[i + 1]];
+    const glm::dvec3 c = positions[indices[i + 2]];
+
+    const auto cross = glm::cross(b - a, c - a);
+    const auto length = glm::length(cross);
+    if (length > 0.0) {
+      const auto normal = cross / length;
+      const auto plane = Quadric::FromPlane(normal, -glm::dot(normal, a), length * 0.5);
+      for (int c = 0; c < 3; c++) {
+        quadrics[indices[i + c]].Add(plane);
+      }
+    }
+
+    for (int e = 0; e < 3; e++) {
+      edge_use[GetEdgeKey(indices[i + e], indices[i + (e + 1) % 3])]++;
+    }
+  }
+
+  std::vector<bool> border(vertex_count, false);
+  for (const auto &[key, count] : edge_use) {
+    if (count == 1) {
+      border[key >> 32] = true;
+      border[key & 0xFFFFFFFF] = true;
+    }
+  }
+
+  std::vector<uint32_t> remap(vertex_count);
+  for (uint32_t i = 0; i < vertex_count; i++) {
+    remap[i] = i;
+  }
+
+  const double max_cost = double(max_error) * double(max_error);
+  double largest_cost = 0.0;
+
+  auto result = indices;
+  std::vector<Collapse> collapses;
+  std::vector<uint32_t> adjacency_offset(vertex_count + 1);
+  std::vector<uint32_t> adjacency;
+  std::vector<bool> touched(vertex_count);
+
+  while (result.size() > target_index_count) {
+    // Vertex to triangle adjacency of the current triangles.
+    std::fill(adjacency_offset.begin(), adjacency_offset.end(), 0);
+    for (const auto index : result) {
+      adjacency_offset[index + 1]++;
+    }
+    for (size_t i = 0; i < vertex_count; i++) {
+      adjacency_offset[i + 1] += adjacency_offset[i];
+    }
+    adjacency.resize(result.size());
+    {
+      std::vector<uint32_t> fill(adjacency_offset.begin(), adjacency_offset.end() - 1);
+      for (size_t i = 0; i < result.size(); i++) {
+        adjacency[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+      }
+    }
+
+    collapses.clear();
+    for (size_t i = 0; i < result.size(); i += 3) {
+      for (int e = 0; e < 3; e++) {
+        const auto a = result[i + e];
+        const auto b = result[i + (e + 1) % 3];
+        // Every interior edge is shared by two triangles in opposite directions, visit it once.
+        if (a > b && !border[a] && !border[b]) {
+          continue;
+        }
+
+        Collapse best{kInvalidIndex, kInvalidIndex, std::numeric_limits<double>::max()};
+        for (const auto &[from, to] : {std::pair{a, b}, std::pair{b, a}}) {
+          if (border[from]) {
+            continue;
+          }
+          auto quadric = quadrics[from];
+          quadric.Add(quadrics[to]);
+          const auto cost = quadric.Evaluate(positions[to]);
+          if (cost < best.cost) {
+            best = {from, to, cost};
+          }
+        }
+
+        if (best.from != kInvalidIndex && best.cost <= max_cost) {
+          collapses.push_back(best);
+        }
+      }
+    }
+
+    if (collapses.empty()) {
+      break;
+    }
+
+    std::sort(collapses.begin(), collapses.end(),
+              [](const Collapse &lhs, const Collapse &rhs) { return lhs.cost < rhs.cost; });
+
+    // Every collapse removes about two triangles; independent collapses are applied in one pass.
+    const size_t triangles_to_remove = (result.size() - target_index_count) / 3;
+    size_t removed = 0;
+    std::fill(touched.begin(), touched.end(), false);
+    for (const auto &collapse : collapses) {
+      if (removed >= triangles_to_remove) {
+        break;
+      }
+      if (touched[collapse.from] || touched[collapse.to] ||
+          !IsCollapseValid(positions, result, adjacency_offset, adjacency, collapse.from, collapse.to)) {
+        continue;
+      }
+
+      // Neighbours of both vertices change, keep them out of this pass.
+      for (const auto vertex : {collapse.from, collapse.to}) {
+        for (uint32_t i = adjacency_offset[vertex]; i < adjacency_offset[vertex + 1]; i++) {
+          for (int c = 0; c < 3; c++) {
+            touched[result[adjacency[i] * 3 + c]] = true;
+          }
+        }
+      }
+
+      remap[collapse.from] = collapse.to;
+      quadrics[collapse.to].Add(quadrics[collapse.from]);
+      largest_cost = std::max(largest_cost, collapse.cost);
+      removed += 2;
+    }
+
+    if (removed == 0) {
+      break;
+    }
+
+    size_t write = 0;
+    for (size_t i = 0; i < result.size(); i += 3) {
+      const auto a = Resolve(remap, result[i]);
+      const auto b = Resolve(remap, result[i + 1]);
+      const auto c = Resolve(remap, result[i + 2]);
+      if (a == b || b == c || a == c) {
+        continue;
+      }
+
+      result[write++] = a;
+      result[write++] = b;
+      result[write++] = c;
+    }
+    result.resize(write);
+  }
+
+  result_error = static_cast<float>(std::sqrt(largest_cost));
+  return result;
+}
+
+}  // namespace vre::geometry
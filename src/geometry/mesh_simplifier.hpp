@@ -0,0 +1,18 @@
+#pragma once
+
+#include <vector>
+
+#include "common.hpp"
+
+namespace vre::geometry {
+
+// Reduces a triangle list to about |target_index_count| indices with quadric error metric edge
+// collapses (Garland & Heckbert). Vertices are only collapsed onto other existing vertices, so the result
+// indexes the same vertex buffer. Border vertices are kept in place to avoid opening holes. Collapses
+// costing more than |max_error| (object space distance) are skipped; |result_error| receives the
+// largest error introduced.
+std::vector<uint32_t> SimplifyTriangleList(const glm::vec3 *positions, size_t vertex_count,
+                                           const std::vector<uint32_t> &indices, size_t target_index_count,
+                                           float max_error, float &result_error);
+
+}  // namespace vre::geometry
@@ -0,0 +1,125 @@
+#include "meshlets.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace vre::geometry {
+
+namespace {
+
+constexpr uint8_t kUnused = 0xFF;
+
+MeshletBounds ComputeBounds(const glm::vec3 *positions, const uint32_t *indices, const Meshlet &meshlet,
+                            const MeshletData &data) {
+  MeshletBounds bounds{};
+
+  glm::vec3 min(std::numeric_limits<float>::max());
+  glm::vec3 max(std::numeric_limits<float>::lowest());
+  for (uint32_t i = 0; i < meshlet.vertex_count; i++) {
+    const auto &position = positions[data.vertices[meshlet.vertex_offset + i]];
+    min = glm::min(min, position);
+    max = glm::max(max, position);
+  }
+
+  bounds.center = (min + max) * 0.5F;
+  for (uint32_t i = 0; i < meshlet.vertex_count; i++) {
+    const auto &position = positions[data.vertices[meshlet.vertex_offset + i]];
+    bounds.radius = std::max(bounds.radius, glm::distance(bounds.center, position));
+  }
+
+  std::vector<glm::vec3> normals;
+  normals.reserve(meshlet.triangle_count);
+  glm::vec3 axis(0.0F);
+  for (uint32_t i = 0; i < meshlet.triangle_count; i++) {
+    const auto *triangle = indices + meshlet.index_offset + i * 3;
+    const auto &a = positions[triangle[0]];
+    const auto normal = glm::cross(positions[triangle[1]] - a, positions[triangle[2]] - a);
+    const auto length = glm::length(normal);
+    if (length > 0.0F) {
+      normals.push_back(normal / length);
+      axis += normals.back();
+    }
+  }
+
+  const auto axis_length = glm::length(axis);
+  if (normals.empty() || axis_length == 0.0F) {
+    return bounds;
+  }
+  bounds.cone_axis = axis / axis_length;
+
+  float min_dot = 1.0F;
+  for (const auto &normal : normals) {
+    min_dot = std::min(min_dot, glm::dot(normal, bounds.cone_axis));
+  }
+
+  // A cone wider than a hemisphere can never be culled.
+  bounds.cone_cutoff = min_dot <= 0.0F ? 1.0F : std::sqrt(1.0F - min_dot * min_dot);
+  return bounds;
+}
+
+}  // namespace
+
+void BuildMeshlets(const glm::vec3 *positions, const uint32_t *indices, size_t index_count,
+                   MeshletData &data) {
+  if (index_count == 0) {
+    return;
+  }
+
+  const auto vertex_count = *std::max_element(indices, indices + index_count) + 1;
+  // Local index of every vertex in the meshlet being built.
+  std::vector<uint8_t> local(vertex_count, kUnused);
+
+  const auto begin_meshlet = [&](uint32_t index_offset) {
+    Meshlet meshlet{};
+    meshlet.index_offset = index_offset;
+    meshlet.vertex_offset = static_cast<uint32_t>(data.vertices.size());
+    meshlet.triangle_offset = static_cast<uint32_t>(data.triangles.size());
+    return meshlet;
+  };
+
+  const auto finish_meshlet = [&](const Meshlet &meshlet) {
+    for (uint32_t i = 0; i < meshlet.vertex_count; i++) {
+      local[data.vertices[meshlet.vertex_offset + i]] = kUnused;
+    }
+    // Keeps triangle data of every meshlet 4-byte aligned for shaders reading it as uints.
+    data.triangles.resize((data.triangles.size() + 3) & ~size_t(3));
+
+    data.meshlets.push_back(meshlet);
+    data.bounds.push_back(ComputeBounds(positions, indices, meshlet, data));
+  };
+
+  auto meshlet = begin_meshlet(0);
+  for (size_t i = 0; i + 2 < index_count; i += 3) {
+    const auto *triangle = indices + i;
+    const uint32_t new_vertices = (local[triangle[0]] == kUnused) + (local[triangle[1]] == kUnused) +
+                                  (local[triangle[2]] == kUnused);
+
+    if (meshlet.vertex_count + new_vertices > kMaxMeshletVertices ||
+        meshlet.triangle_count == kMaxMeshletTriangles) {
+      finish_meshlet(meshlet);
+      meshlet = begin_meshlet(static_cast<uint32_t>(i));
+    }
+
+    for (int c = 0; c < 3; c++) {
+      auto &slot = local[triangle[c]];
+      if (slot == kUnused) {
+        slot = static_cast<uint8_t>(meshlet.vertex_count++);
+        data.vertices.push_back(triangle[c]);
+      }
+      data.triangles.push_back(slot);
+    }
+    meshlet.triangle_count++;
+  }
+
+  if (meshlet.triangle_count != 0) {
+    finish_meshlet(meshlet);
+  }
+}
+
+bool IsBackfacing(const MeshletBounds &bounds, const glm::vec3 &camera_position) {
+  const auto direction = bounds.center - camera_position;
+  return glm::dot(direction, bounds.cone_axis) >= bounds.cone_cutoff * glm::length(direction) + bounds.radius;
+}
+
+}  // namespace vre::geometry
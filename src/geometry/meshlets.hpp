@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace vre::geometry {
+
+constexpr uint32_t kMaxMeshletVertices = 64;
+constexpr uint32_t kMaxMeshletTriangles = 124;
+
+// Meshlets cover consecutive triangles of the source index list, so a meshlet can be drawn straight from
+// the original index buffer (|index_offset|, 3 * |triangle_count|) or, with mesh shaders, from its own
+// vertex list and 8-bit local triangles.
+struct Meshlet {
+  uint32_t index_offset = 0;
+  uint32_t triangle_count = 0;
+
+  uint32_t vertex_offset = 0;  // Into MeshletData::vertices.
+  uint32_t vertex_count = 0;
+  uint32_t triangle_offset = 0;  // Into MeshletData::triangles, in bytes.
+};
+
+struct MeshletBounds {
+  glm::vec3 center = glm::vec3(0.0F);
+  float radius = 0.0F;
+
+  // Every triangle faces away from a viewer at |position| when
+  // dot(center - position, cone_axis) >= cone_cutoff * length(center - position) + radius.
+  glm::vec3 cone_axis = glm::vec3(0.0F, 0.0F, 1.0F);
+  float cone_cutoff = 1.0F;
+};
+
+struct MeshletData {
+  std::vector<Meshlet> meshlets;
+  std::vector<MeshletBounds> bounds;
+  std::vector<uint32_t> vertices;
+  std::vector<uint8_t> triangles;
+};
+
+// Splits a triangle list into meshlets, appending to |data|. Run vertex cache optimization first: the
+// triangle order is kept, so locality of the input decides how full the meshlets get.
+void BuildMeshlets(const glm::vec3 *positions, const uint32_t *indices, size_t index_count,
+                   MeshletData &data);
+
+[[nodiscard]] bool IsBackfacing(const MeshletBounds &bounds, const glm::vec3 &camera_position);
+
+}  // namespace vre::geometry
@@ -0,0 +1,217 @@
+#include "occlusion_rasterizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace vre::geometry {
+
+namespace {
+
+constexpr int kColumns = static_cast<int>(OcclusionRasterizer::kWidth);
+constexpr int kRows = static_cast<int>(OcclusionRasterizer::kHeight);
+constexpr int kLaneCount = 8;
+static_assert(kColumns % kLaneCount == 0, "Rows are processed in groups of 8 pixels");
+
+// Vertices with a smaller clip space w are treated as behind the camera.
+constexpr float kMinW = 1e-5F;
+
+struct ScreenVertex {
+  float x = 0.0F;
+  float y = 0.0F;
+  float z = 0.0F;
+};
+
+// False for vertices behind the near plane.
+bool Project(const glm::mat4 &transform, const glm::vec3 &position, ScreenVertex &vertex) {
+  const auto clip = transform * glm::vec4(position, 1.0F);
+  if (clip.w < kMinW || clip.z < 0.0F) {
+    return false;
+  }
+
+  const auto inv_w = 1.0F / clip.w;
+  vertex.x = (clip.x * inv_w * 0.5F + 0.5F) * float(kColumns);
+  vertex.y = (clip.y * inv_w * 0.5F + 0.5F) * float(kRows);
+  vertex.z = clip.z * inv_w;
+  return true;
+}
+
+// Clamped before the conversion, projected coordinates get arbitrarily large close to the camera plane.
+int ToPixel(float value, int size) {
+  return static_cast<int>(std::clamp(value, -1.0F, float(size)));
+}
+
+// a * x + b * y + c, positive to the left of |from| -> |to|.
+struct Edge {
+  float a;
+  float b;
+  float c;
+
+  Edge(const ScreenVertex &from, const ScreenVertex &to)
+      : a(from.y - to.y), b(to.x - from.x), c(-(a * from.x + b * from.y)) {}
+
+  [[nodiscard]] float Evaluate(float x, float y) const { return a * x + b * y + c; }
+};
+
+void RasterizeTriangle(ScreenVertex v0, ScreenVertex v1, ScreenVertex v2, float *depth) {
+  const auto area = Edge(v0, v1).Evaluate(v2.x, v2.y);
+  if (!(area != 0.0F)) {
+    return;
+  }
+  if (area < 0.0F) {
+    std::swap(v1, v2);
+  }
+
+  const auto min_x = std::max(ToPixel(std::floor(std::min({v0.x, v1.x, v2.x})), kColumns), 0);
+  const auto max_x = std::min(ToPixel(std::ceil(std::max({v0.x, v1.x, v2.x})), kColumns), kColumns - 1);
+  const auto min_y = std::max(ToPixel(std::floor(std::min({v0.y, v1.y, v2.y})), kRows), 0);
+  const auto max_y = std::min(ToPixel(std::ceil(std::max({v0.y, v1.y, v2.y})), kRows), kRows - 1);
+  if (min_x > max_x || min_y > max_y) {
+    return;
+  }
+
+  const Edge e0(v1, v2);
+  const Edge e1(v2, v0);
+  const Edge e2(v0, v1);
+  // The farthest depth of the triangle keeps the buffer conservative without interpolating.
+  const auto z = std::max({v0.z, v1.z, v2.z});
+
+#if defined(__AVX2__)
+  const auto lane_centers = _mm256_setr_ps(0.5F, 1.5F, 2.5F, 3.5F, 4.5F, 5.5F, 6.5F, 7.5F);
+  const auto a0 = _mm256_set1_ps(e0.a);
+  const auto a1 = _mm256_set1_ps(e1.a);
+  const auto a2 = _mm256_set1_ps(e2.a);
+  const auto zero = _mm256_setzero_ps();
+  const auto triangle_z = _mm256_set1_ps(z);
+
+  for (int y = min_y; y <= max_y; y++) {
+    const auto py = float(y) + 0.5F;
+    const auto row0 = _mm256_set1_ps(e0.b * py + e0.c);
+    const auto row1 = _mm256_set1_ps(e1.b * py + e1.c);
+    const auto row2 = _mm256_set1_ps(e2.b * py + e2.c);
+
+    float *row = depth + y * kColumns;
+    for (int x = min_x & ~(kLaneCount - 1); x <= max_x; x += kLaneCount) {
+      const auto px = _mm256_add_ps(_mm256_set1_ps(float(x)), lane_centers);
+      const auto w0 = _mm256_add_ps(_mm256_mul_ps(a0, px), row0);
+      const auto w1 = _mm256_add_ps(_mm256_mul_ps(a1, px), row1);
+      const auto w2 = _mm256_add_ps(_mm256_mul_ps(a2, px), row2);
+      const auto inside = _mm256_and_ps(
+          _mm256_and_ps(_mm256_cmp_ps(w0, zero, _CMP_GE_OQ), _mm256_cmp_ps(w1, zero, _CMP_GE_OQ)),
+          _mm256_cmp_ps(w2, zero, _CMP_GE_OQ));
+
+      const auto previous = _mm256_loadu_ps(row + x);
+      _mm256_storeu_ps(row + x, _mm256_blendv_ps(previous, _mm256_min_ps(previous, triangle_z), inside));
+    }
+  }
+#else
+  for (int y = min_y; y <= max_y; y++) {
+    const auto py = float(y) + 0.5F;
+    float *row = depth + y * kColumns;
+    for (int x = min_x; x <= max_x; x++) {
+      const auto px = float(x) + 0.5F;
+      if (e0.Evaluate(px, py) >= 0.0F && e1.Evaluate(px, py) >= 0.0F && e2.Evaluate(px, py) >= 0.0F) {
+        row[x] = std::min(row[x], z);
+      }
+    }
+  }
+#endif
+}
+
+}  // namespace
+
+OcclusionRasterizer::OcclusionRasterizer() : depth_(kColumns * kRows, 1.0F) {}
+
+void OcclusionRasterizer::Begin(const glm::mat4 &view_projection) {
+  view_projection_ = view_projection;
+  std::fill(depth_.begin(), depth_.end(), 1.0F);
+  triangle_count_ = 0;
+}
+
+void OcclusionRasterizer::RasterizeTriangles(const glm::mat4 &transform, const glm::vec3 *positions,
+                                             const uint32_t *indices, size_t index_count) {
+  const auto model_view_projection = view_projection_ * transform;
+  for (size_t i = 0; i + 2 < index_count; i += 3) {
+    ScreenVertex v0;
+    ScreenVertex v1;
+    ScreenVertex v2;
+    if (!Project(model_view_projection, positions[indices[i]], v0) ||
+        !Project(model_view_projection, positions[indices[i + 1]], v1) ||
+        !Project(model_view_projection, positions[indices[i + 2]], v2)) {
+      continue;
+    }
+
+    RasterizeTriangle(v0, v1, v2, depth_.data());
+    triangle_count_++;
+  }
+}
+
+bool OcclusionRasterizer::IsVisible(const glm::mat4 &transform, const glm::vec3 &min,
+                                    const glm::vec3 &max) const {
+  const auto model_view_projection = view_projection_ * transform;
+
+  ScreenVertex rect_min{std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+                        std::numeric_limits<float>::max()};
+  ScreenVertex rect_max{std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), 0.0F};
+  for (int i = 0; i < 8; i++) {
+    const glm::vec3 corner((i & 1) != 0 ? max.x : min.x, (i & 2) != 0 ? max.y : min.y,
+                           (i & 4) != 0 ? max.z : min.z);
+    ScreenVertex vertex;
+    if (!Project(model_view_projection, corner, vertex)) {
+      return true;
+    }
+
+    rect_min.x = std::min(rect_min.x, vertex.x);
+    rect_min.y = std::min(rect_min.y, vertex.y);
+    rect_min.z = std::min(rect_min.z, vertex.z);
+    rect_max.x = std::max(rect_max.x, vertex.x);
+    rect_max.y = std::max(rect_max.y, vertex.y);
+  }
+
+  // Every pixel the rectangle touches has to be covered by a nearer occluder.
+  const auto min_x = std::max(ToPixel(std::floor(rect_min.x), kColumns), 0);
+  const auto max_x = std::min(ToPixel(std::floor(rect_max.x), kColumns), kColumns - 1);
+  const auto min_y = std::max(ToPixel(std::floor(rect_min.y), kRows), 0);
+  const auto max_y = std::min(ToPixel(std::floor(rect_max.y), kRows), kRows - 1);
+  if (min_x > max_x || min_y > max_y) {
+    return false;
+  }
+
+#if defined(__AVX2__)
+  const auto lane_indices = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+  const auto first = _mm256_set1_epi32(min_x - 1);
+  const auto last = _mm256_set1_epi32(max_x + 1);
+  const auto box_z = _mm256_set1_ps(rect_min.z);
+
+  for (int y = min_y; y <= max_y; y++) {
+    const float *row = depth_.data() + y * kColumns;
+    for (int x = min_x & ~(kLaneCount - 1); x <= max_x; x += kLaneCount) {
+      const auto lanes = _mm256_add_epi32(_mm256_set1_epi32(x), lane_indices);
+      const auto in_rect =
+          _mm256_and_si256(_mm256_cmpgt_epi32(lanes, first), _mm256_cmpgt_epi32(last, lanes));
+      const auto nearer = _mm256_cmp_ps(box_z, _mm256_loadu_ps(row + x), _CMP_LE_OQ);
+      if (_mm256_movemask_ps(_mm256_and_ps(nearer, _mm256_castsi256_ps(in_rect))) != 0) {
+        return true;
+      }
+    }
+  }
+#else
+  for (int y = min_y; y <= max_y; y++) {
+    const float *row = depth_.data() + y * kColumns;
+    for (int x = min_x; x <= max_x; x++) {
+      if (rect_min.z <= row[x]) {
+        return true;
+      }
+    }
+  }
+#endif
+
+  return false;
+}
+
+}  // namespace vre::geometry
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+namespace vre::geometry {
+
+// Coarse CPU occlusion culling: occluder triangles are rasterized into a small depth buffer, then bounding
+// boxes are tested against it. Occluders write the farthest depth of each triangle, so a box is only
+// reported hidden behind surfaces that cover the centers of all pixels it touches. Uses AVX2 when the
+// build enables it (VR_ENABLE_AVX2), 8 pixels of a row at a time.
+//
+// Depth follows Vulkan clip space (0 at the near plane); triangles crossing the near plane are skipped
+// and boxes crossing it are always visible.
+class OcclusionRasterizer {
+ public:
+  static constexpr uint32_t kWidth = 256;
+  static constexpr uint32_t kHeight = 128;
+
+  OcclusionRasterizer();
+
+  // Clears the depth buffer for a new view.
+  void Begin(const glm::mat4 &view_projection);
+
+  // |indices| index |positions| directly, three per triangle. Both windings are rasterized.
+  void RasterizeTriangles(const glm::mat4 &transform, const glm::vec3 *positions, const uint32_t *indices,
+                          size_t index_count);
+
+  // False when the box |min|, |max| in the space of |transform| is off screen or behind the occluders.
+  [[nodiscard]] bool IsVisible(const glm::mat4 &transform, const glm::vec3 &min, const glm::vec3 &max) const;
+
+  [[nodiscard]] const std::vector<float> &GetDepth() const { return depth_; }
+  [[nodiscard]] uint32_t GetTriangleCount() const { return triangle_count_; }
+
+ private:
+  glm::mat4 view_projection_ = glm::mat4(1.0F);
+  std::vector<float> depth_;
+  uint32_t triangle_count_ = 0;
+};
+
+}  // namespace vre::geometry
@@ -1,9 +1,12 @@
 #include <stdio.h>
+#include <cstdlib>
 #include <memory>
+#include <string>
 
 #include <spdlog/sinks/stdout_color_sinks.h>
 
 #include "application.hpp"
+#include "serialization/scene_cooker.hpp"
 
 #ifndef _WINDOWS
 #include <execinfo.h>
@@ -21,12 +24,85 @@ void Handler(int sig) {
 }
 #endif
 
-int main(const int /*argc*/, const char ** /*argv[]*/) {
+bool ParseRenderConfig(int argc, const char **argv, vre::rendering::RenderCore::Config &config) {
+  using PresentMode = vre::rendering::RenderCore::PresentMode;
+  auto &dynamic_resolution = config.dynamic_resolution;
+
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    const bool has_value = i + 1 < argc;
+    if (arg == "--low-latency") {
+      config.low_latency = true;
+    } else if (arg == "--stereo") {
+      config.stereo = true;
+    } else if (arg == "--frames-in-flight" && has_value) {
+      config.frames_in_flight = static_cast<uint32_t>(std::atoi(argv[++i]));
+    } else if (arg == "--swapchain-images" && has_value) {
+      config.swapchain_images = static_cast<uint32_t>(std::atoi(argv[++i]));
+    } else if (arg == "--dynamic-resolution" && has_value) {
+      dynamic_resolution.enabled = true;
+      dynamic_resolution.target_frame_ms = std::strtof(argv[++i], nullptr);
+    } else if (arg == "--min-render-scale" && has_value) {
+      dynamic_resolution.min_scale = std::strtof(argv[++i], nullptr);
+    } else if (arg == "--max-render-scale" && has_value) {
+      dynamic_resolution.max_scale = std::strtof(argv[++i], nullptr);
+    } else if (arg == "--render-scale-smoothing" && has_value) {
+      dynamic_resolution.smoothing = std::strtof(argv[++i], nullptr);
+    } else if (arg == "--present-mode" && has_value) {
+      const std::string mode = argv[++i];
+      if (mode == "fifo") {
+        config.present_mode = PresentMode::kFifo;
+      } else if (mode == "mailbox") {
+        config.present_mode = PresentMode::kMailbox;
+      } else if (mode == "immediate") {
+        config.present_mode = PresentMode::kImmediate;
+      } else {
+        spdlog::error("Unknown present mode {}", mode);
+        return false;
+      }
+    } else {
+      spdlog::error("Unknown argument {}", arg);
+      return false;
+    }
+  }
+
+  constexpr auto kMaxFramesInFlight = vre::rendering::RenderCore::kMaxFramesInFlight;
+  if (config.frames_in_flight < 1 || config.frames_in_flight > kMaxFramesInFlight) {
+    spdlog::error("--frames-in-flight has to be in [1, {}]", kMaxFramesInFlight);
+    return false;
+  }
+  if (dynamic_resolution.target_frame_ms <= 0.0F) {
+    spdlog::error("--dynamic-resolution needs a target GPU frame time in milliseconds");
+    return false;
+  }
+  if (dynamic_resolution.min_scale <= 0.0F || dynamic_resolution.min_scale > dynamic_resolution.max_scale ||
+      dynamic_resolution.max_scale > 1.0F) {
+    spdlog::error("Render scales have to satisfy 0 < --min-render-scale <= --max-render-scale <= 1");
+    return false;
+  }
+  if (dynamic_resolution.smoothing <= 0.0F || dynamic_resolution.smoothing > 1.0F) {
+    spdlog::error("--render-scale-smoothing has to be in (0, 1]");
+    return false;
+  }
+
+  return true;
+}
+
+int main(const int argc, const char **argv) {
   //signal(SIGSEGV, Handler);
 
+  if (argc == 4 && std::string(argv[1]) == "--cook") {
+    return vre::serialization::SceneCooker::Cook(argv[2], argv[3]) ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  vre::rendering::RenderCore::Config render_config;
+  if (!ParseRenderConfig(argc, argv, render_config)) {
+    return EXIT_FAILURE;
+  }
+
   spdlog::info("Start");
 
-  vre::Application app;
+  vre::Application app(render_config);
 
   try {
     app.Run();
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+
+namespace vre::platform {
+
+// Hands values from a producer thread to a consumer thread, in order. The producer fills one buffer while the
+// consumer reads the other, and waits once it is a whole buffer ahead.
+template <typename T>
+class DoubleBuffer {
+ public:
+  DoubleBuffer() = default;
+
+  DoubleBuffer(DoubleBuffer &) = delete;
+  DoubleBuffer(DoubleBuffer &&) = delete;
+
+  // Waits until the consumer released the buffer, null once closed. The buffer keeps what was written to it
+  // two values ago.
+  T *BeginWrite() {
+    std::unique_lock lock(mutex_);
+    changed_.wait(lock, [this] { return closed_ || !ready_[write_]; });
+    return closed_ ? nullptr : &buffers_[write_];
+  }
+
+  void EndWrite() {
+    {
+      std::lock_guard lock(mutex_);
+      ready_[write_] = true;
+      write_ ^= 1;
+    }
+    changed_.notify_all();
+  }
+
+  // Waits for the next value, null once closed.
+  const T *BeginRead() {
+    std::unique_lock lock(mutex_);
+    changed_.wait(lock, [this] { return closed_ || ready_[read_]; });
+    return closed_ ? nullptr : &buffers_[read_];
+  }
+
+  void EndRead() {
+    {
+      std::lock_guard lock(mutex_);
+      ready_[read_] = false;
+      read_ ^= 1;
+    }
+    changed_.notify_all();
+  }
+
+  // Waits until the consumer released every value written so far.
+  void WaitUntilRead() {
+    std::unique_lock lock(mutex_);
+    changed_.wait(lock, [this] { return closed_ || (!ready_[0] && !ready_[1]); });
+  }
+
+  // Wakes up both sides, every Begin call returns null from now on.
+  void Close() {
+    {
+      std::lock_guard lock(mutex_);
+      closed_ = true;
+    }
+    changed_.notify_all();
+  }
+
+ private:
+  T buffers_[2];
+  bool ready_[2] = {false, false};
+  unsigned write_ = 0;
+  unsigned read_ = 0;
+  bool closed_ = false;
+
+  std::mutex mutex_;
+  std::condition_variable changed_;
+};
+
+}  // namespace vre::platform
@@ -0,0 +1,277 @@
+#include "job_system.hpp"
+
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <spdlog/spdlog.h>
+
+namespace vre::platform {
+
+namespace {
+
+// More ranges than threads, so stealing evens out ranges that take longer.
+constexpr size_t kRangesPerThread = 4;
+
+thread_local const JobSystem *current_system = nullptr;
+thread_local uint32_t current_worker = 0;
+
+JobSystem::Config default_config;
+std::atomic<bool> default_created{false};
+
+void PinThread(std::thread &thread, uint32_t core) {
+#ifdef _WIN32
+  const bool pinned = SetThreadAffinityMask(thread.native_handle(), DWORD_PTR(1) << (core % 64)) != 0;
+#elif defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(core, &set);
+  const bool pinned = pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) == 0;
+#else
+  // macOS only takes affinity hints between threads.
+  const bool pinned = false;
+#endif
+  if (!pinned) {
+    SPDLOG_WARN("Could not pin a worker to core {}", core);
+  }
+}
+
+}  // namespace
+
+JobSystem::JobSystem(const Config &config) {
+  for (uint32_t i = 0; i < config.worker_count + 1; i++) {
+    queues_.push_back(std::make_unique<Queue>());
+  }
+
+  const auto cores = std::max(1U, std::thread::hardware_concurrency());
+  workers_.reserve(config.worker_count);
+  for (uint32_t i = 0; i < config.worker_count; i++) {
+    workers_.emplace_back([this, i] { WorkerLoop(i); });
+    if (config.pin_workers) {
+      PinThread(workers_.back(), (config.first_core + i) % cores);
+    }
+  }
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard lock(sleep_mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+void JobSystem::ConfigureDefault(const Config &config) {
+  if (default_created) {
+    throw std::runtime_error("The default job system is already running");
+  }
+  default_config = config;
+}
+
+JobSystem &JobSystem::Default() {
+  static JobSystem system(default_config);
+  default_created = true;
+  return system;
+}
+
+void JobSystem::Run(Job job, JobCounter *counter) {
+  if (counter) {
+    counter->pending_.fetch_add(1, std::memory_order_relaxed);
+  }
+  Push({std::move(job), counter});
+}
+
+void JobSystem::RunAfter(JobCounter &dependency, Job job, JobCounter *counter) {
+  if (counter) {
+    counter->pending_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  {
+    std::lock_guard lock(dependency.mutex_);
+    if (dependency.pending_.load(std::memory_order_acquire) != 0) {
+      dependency.dependents_.emplace_back(std::move(job), counter);
+      return;
+    }
+  }
+
+  Push({std::move(job), counter});
+}
+
+void JobSystem::Wait(JobCounter &counter) {
+  const auto queue_index = GetQueueIndex();
+  const auto *only = current_system == this ? nullptr : &counter;
+  while (!counter.IsDone()) {
+    if (!TryRunOne(queue_index, only)) {
+      std::this_thread::yield();
+    }
+  }
+
+  // The job that finished last may not have released the counter yet.
+  std::lock_guard lock(counter.mutex_);
+  if (counter.error_) {
+    std::rethrow_exception(std::exchange(counter.error_, nullptr));
+  }
+}
+
+void JobSystem::ParallelFor(size_t count, const std::function<void(size_t)> &fn) {
+  ParallelForRanges(count, 1, [&fn](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      fn(i);
+    }
+  });
+}
+
+void JobSystem::ParallelForRanges(size_t count, size_t min_range,
+                                  const std::function<void(size_t, size_t)> &fn) {
+  if (count == 0) {
+    return;
+  }
+
+  const size_t max_ranges = (workers_.size() + 1) * kRangesPerThread;
+  const size_t range_count = std::clamp<size_t>(count / std::max<size_t>(min_range, 1), 1, max_ranges);
+  if (range_count == 1) {
+    fn(0, count);
+    return;
+  }
+
+  JobCounter counter;
+  for (size_t range = 1; range < range_count; range++) {
+    const auto begin = count * range / range_count;
+    const auto end = count * (range + 1) / range_count;
+    Run([&fn, begin, end] { fn(begin, end); }, &counter);
+  }
+
+  // The other ranges refer to |fn| and |counter|, they have to finish before an exception leaves.
+  std::exception_ptr error;
+  try {
+    fn(0, count / range_count);
+  } catch (...) {
+    error = std::current_exception();
+  }
+
+  Wait(counter);
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+void JobSystem::Push(Task task) {
+  auto &queue = *queues_[GetQueueIndex()];
+  {
+    std::lock_guard lock(queue.mutex);
+    queue.tasks.push_back(std::move(task));
+  }
+
+  // Pairs with the check of |queued_| by a worker going to sleep, one of the two sees the other.
+  queued_.fetch_add(1);
+  if (sleeping_.load() != 0) {
+    { std::lock_guard lock(sleep_mutex_); }
+    wake_.notify_one();
+  }
+}
+
+bool JobSystem::TryRunOne(uint32_t queue_index, const JobCounter *only) {
+  Task task;
+  if (!Pop(queue_index, only, task) && (only || !Steal(queue_index, task))) {
+    return false;
+  }
+
+  // A throwing job still has to finish its counter, otherwise its waiter spins forever.
+  std::exception_ptr error;
+  try {
+    task.job();
+  } catch (...) {
+    error = std::current_exception();
+  }
+
+  if (task.counter) {
+    Finish(*task.counter, error);
+  } else if (error) {
+    SPDLOG_ERROR("A job without a counter threw, the exception is dropped");
+  }
+  return true;
+}
+
+bool JobSystem::Pop(uint32_t queue_index, const JobCounter *only, Task &task) {
+  auto &queue = *queues_[queue_index];
+  std::lock_guard lock(queue.mutex);
+  if (queue.tasks.empty() || (only && queue.tasks.back().counter != only)) {
+    return false;
+  }
+
+  task = std::move(queue.tasks.back());
+  queue.tasks.pop_back();
+  queued_.fetch_sub(1);
+  return true;
+}
+
+bool JobSystem::Steal(uint32_t queue_index, Task &task) {
+  const auto queue_count = static_cast<uint32_t>(queues_.size());
+  for (uint32_t i = 1; i < queue_count; i++) {
+    auto &queue = *queues_[(queue_index + i) % queue_count];
+    std::lock_guard lock(queue.mutex);
+    if (queue.tasks.empty()) {
+      continue;
+    }
+
+    task = std::move(queue.tasks.front());
+    queue.tasks.pop_front();
+    queued_.fetch_sub(1);
+    return true;
+  }
+
+  return false;
+}
+
+void JobSystem::Finish(JobCounter &counter, std::exception_ptr error) {
+  std::vector<std::pair<Job, JobCounter *>> dependents;
+  {
+    std::lock_guard lock(counter.mutex_);
+    if (error && !counter.error_) {
+      counter.error_ = std::move(error);
+    }
+    if (counter.pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      dependents = std::exchange(counter.dependents_, {});
+    }
+  }
+
+  for (auto &[job, dependent_counter] : dependents) {
+    Push({std::move(job), dependent_counter});
+  }
+}
+
+void JobSystem::WorkerLoop(uint32_t index) {
+  current_system = this;
+  current_worker = index;
+
+  while (true) {
+    if (TryRunOne(index, nullptr)) {
+      continue;
+    }
+
+    std::unique_lock lock(sleep_mutex_);
+    if (stopping_) {
+      return;
+    }
+
+    sleeping_.fetch_add(1);
+    wake_.wait(lock, [this] { return stopping_ || queued_.load() != 0; });
+    sleeping_.fetch_sub(1);
+  }
+}
+
+uint32_t JobSystem::GetQueueIndex() const {
+  return current_system == this ? current_worker : static_cast<uint32_t>(queues_.size() - 1);
+}
+
+}  // namespace vre::platform
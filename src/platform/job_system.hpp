@@ -0,0 +1,114 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vre::platform {
+
+using Job = std::function<void()>;
+
+// Number of unfinished jobs signalling it. Jobs can be started once a counter reaches zero, which is how
+// dependencies are expressed. A counter has to outlive its jobs, i.e. be waited on before it is destroyed.
+class JobCounter {
+ public:
+  JobCounter() = default;
+
+  JobCounter(JobCounter &) = delete;
+  JobCounter(JobCounter &&) = delete;
+
+  [[nodiscard]] bool IsDone() const { return pending_.load(std::memory_order_acquire) == 0; }
+
+ private:
+  friend class JobSystem;
+
+  std::atomic<uint32_t> pending_{0};
+  // Guards the transition to zero against jobs added to |dependents_|.
+  std::mutex mutex_;
+  std::vector<std::pair<Job, JobCounter *>> dependents_;
+  // First exception thrown by one of the jobs, rethrown by Wait().
+  std::exception_ptr error_;
+};
+
+// Work-stealing job system. Every worker pushes and pops its own jobs at the back of its deque and steals
+// from the front of the others when it runs out, threads outside the system share one more deque. Waiting
+// threads run jobs instead of blocking, so jobs can wait for the jobs they start. Threads outside the system
+// only run the jobs they wait for, the main thread never picks up e.g. a long running load.
+class JobSystem {
+ public:
+  struct Config {
+    // At least one, so jobs started outside the system always make progress.
+    uint32_t worker_count = std::max(2U, std::thread::hardware_concurrency()) - 1;
+    // Pins worker i to core (first_core + i) modulo the core count. The main thread is not pinned.
+    bool pin_workers = false;
+    uint32_t first_core = 1;
+  };
+
+  explicit JobSystem(const Config &config);
+  ~JobSystem();
+
+  JobSystem(JobSystem &) = delete;
+  JobSystem(JobSystem &&) = delete;
+
+  // Applies to the shared system, has to be called before its first use.
+  static void ConfigureDefault(const Config &config);
+  static JobSystem &Default();
+
+  [[nodiscard]] uint32_t GetWorkerCount() const { return static_cast<uint32_t>(workers_.size()); }
+
+  // Starts |job|. |counter| is incremented right away and decremented once the job finished.
+  void Run(Job job, JobCounter *counter = nullptr);
+
+  // Starts |job| once |dependency| reached zero, it must not be incremented again before that.
+  void RunAfter(JobCounter &dependency, Job job, JobCounter *counter = nullptr);
+
+  // Runs jobs until |counter| reaches zero, then rethrows the first exception thrown by its jobs.
+  void Wait(JobCounter &counter);
+
+  // Runs |fn| for every index in [0, count) and returns once all of them are done. The calling thread
+  // takes part in the work. The first exception thrown by |fn| is rethrown once every index has run.
+  void ParallelFor(size_t count, const std::function<void(size_t)> &fn);
+
+  // Splits [0, count) into contiguous ranges of at least |min_range| items, about one per thread, and runs
+  // |fn| on each of them.
+  void ParallelForRanges(size_t count, size_t min_range, const std::function<void(size_t, size_t)> &fn);
+
+ private:
+  struct Task {
+    Job job;
+    JobCounter *counter = nullptr;
+  };
+
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  void Push(Task task);
+  bool TryRunOne(uint32_t queue_index, const JobCounter *only);
+  bool Pop(uint32_t queue_index, const JobCounter *only, Task &task);
+  bool Steal(uint32_t queue_index, Task &task);
+  void Finish(JobCounter &counter, std::exception_ptr error);
+  void WorkerLoop(uint32_t index);
+  [[nodiscard]] uint32_t GetQueueIndex() const;
+
+  std::vector<std::thread> workers_;
+  // One per worker, the last one is shared by every other thread.
+  std::vector<std::unique_ptr<Queue>> queues_;
+
+  // Jobs pushed and not taken yet, workers sleep while it is zero.
+  std::atomic<uint32_t> queued_{0};
+  std::atomic<uint32_t> sleeping_{0};
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_;
+  bool stopping_ = false;
+};
+
+}  // namespace vre::platform
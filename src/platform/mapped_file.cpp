@@ -0,0 +1,93 @@
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace vre::platform {
+
+#ifdef _WIN32
+
+std::shared_ptr<MappedFile> MappedFile::Open(const std::string &filename) {
+  HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    return nullptr;
+  }
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+    CloseHandle(file);
+    return nullptr;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping == nullptr) {
+    CloseHandle(file);
+    return nullptr;
+  }
+
+  const void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (data == nullptr) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return nullptr;
+  }
+
+  std::shared_ptr<MappedFile> result(new MappedFile());
+  result->file_ = file;
+  result->mapping_ = mapping;
+  result->data_ = static_cast<const uint8_t *>(data);
+  result->size_ = static_cast<size_t>(size.QuadPart);
+  return result;
+}
+
+MappedFile::~MappedFile() {
+  UnmapViewOfFile(data_);
+  CloseHandle(mapping_);
+  CloseHandle(file_);
+}
+
+#else
+
+std::shared_ptr<MappedFile> MappedFile::Open(const std::string &filename) {
+  const int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return nullptr;
+  }
+
+  struct stat info {};
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    close(fd);
+    return nullptr;
+  }
+
+  const auto size = static_cast<size_t>(info.st_size);
+  void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps its own reference to the file.
+  close(fd);
+
+  if (data == MAP_FAILED) {
+    return nullptr;
+  }
+
+  madvise(data, size, MADV_WILLNEED);
+
+  std::shared_ptr<MappedFile> result(new MappedFile());
+  result->data_ = static_cast<const uint8_t *>(data);
+  result->size_ = size;
+  return result;
+}
+
+MappedFile::~MappedFile() {
+  munmap(const_cast<uint8_t *>(data_), size_);
+}
+
+#endif
+
+}  // namespace vre::platform
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace vre::platform {
+
+// Read-only memory mapping of a whole file.
+class MappedFile {
+ public:
+  ~MappedFile();
+
+  MappedFile(MappedFile &) = delete;
+  MappedFile(MappedFile &&) = delete;
+
+  // Returns nullptr if the file does not exist or can not be mapped.
+  static std::shared_ptr<MappedFile> Open(const std::string &filename);
+
+  [[nodiscard]] const uint8_t *GetData() const { return data_; }
+  [[nodiscard]] size_t GetSize() const { return size_; }
+
+ private:
+  MappedFile() = default;
+
+  const uint8_t *data_ = nullptr;
+  size_t size_ = 0;
+
+#ifdef _WIN32
+  void *file_ = nullptr;
+  void *mapping_ = nullptr;
+#endif
+};
+
+}  // namespace vre::platform
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace vre::platform {
+
+// Bounded queue between exactly one producer and one consumer thread. Neither side blocks or locks, each
+// only writes its own index.
+template <typename T, size_t Capacity>
+class SpscQueue {
+  static_assert((Capacity & (Capacity - 1)) == 0, "Capacity has to be a power of two");
+
+ public:
+  SpscQueue() = default;
+
+  SpscQueue(SpscQueue &) = delete;
+  SpscQueue(SpscQueue &&) = delete;
+
+  // Producer only, false when full.
+  bool TryPush(T value) {
+    const auto tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == Capacity) {
+      return false;
+    }
+
+    slots_[tail & (Capacity - 1)] = std::move(value);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only, false when empty.
+  bool TryPop(T &value) {
+    const auto head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+
+    value = std::move(slots_[head & (Capacity - 1)]);
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  [[nodiscard]] bool IsEmpty() const {
+    return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+  }
+
+ private:
+  // On their own cache lines, so the two threads do not invalidate each other's index.
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+  T slots_[Capacity];
+};
+
+}  // namespace vre::platform
@@ -12,7 +12,7 @@ namespace vre::rendering {
 namespace {
 
 void CopyBuffer(VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceSize size, VkDevice device,
-                VkCommandPool command_pool, VkQueue queue) {
+                VkCommandPool command_pool, SubmitThread &submit_thread) {
   VkCommandBufferAllocateInfo alloc_info{};
   alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
   alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
@@ -34,13 +34,9 @@ void CopyBuffer(VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceSize size, VkD
 
   vkEndCommandBuffer(command_buffer);
 
-  VkSubmitInfo submit_info{};
-  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submit_info.commandBufferCount = 1;
-  submit_info.pCommandBuffers = &command_buffer;
-
-  vkQueueSubmit(queue, 1, &submit_info, VK_NULL_HANDLE);
-  vkQueueWaitIdle(queue);
+  Submission submission;
+  submission.command_buffer = command_buffer;
+  submit_thread.Wait(submit_thread.Submit(submission));
 
   vkFreeCommandBuffers(device, command_pool, 1, &command_buffer);
 }
@@ -83,7 +79,7 @@ std::shared_ptr<Buffer> RenderCore::CreateBuffer(const CreateBufferInfo &crate_i
       VR_CHECK(staging_allocation_info.pMappedData);
       memcpy(staging_allocation_info.pMappedData, crate_info.initial_data,
              static_cast<size_t>(crate_info.buffer_size));
-      CopyBuffer(staging_buffer, buffer, crate_info.buffer_size, device_, command_pool_, graphics_queue_);
+      CopyBuffer(staging_buffer, buffer, crate_info.buffer_size, device_, command_pool_, *submit_thread_);
 
       vmaDestroyBuffer(vma_allocator_, staging_buffer, staging_allocation);
     } else {
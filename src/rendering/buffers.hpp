@@ -35,6 +35,11 @@ class Buffer {
     memcpy(allocation_info_.pMappedData, data, size_);
   }
 
+  // Makes GPU writes visible to the mapping on memory that is not host coherent.
+  void Invalidate() { vmaInvalidateAllocation(vma_allocator_, vma_allocation_, 0, VK_WHOLE_SIZE); }
+
+  [[nodiscard]] bool IsMapped() const { return allocation_info_.pMappedData != nullptr; }
+
   [[nodiscard]] void *GetMappedData() const {
     VR_ASSERT(allocation_info_.pMappedData);
     return allocation_info_.pMappedData;
@@ -43,14 +43,53 @@ void CommandBuffer::Start() {
   }
 }
 
+void CommandBuffer::StartSecondary(const CommandBuffer &primary) {
+  const auto &transient = primary.state_.transient;
+  VR_ASSERT(transient.render_pass && transient.framebuffer);
+  state_.transient = transient;
+
+  VkCommandBufferInheritanceInfo inheritance_info{};
+  inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritance_info.renderPass = transient.render_pass->GetRenderPass();
+  inheritance_info.subpass = transient.subpass;
+  inheritance_info.framebuffer = transient.framebuffer->GetFramebuffer();
+
+  VkCommandBufferBeginInfo begin_info{};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags =
+      VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  begin_info.pInheritanceInfo = &inheritance_info;
+
+  if (vkBeginCommandBuffer(command_buffer_, &begin_info) != VK_SUCCESS) {
+    throw std::runtime_error("failed to begin recording secondary command buffer!");
+  }
+
+  // Dynamic state is not inherited from the primary command buffer.
+  const VkExtent2D extent = {transient.framebuffer->GetWidth(), transient.framebuffer->GetHeight()};
+
+  VkViewport viewport{};
+  viewport.width = static_cast<float>(extent.width);
+  viewport.height = static_cast<float>(extent.height);
+  viewport.minDepth = 0.0F;
+  viewport.maxDepth = 1.0F;
+  SetViewport(viewport);
+  SetScissors({{0, 0}, extent});
+}
+
+void CommandBuffer::End() {
+  CHECK_VK_SUCCESS(vkEndCommandBuffer(command_buffer_));
+}
+
 void CommandBuffer::BeginRenderPass(const BeginRenderInfo &info) {
   state_.Reset();
 
+  const auto color_attachment_count = info.render_pass_info.color_attachments.size();
+
   std::vector<VkClearValue> clear_values;
-  clear_values.resize(info.render_pass_info.color_attachments.size());
+  clear_values.resize(color_attachment_count + 1);
   uint32_t num_clear_values = 0;
 
-  for (unsigned i = 0; i < info.render_pass_info.color_attachments.size(); i++) {
+  for (unsigned i = 0; i < color_attachment_count; i++) {
     const auto &clear_color = info.render_pass_info.clear_color[i];
 
     if ((info.render_pass_info.clear_attachments & (1U << i)) != 0U) {
@@ -58,6 +97,14 @@ void CommandBuffer::BeginRenderPass(const BeginRenderInfo &info) {
       num_clear_values = i + 1;
     }
   }
+
+  // The depth attachment is always last.
+  if (info.render_pass_info.depth_stencil_attachment &&
+      HasRenderPassOp(info.render_pass_info.depth_stencil_ops,
+                      RenderPassOp::RENDER_PASS_OP_CLEAR_DEPTH_STENCIL_BIT)) {
+    clear_values[color_attachment_count].depthStencil = info.render_pass_info.clear_depth_stencil;
+    num_clear_values = color_attachment_count + 1;
+  }
   clear_values.resize(num_clear_values);
 
   VkRenderPassBeginInfo render_pass_info{};
@@ -68,9 +115,22 @@ void CommandBuffer::BeginRenderPass(const BeginRenderInfo &info) {
   render_pass_info.clearValueCount = clear_values.size();
   render_pass_info.pClearValues = clear_values.data();
 
-  vkCmdBeginRenderPass(command_buffer_, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+  vkCmdBeginRenderPass(command_buffer_, &render_pass_info, info.contents);
 
   state_.transient.render_pass = info.render_pass;
+  state_.transient.framebuffer = info.framebuffer;
+}
+
+void CommandBuffer::EndRenderPass() {
+  VR_ASSERT(state_.transient.render_pass);
+
+  vkCmdEndRenderPass(command_buffer_);
+  state_.Reset();
+}
+
+void CommandBuffer::NextSubpass(VkSubpassContents contents) {
+  vkCmdNextSubpass(command_buffer_, contents);
+  state_.transient.subpass++;
 }
 
 void CommandBuffer::SetViewport(const VkViewport &viewport) {
@@ -139,6 +199,27 @@ void CommandBuffer::DrawIndexed(uint32_t index_count, uint32_t instance_count, u
   vkCmdDrawIndexed(command_buffer_, index_count, instance_count, first_index, vertex_offset, first_instance);
 }
 
+void CommandBuffer::DrawIndexedIndirect(const Buffer &buffer, VkDeviceSize offset, uint32_t draw_count) {
+  FlushState();
+  vkCmdDrawIndexedIndirect(command_buffer_, buffer.GetBuffer(), offset, draw_count,
+                           sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void CommandBuffer::DrawIndexedIndirectCount(const Buffer &buffer, VkDeviceSize offset,
+                                             const Buffer &count_buffer, VkDeviceSize count_offset,
+                                             uint32_t max_draw_count) {
+  FlushState();
+  vkCmdDrawIndexedIndirectCount(command_buffer_, buffer.GetBuffer(), offset, count_buffer.GetBuffer(),
+                                count_offset, max_draw_count, sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void CommandBuffer::ExecuteCommands(const std::vector<VkCommandBuffer> &command_buffers) {
+  if (!command_buffers.empty()) {
+    vkCmdExecuteCommands(command_buffer_, static_cast<uint32_t>(command_buffers.size()),
+                         command_buffers.data());
+  }
+}
+
 void CommandBuffer::FlushState() {
   BindDescriptorSet(0);
   vkCmdBindPipeline(command_buffer_, VK_PIPELINE_BIND_POINT_GRAPHICS, GetGraphicsPipeline());
@@ -179,12 +260,12 @@ void CommandBuffer::BindDescriptorSet(uint32_t set) {
 VkPipeline CommandBuffer::GetGraphicsPipeline() {
   VR_ASSERT(state_.per_draw.material);
 
-  if (auto pipeline = state_.per_draw.material->GetPipeline(); pipeline != VK_NULL_HANDLE) {
+  const PipelineKey key{GetRenderPass().GetCompatibilityId(), state_.transient.subpass,
+                        state_.transient.depth_mode, state_.transient.is_wireframe};
+  if (auto pipeline = state_.per_draw.material->GetPipeline(key); pipeline != VK_NULL_HANDLE) {
     return pipeline;
   }
-  auto pipeline = BuildGraphicsPipeline();
-  state_.per_draw.material->SetPipeline(pipeline);
-  return pipeline;
+  return state_.per_draw.material->SetPipeline(key, BuildGraphicsPipeline());
 }
 
 VkPipeline CommandBuffer::BuildGraphicsPipeline() {
@@ -224,6 +305,17 @@ VkPipeline CommandBuffer::BuildGraphicsPipeline() {
   multisampling.sampleShadingEnable = VK_FALSE;
   multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 
+  const auto depth_mode = state_.transient.depth_mode;
+
+  VkPipelineDepthStencilStateCreateInfo depth_stencil{};
+  depth_stencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  depth_stencil.depthTestEnable = depth_mode != DepthMode::kDisabled;
+  depth_stencil.depthWriteEnable =
+      depth_mode == DepthMode::kTestAndWrite || depth_mode == DepthMode::kPrePass;
+  depth_stencil.depthCompareOp = depth_mode == DepthMode::kEqual ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS;
+  depth_stencil.depthBoundsTestEnable = VK_FALSE;
+  depth_stencil.stencilTestEnable = VK_FALSE;
+
   VkPipelineColorBlendAttachmentState color_blend_attachment{};
   color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
                                           VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
@@ -233,7 +325,7 @@ VkPipeline CommandBuffer::BuildGraphicsPipeline() {
   color_blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
   color_blending.logicOpEnable = VK_FALSE;
   color_blending.logicOp = VK_LOGIC_OP_COPY;
-  color_blending.attachmentCount = 1;
+  color_blending.attachmentCount = depth_mode == DepthMode::kPrePass ? 0 : 1;
   color_blending.pAttachments = &color_blend_attachment;
   color_blending.blendConstants[0] = 0.0F;
   color_blending.blendConstants[1] = 0.0F;
@@ -249,7 +341,7 @@ VkPipeline CommandBuffer::BuildGraphicsPipeline() {
   vertex_input_info.pVertexBindingDescriptions = binding_descriptions.data();
   vertex_input_info.pVertexAttributeDescriptions = attribute_descriptions.data();
 
-  auto shader_stages = state_.per_draw.material->GetShaderStages();
+  auto shader_stages = state_.per_draw.material->GetShaderStages(depth_mode);
   VkGraphicsPipelineCreateInfo pipeline_info{};
   pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
   pipeline_info.stageCount = shader_stages.size();
@@ -260,10 +352,11 @@ VkPipeline CommandBuffer::BuildGraphicsPipeline() {
   pipeline_info.pDynamicState = &dynamic_state;
   pipeline_info.pRasterizationState = &rasterizer;
   pipeline_info.pMultisampleState = &multisampling;
+  pipeline_info.pDepthStencilState = &depth_stencil;
   pipeline_info.pColorBlendState = &color_blending;
   pipeline_info.layout = state_.per_draw.material->GetPipelineLayout().GetPipelineLayout();
-  pipeline_info.renderPass = state_.transient.render_pass->GetRenderPass();
-  pipeline_info.subpass = 0;
+  pipeline_info.renderPass = GetRenderPass().GetRenderPass();
+  pipeline_info.subpass = state_.transient.subpass;
   pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
 
   VkPipeline graphics_pipeline;
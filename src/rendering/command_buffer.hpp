@@ -18,17 +18,25 @@ struct BeginRenderInfo {
   RenderPassInfo render_pass_info;
   std::shared_ptr<RenderPass> render_pass;
   std::shared_ptr<Framebuffer> framebuffer;
+  // Of the first subpass, with secondary command buffers only vkCmdExecuteCommands may be recorded.
+  VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE;
 };
 
 struct GraphicsState {
   struct {
     void Reset() {
       is_wireframe = false;
+      depth_mode = DepthMode::kDisabled;
+      subpass = 0;
       render_pass.reset();
+      framebuffer.reset();
     }
 
     bool is_wireframe = false;
+    DepthMode depth_mode = DepthMode::kDisabled;
+    uint32_t subpass = 0;
     std::shared_ptr<RenderPass> render_pass;
+    std::shared_ptr<Framebuffer> framebuffer;
   } transient;
 
   struct {
@@ -63,8 +71,25 @@ class CommandBuffer {
   VkCommandBuffer GetBuffer() { return command_buffer_; }
 
   void Start();
+  // Begins a secondary command buffer continuing the current subpass of |primary|, with its depth mode and a
+  // viewport and scissor covering the framebuffer.
+  void StartSecondary(const CommandBuffer &primary);
+  void End();
 
   void BeginRenderPass(const BeginRenderInfo &info);
+  void EndRenderPass();
+  // Pipelines are built against the render pass of the framebuffer, so passes that only differ in load and
+  // store ops share them.
+  [[nodiscard]] const RenderPass &GetRenderPass() const {
+    VR_ASSERT(state_.transient.framebuffer);
+    return state_.transient.framebuffer->GetCompatibleRenderPass();
+  }
+  void NextSubpass(VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
+  [[nodiscard]] uint32_t GetSubpass() const { return state_.transient.subpass; }
+
+  // Applies to the pipelines of the following draws, until the next render pass.
+  void SetDepthMode(DepthMode depth_mode) { state_.transient.depth_mode = depth_mode; }
+  [[nodiscard]] DepthMode GetDepthMode() const { return state_.transient.depth_mode; }
 
   void SetViewport(const VkViewport &viewport);
   void SetScissors(const VkRect2D &scissor);
@@ -87,6 +112,12 @@ class CommandBuffer {
 
   void DrawIndexed(uint32_t index_count, uint32_t instance_count, uint32_t first_index, int32_t vertex_offset,
                    uint32_t first_instance);
+  void DrawIndexedIndirect(const Buffer &buffer, VkDeviceSize offset, uint32_t draw_count);
+  // Draws up to |max_draw_count| VkDrawIndexedIndirectCommands, the actual count is read from |count_buffer|.
+  void DrawIndexedIndirectCount(const Buffer &buffer, VkDeviceSize offset, const Buffer &count_buffer,
+                                VkDeviceSize count_offset, uint32_t max_draw_count);
+
+  void ExecuteCommands(const std::vector<VkCommandBuffer> &command_buffers);
 
  private:
   RenderCore *core_ = nullptr;
@@ -37,6 +37,7 @@ DescriptorSetAllocator::~DescriptorSetAllocator() {
 }
 
 VkDescriptorSet DescriptorSetAllocator::GetSet() {
+  std::lock_guard lock(mutex_);
   if (descriptor_sets_.empty()) {
     VkDescriptorPoolCreateInfo info{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
     info.maxSets = kSetCount;
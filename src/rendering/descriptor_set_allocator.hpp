@@ -1,5 +1,6 @@
 #pragma once
 
+#include <mutex>
 #include <vector>
 #include "common.hpp"
 
@@ -17,6 +18,7 @@ class DescriptorSetAllocator {
 
   VkDescriptorSetLayout GetLayout() const { return descriptor_set_layout_; }
 
+  // Called by every recording thread.
   VkDescriptorSet GetSet();
 
  private:
@@ -26,6 +28,7 @@ class DescriptorSetAllocator {
 
   VkDescriptorSetLayout descriptor_set_layout_ = VK_NULL_HANDLE;
 
+  std::mutex mutex_;
   uint32_t index = 0;
   VkDescriptorPool pool_ = VK_NULL_HANDLE;
   std::vector<VkDescriptorSet> descriptor_sets_;
@@ -0,0 +1,49 @@
+#include "dynamic_resolution.hpp"
+
+#include <cmath>
+
+namespace vre::rendering {
+
+DynamicResolution::DynamicResolution(const Config &config) : config_(config), scale_(config.max_scale) {
+  VR_CHECK(config.target_frame_ms > 0.0F);
+  VR_CHECK(config.min_scale > 0.0F && config.min_scale <= config.max_scale && config.max_scale <= 1.0F);
+  VR_CHECK(config.smoothing > 0.0F && config.smoothing <= 1.0F);
+}
+
+void DynamicResolution::Update(float gpu_frame_ms, float frame_scale) {
+  const auto full_scale_ms = gpu_frame_ms / (frame_scale * frame_scale);
+  if (full_scale_ms_ == 0.0F) {
+    full_scale_ms_ = full_scale_ms;
+  } else {
+    full_scale_ms_ += config_.smoothing * (full_scale_ms - full_scale_ms_);
+  }
+  if (full_scale_ms_ <= 0.0F) {
+    return;
+  }
+
+  const auto fitting_scale = std::sqrt(config_.target_frame_ms / full_scale_ms_);
+  if (fitting_scale < scale_) {
+    scale_ = std::max(std::floor(fitting_scale / kScaleStep + 1e-3F) * kScaleStep, config_.min_scale);
+    raise_updates_ = 0;
+    return;
+  }
+
+  const auto next_scale = std::min(scale_ + kScaleStep, config_.max_scale);
+  if (next_scale <= scale_ || fitting_scale < next_scale + kRaiseMargin) {
+    raise_updates_ = 0;
+    return;
+  }
+  if (++raise_updates_ >= kRaiseUpdateCount) {
+    scale_ = next_scale;
+    raise_updates_ = 0;
+  }
+}
+
+VkExtent2D DynamicResolution::GetRenderExtent(VkExtent2D extent) const {
+  const auto scale = [this](uint32_t size) {
+    return std::max(static_cast<uint32_t>(std::lround(static_cast<float>(size) * scale_)), 1U);
+  };
+  return {scale(extent.width), scale(extent.height)};
+}
+
+}  // namespace vre::rendering
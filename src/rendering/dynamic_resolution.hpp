@@ -0,0 +1,50 @@
+#pragma once
+
+#include "common.hpp"
+
+namespace vre::rendering {
+
+// Picks the render scale, the fraction of the output extent per axis the scene is rendered at, that holds the
+// GPU frame time at a target. Frame times are normalized to a scale of one before they are averaged, since
+// they arrive frames after the scale they were measured at changed: the pixel count, and roughly the GPU
+// time, goes with the square of the scale.
+class DynamicResolution {
+ public:
+  // Steps the scale moves in, so the render targets are not reallocated for every small adjustment.
+  static constexpr float kScaleStep = 0.05F;
+  // The scale drops as soon as it misses the target but only grows once the next step fits with this much
+  // headroom for kRaiseUpdateCount updates in a row, so it does not oscillate around a step.
+  static constexpr float kRaiseMargin = 0.02F;
+  static constexpr uint32_t kRaiseUpdateCount = 30;
+
+  struct Config {
+    bool enabled = false;
+    float target_frame_ms = 16.0F;
+    // In (0, 1], the scale starts at |max_scale|.
+    float min_scale = 0.5F;
+    float max_scale = 1.0F;
+    // Weight of the newest frame time in the average, in (0, 1]. Lower values react slower to load changes
+    // but do not chase noise.
+    float smoothing = 0.1F;
+  };
+
+  explicit DynamicResolution(const Config &config);
+
+  // Feeds the GPU time of a finished frame rendered at |frame_scale|.
+  void Update(float gpu_frame_ms, float frame_scale);
+
+  [[nodiscard]] float GetScale() const { return scale_; }
+  // Average GPU frame time at a scale of one, zero before the first Update().
+  [[nodiscard]] float GetFullScaleFrameTime() const { return full_scale_ms_; }
+
+  // |extent| at the current scale, at least one pixel.
+  [[nodiscard]] VkExtent2D GetRenderExtent(VkExtent2D extent) const;
+
+ private:
+  Config config_;
+  float scale_;
+  float full_scale_ms_ = 0.0F;
+  uint32_t raise_updates_ = 0;
+};
+
+}  // namespace vre::rendering
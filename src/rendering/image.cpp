@@ -25,4 +25,37 @@ Image::Image(VkDevice device, VkImage image, VkImageView default_view, const Ima
   view_ = std::make_shared<ImageView>(device_, default_view, std::move(view_info));
 }
 
+Image::Image(VkDevice device, VmaAllocator allocator, VkImage image, VmaAllocation allocation,
+             VkImageView default_view, const ImageCreateInfo &info, VkImageViewType view_type)
+    : Image(device, image, default_view, info, view_type) {
+  owns_image_ = true;
+  allocator_ = allocator;
+  allocation_ = allocation;
+}
+
+Image::~Image() {
+  if (!owns_image_) {
+    return;
+  }
+
+  view_.reset();
+  vkDestroyImage(device_, image_, nullptr);
+  if (allocation_ != VK_NULL_HANDLE) {
+    vmaFreeMemory(allocator_, allocation_);
+  }
+}
+
+Image::Image(Image &&other) noexcept
+    : device_(other.device_),
+      info_(other.info_),
+      image_(other.image_),
+      view_(std::move(other.view_)),
+      owns_image_(other.owns_image_),
+      allocator_(other.allocator_),
+      allocation_(other.allocation_),
+      swapchain_layout_(other.swapchain_layout_) {
+  other.owns_image_ = false;
+  other.allocation_ = VK_NULL_HANDLE;
+}
+
 }  // namespace vre::rendering
\ No newline at end of file
@@ -90,17 +90,31 @@ struct ImageCreateInfo {
 
     return info;
   }
+
+  static ImageCreateInfo DepthStencilTarget(uint32_t width, uint32_t height, VkFormat format) {
+    ImageCreateInfo info = RenderTarget(width, height, format);
+    info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    info.initial_layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    return info;
+  }
 };
 
 class Image {
  public:
   Image(VkDevice device, VkImage image, VkImageView default_view, const ImageCreateInfo &info,
         VkImageViewType view_type);
+  // Owns |image| and |allocation|. The allocation is null when the memory is owned elsewhere, e.g. shared
+  // with other images.
+  Image(VkDevice device, VmaAllocator allocator, VkImage image, VmaAllocation allocation,
+        VkImageView default_view, const ImageCreateInfo &info, VkImageViewType view_type);
+  ~Image();
 
   Image(Image &) = delete;
-  Image(Image &&) = default;
+  Image(Image &&other) noexcept;
 
   [[nodiscard]] ImageViewPtr GetView() { return view_; }
+  [[nodiscard]] VkImage GetImage() const { return image_; }
 
   [[nodiscard]] const ImageCreateInfo &GetCreateInfo() const { return info_; }
 
@@ -117,10 +131,13 @@ class Image {
   VkDevice device_;
 
   const ImageCreateInfo info_;
-  // TODO: transfer ownership of image to this class
   VkImage image_;
   ImageViewPtr view_;
 
+  bool owns_image_ = false;
+  VmaAllocator allocator_ = VK_NULL_HANDLE;
+  VmaAllocation allocation_ = VK_NULL_HANDLE;
+
   VkImageLayout swapchain_layout_ = VK_IMAGE_LAYOUT_UNDEFINED;
 };
 using ImagePtr = std::shared_ptr<Image>;
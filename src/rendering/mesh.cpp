@@ -1,80 +1,543 @@
 #include "mesh.hpp"
 #include <vulkan/vulkan_core.h>
 
+#include <glm/gtc/packing.hpp>
+
 #include "application.hpp"
+#include "geometry/mesh_simplifier.hpp"
 #include "rendering/render_core.hpp"
 #include "rendering/shader.hpp"
+#include "rendering/upload_batch.hpp"
 
 namespace vre::rendering {
 
-std::shared_ptr<Material> GetDefaultMaterial(VkDevice device) {
-  return std::make_shared<Material>(
-      device, std::make_shared<Shader>(device, Shader::kFragment, "assets/shaders/shader.frag"),
-      std::make_shared<Shader>(device, Shader::kVertex, "assets/shaders/shader.vert"));
+namespace {
+
+constexpr VkDeviceSize kIndexSectionAlignment = 4;
+
+bool UseShortIndices(const Primitive &primitive) {
+  return primitive.vertex_count <= std::numeric_limits<uint16_t>::max();
 }
 
-void Mesh::AddPrimitive(std::vector<glm::vec3> vert, const std::vector<uint32_t> &indicies) {
-  const uint32_t index_start = static_cast<uint32_t>(indicies_.size());
-  const uint32_t vertex_start = static_cast<uint32_t>(pos_.size());
+}  // namespace
 
-  pos_.insert(pos_.end(), std::make_move_iterator(vert.begin()), std::make_move_iterator(vert.end()));
+void Mesh::Reserve(size_t vertex_count, size_t index_count) {
+  pos_.reserve(pos_.size() + vertex_count);
+  indicies_.reserve(indicies_.size() + index_count);
+}
 
-  indicies_.reserve(indicies_.size() + indicies.size());
-  for (const auto &index : indicies) {
-    indicies_.push_back(index + vertex_start);
-  }
+Mesh::PrimitiveStorage Mesh::AllocatePrimitive(uint32_t vertex_count, uint32_t index_count,
+                                               int32_t material) {
+  VR_ASSERT(!external_.owner);
 
   Primitive primitive{};
-  primitive.index_count = indicies.size();
-  primitive.index_start = index_start;
-  primitive.vertex_count = vert.size();
-  primitive.vertex_start = vertex_start;
+  primitive.material = material;
+  primitive.index_count = index_count;
+  primitive.index_start = static_cast<uint32_t>(indicies_.size());
+  primitive.vertex_count = vertex_count;
+  primitive.vertex_start = static_cast<uint32_t>(pos_.size());
   primitives_.push_back(primitive);
+
+  pos_.resize(pos_.size() + vertex_count);
+  indicies_.resize(indicies_.size() + index_count);
+
+  PrimitiveStorage storage{};
+  storage.positions = pos_.data() + primitive.vertex_start;
+  storage.indices = indicies_.data() + primitive.index_start;
+  storage.vertex_start = primitive.vertex_start;
+  return storage;
+}
+
+void Mesh::AddPrimitive(std::vector<glm::vec3> vert, const std::vector<uint32_t> &indicies) {
+  auto storage =
+      AllocatePrimitive(static_cast<uint32_t>(vert.size()), static_cast<uint32_t>(indicies.size()));
+
+  std::copy(vert.begin(), vert.end(), storage.positions);
+  std::transform(indicies.begin(), indicies.end(), storage.indices,
+                 [vertex_start = storage.vertex_start](uint32_t index) { return index + vertex_start; });
+}
+
+void Mesh::SetExternalGeometry(std::shared_ptr<const void> owner, const glm::vec3 *positions,
+                               uint32_t vertex_count, const uint32_t *indices, uint32_t index_count,
+                               std::vector<Primitive> primitives, std::vector<PrimitiveLod> lods,
+                               const Bounds &bounds) {
+  VR_ASSERT(pos_.empty() && indicies_.empty());
+
+  external_.owner = std::move(owner);
+  external_.positions = positions;
+  external_.vertex_count = vertex_count;
+  external_.indices = indices;
+  external_.index_count = index_count;
+  primitives_ = std::move(primitives);
+  lods_ = std::move(lods);
+  bounds_ = bounds;
+}
+
+void Mesh::SetExternalGpuGeometry(VertexFormat vertex_format, const glm::mat4 &dequantize_transform,
+                                  std::vector<IndexSection> index_sections, const GpuGeometry &geometry) {
+  VR_ASSERT(external_.owner && !IsUploaded() && meshlets_.meshlets.empty());
+  VR_ASSERT(index_sections.empty() || index_sections.size() == primitives_.size() + lods_.size());
+
+  vertex_format_ = vertex_format;
+  dequantize_transform_ = dequantize_transform;
+  index_sections_ = std::move(index_sections);
+  external_.gpu_geometry = geometry;
+  external_.has_gpu_geometry = true;
+}
+
+void Mesh::ComputeBounds() {
+  bounds_ = Bounds{};
+
+  const auto *positions = GetPositions();
+  for (uint32_t i = 0; i < GetVertexCount(); i++) {
+    bounds_.Extend(positions[i]);
+  }
+}
+
+geometry::OptimizationReport Mesh::Optimize() {
+  VR_ASSERT(!external_.owner && !IsUploaded() && lods_.empty());
+
+  geometry::OptimizationReport report{};
+
+  std::vector<glm::vec3> positions;
+  std::vector<uint32_t> indices;
+  positions.reserve(pos_.size());
+  indices.reserve(indicies_.size());
+
+  for (auto &primitive : primitives_) {
+    const auto first_vertex = pos_.begin() + primitive.vertex_start;
+    std::vector<glm::vec3> primitive_positions(first_vertex, first_vertex + primitive.vertex_count);
+    std::vector<uint32_t> primitive_indices;
+    primitive_indices.reserve(primitive.index_count);
+    for (uint32_t i = 0; i < primitive.index_count; i++) {
+      primitive_indices.push_back(indicies_[primitive.index_start + i] - primitive.vertex_start);
+    }
+
+    // Non-indexed primitives draw their vertices in order, reordering them would drop every vertex.
+    if (!primitive_indices.empty() && primitive_indices.size() % 3 == 0) {
+      report.Add(geometry::OptimizeTriangleList(primitive_positions, primitive_indices));
+    }
+
+    primitive.vertex_start = static_cast<uint32_t>(positions.size());
+    primitive.vertex_count = static_cast<uint32_t>(primitive_positions.size());
+    primitive.index_start = static_cast<uint32_t>(indices.size());
+    primitive.index_count = static_cast<uint32_t>(primitive_indices.size());
+
+    positions.insert(positions.end(), primitive_positions.begin(), primitive_positions.end());
+    for (const auto index : primitive_indices) {
+      indices.push_back(index + primitive.vertex_start);
+    }
+  }
+
+  pos_ = std::move(positions);
+  indicies_ = std::move(indices);
+  ComputeBounds();
+
+  return report;
+}
+
+void Mesh::GenerateLods(uint32_t max_lod_count, float reduction) {
+  VR_ASSERT(!external_.owner && !IsUploaded() && lods_.empty());
+
+  for (auto &primitive : primitives_) {
+    primitive.lod_start = static_cast<uint32_t>(lods_.size());
+    primitive.lod_count = 0;
+    if (primitive.index_count % 3 != 0) {
+      continue;
+    }
+
+    const auto *positions = pos_.data() + primitive.vertex_start;
+    std::vector<uint32_t> source(primitive.index_count);
+    for (uint32_t i = 0; i < primitive.index_count; i++) {
+      source[i] = indicies_[primitive.index_start + i] - primitive.vertex_start;
+    }
+
+    size_t previous_count = source.size();
+    float previous_error = 0.0F;
+    for (uint32_t lod = 1; lod < max_lod_count; lod++) {
+      const auto target = static_cast<size_t>(float(previous_count / 3) * reduction) * 3;
+
+      float error = 0.0F;
+      auto simplified = geometry::SimplifyTriangleList(positions, primitive.vertex_count, source, target,
+                                                       std::numeric_limits<float>::max(), error);
+      // Stop once simplification stalls, e.g. on meshes made of borders only.
+      if (simplified.empty() || simplified.size() > previous_count * 9 / 10) {
+        break;
+      }
+      geometry::OptimizeVertexCache(simplified, primitive.vertex_count);
+
+      PrimitiveLod primitive_lod{};
+      primitive_lod.index_start = static_cast<uint32_t>(indicies_.size());
+      primitive_lod.index_count = static_cast<uint32_t>(simplified.size());
+      primitive_lod.error = std::max(error, previous_error);
+      lods_.push_back(primitive_lod);
+      primitive.lod_count++;
+
+      for (const auto index : simplified) {
+        indicies_.push_back(index + primitive.vertex_start);
+      }
+
+      previous_count = simplified.size();
+      previous_error = primitive_lod.error;
+    }
+  }
+}
+
+void Mesh::GenerateMeshlets() {
+  VR_ASSERT(!IsUploaded() && !HasMeshlets());
+
+  uint32_t triangle_count = 0;
+  for (const auto &primitive : primitives_) {
+    triangle_count += primitive.index_count / 3;
+  }
+  if (triangle_count < kMinMeshletTriangleCount) {
+    return;
+  }
+
+  const auto *positions = GetPositions();
+  const auto *indices = GetIndices();
+  std::vector<uint32_t> primitive_indices;
+  for (auto &primitive : primitives_) {
+    primitive.meshlet_start = static_cast<uint32_t>(meshlets_.meshlets.size());
+    primitive.meshlet_count = 0;
+    if (primitive.index_count == 0 || primitive.index_count % 3 != 0) {
+      continue;
+    }
+
+    // Meshlet index offsets then match the index section of the primitive.
+    primitive_indices.resize(primitive.index_count);
+    for (uint32_t i = 0; i < primitive.index_count; i++) {
+      primitive_indices[i] = indices[primitive.index_start + i] - primitive.vertex_start;
+    }
+
+    geometry::BuildMeshlets(positions + primitive.vertex_start, primitive_indices.data(),
+                            primitive_indices.size(), meshlets_);
+    primitive.meshlet_count = static_cast<uint32_t>(meshlets_.meshlets.size()) - primitive.meshlet_start;
+  }
+}
+
+uint32_t Mesh::GetLodCount() const {
+  uint32_t count = 0;
+  for (const auto &primitive : primitives_) {
+    count = std::max(count, primitive.lod_count);
+  }
+  return count + 1;
+}
+
+float Mesh::GetLodError(uint32_t lod) const {
+  float error = 0.0F;
+  for (const auto &primitive : primitives_) {
+    // Primitives with a shorter chain keep drawing their coarsest LOD.
+    const auto level = std::min(lod, primitive.lod_count);
+    if (level != 0) {
+      error = std::max(error, lods_[primitive.lod_start + level - 1].error);
+    }
+  }
+  return error;
+}
+
+const glm::vec3 *Mesh::GetPositions() const {
+  return external_.owner ? external_.positions : pos_.data();
+}
+
+uint32_t Mesh::GetVertexCount() const {
+  return external_.owner ? external_.vertex_count : static_cast<uint32_t>(pos_.size());
+}
+
+const uint32_t *Mesh::GetIndices() const {
+  return external_.owner ? external_.indices : indicies_.data();
+}
+
+uint32_t Mesh::GetIndexCount() const {
+  return external_.owner ? external_.index_count : static_cast<uint32_t>(indicies_.size());
+}
+
+VkDeviceSize Mesh::GetGeometrySize() const {
+  if (external_.has_gpu_geometry) {
+    return external_.gpu_geometry.GetSize();
+  }
+
+  std::vector<IndexSection> sections;
+  const auto index_size = GetIndexCount() != 0 ? LayoutIndexSections(GetIndexRanges(), sections) : 0;
+  return VkDeviceSize(GetVertexCount()) * GetPositionStride(vertex_format_) + index_size +
+         meshlets_.meshlets.size() * sizeof(GpuMeshlet) + meshlets_.vertices.size() * sizeof(uint32_t) +
+         meshlets_.triangles.size();
+}
+
+void Mesh::SetVertexFormat(VertexFormat format) {
+  VR_ASSERT(!IsUploaded() && !external_.has_gpu_geometry);
+  vertex_format_ = format;
+}
+
+std::vector<uint8_t> Mesh::BuildVertexData() {
+  const auto *positions = GetPositions();
+  const auto vertex_count = GetVertexCount();
+  const auto stride = GetPositionStride(vertex_format_);
+
+  std::vector<uint8_t> data(size_t(vertex_count) * stride);
+  if (vertex_format_ == VertexFormat::kFloat32) {
+    memcpy(data.data(), positions, data.size());
+    dequantize_transform_ = glm::mat4(1.0F);
+    return data;
+  }
+
+  // Positions are stored in [-1, 1] relative to the bounds; flat axes keep a unit scale.
+  const auto center = bounds_.IsValid() ? bounds_.GetCenter() : glm::vec3(0.0F);
+  auto extent = bounds_.IsValid() ? bounds_.GetExtent() : glm::vec3(1.0F);
+  extent = glm::vec3(extent.x > 0.0F ? extent.x : 1.0F, extent.y > 0.0F ? extent.y : 1.0F,
+                     extent.z > 0.0F ? extent.z : 1.0F);
+  dequantize_transform_ = glm::scale(glm::translate(glm::mat4(1.0F), center), extent);
+
+  auto *output = reinterpret_cast<uint64_t *>(data.data());
+  for (uint32_t i = 0; i < vertex_count; i++) {
+    const auto normalized = glm::vec4(glm::clamp((positions[i] - center) / extent, -1.0F, 1.0F), 0.0F);
+    output[i] = vertex_format_ == VertexFormat::kFloat16 ? glm::packHalf4x16(normalized)
+                                                         : glm::packSnorm4x16(normalized);
+  }
+
+  return data;
+}
+
+std::vector<Mesh::IndexRange> Mesh::GetIndexRanges() const {
+  std::vector<IndexRange> ranges(primitives_.size() + lods_.size());
+  for (const auto &primitive : primitives_) {
+    const auto section = static_cast<size_t>(&primitive - primitives_.data());
+    ranges[section] = {primitive.index_start, primitive.index_count, &primitive};
+    for (uint32_t i = 0; i < primitive.lod_count; i++) {
+      const auto &lod = lods_[primitive.lod_start + i];
+      ranges[primitives_.size() + primitive.lod_start + i] = {lod.index_start, lod.index_count, &primitive};
+    }
+  }
+
+  return ranges;
+}
+
+VkDeviceSize Mesh::LayoutIndexSections(const std::vector<IndexRange> &ranges,
+                                       std::vector<IndexSection> &sections) {
+  sections.resize(ranges.size());
+  VkDeviceSize size = 0;
+  for (size_t i = 0; i < ranges.size(); i++) {
+    const bool short_indices = UseShortIndices(*ranges[i].primitive);
+    sections[i].type = short_indices ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    sections[i].offset = size;
+
+    size += ranges[i].index_count * (short_indices ? sizeof(uint16_t) : sizeof(uint32_t));
+    size = (size + kIndexSectionAlignment - 1) & ~(kIndexSectionAlignment - 1);
+  }
+
+  return size;
+}
+
+std::vector<uint8_t> Mesh::BuildIndexData() {
+  const auto ranges = GetIndexRanges();
+  const auto size = LayoutIndexSections(ranges, index_sections_);
+
+  const auto *indices = GetIndices();
+  std::vector<uint8_t> data(size);
+  for (size_t i = 0; i < ranges.size(); i++) {
+    const auto &range = ranges[i];
+    const auto vertex_start = range.primitive->vertex_start;
+    const auto *source = indices + range.index_start;
+    auto *destination = data.data() + index_sections_[i].offset;
+
+    if (index_sections_[i].type == VK_INDEX_TYPE_UINT16) {
+      auto *output = reinterpret_cast<uint16_t *>(destination);
+      for (uint32_t j = 0; j < range.index_count; j++) {
+        output[j] = static_cast<uint16_t>(source[j] - vertex_start);
+      }
+    } else {
+      auto *output = reinterpret_cast<uint32_t *>(destination);
+      for (uint32_t j = 0; j < range.index_count; j++) {
+        output[j] = source[j] - vertex_start;
+      }
+    }
+  }
+
+  return data;
+}
+
+std::vector<GpuMeshlet> Mesh::BuildMeshletData() const {
+  std::vector<GpuMeshlet> gpu_meshlets(meshlets_.meshlets.size());
+  for (const auto &primitive : primitives_) {
+    for (uint32_t i = primitive.meshlet_start; i < primitive.meshlet_start + primitive.meshlet_count; i++) {
+      const auto &meshlet = meshlets_.meshlets[i];
+      const auto &bounds = meshlets_.bounds[i];
+
+      auto &gpu_meshlet = gpu_meshlets[i];
+      gpu_meshlet.sphere = glm::vec4(bounds.center, bounds.radius);
+      gpu_meshlet.cone = glm::vec4(bounds.cone_axis, bounds.cone_cutoff);
+      gpu_meshlet.first_index = meshlet.index_offset;
+      gpu_meshlet.index_count = meshlet.triangle_count * 3;
+      gpu_meshlet.base_vertex = static_cast<int32_t>(primitive.vertex_start);
+      gpu_meshlet.vertex_offset = meshlet.vertex_offset;
+      gpu_meshlet.vertex_count = meshlet.vertex_count;
+      gpu_meshlet.triangle_offset = meshlet.triangle_offset;
+      gpu_meshlet.triangle_count = meshlet.triangle_count;
+    }
+  }
+
+  return gpu_meshlets;
+}
+
+GpuGeometry Mesh::PackGeometry() {
+  packed_.vertices = BuildVertexData();
+  packed_.indices = GetIndexCount() != 0 ? BuildIndexData() : std::vector<uint8_t>();
+  packed_.meshlets = BuildMeshletData();
+
+  GpuGeometry geometry{};
+  geometry.vertices = packed_.vertices.data();
+  geometry.vertex_size = packed_.vertices.size();
+  geometry.indices = packed_.indices.data();
+  geometry.index_size = packed_.indices.size();
+  geometry.meshlets = packed_.meshlets.data();
+  geometry.meshlet_count = static_cast<uint32_t>(packed_.meshlets.size());
+  geometry.meshlet_vertices = meshlets_.vertices.data();
+  geometry.meshlet_vertex_count = static_cast<uint32_t>(meshlets_.vertices.size());
+  geometry.meshlet_triangles = meshlets_.triangles.data();
+  geometry.meshlet_triangle_size = static_cast<uint32_t>(meshlets_.triangles.size());
+  return geometry;
+}
+
+void Mesh::CreateMeshletBuffers(UploadBatch &batch, const GpuGeometry &geometry) {
+  const auto create_storage_buffer = [&batch](const void *data, VkDeviceSize size) {
+    CreateBufferInfo create_info{};
+    create_info.buffer_size = size;
+    create_info.initial_data = data;
+    create_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    create_info.memory_usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    return batch.CreateBuffer(create_info);
+  };
+
+  meshlet_buffer_ = create_storage_buffer(geometry.meshlets, geometry.meshlet_count * sizeof(GpuMeshlet));
+  meshlet_vertex_buffer_ = create_storage_buffer(geometry.meshlet_vertices,
+                                                 geometry.meshlet_vertex_count * sizeof(uint32_t));
+  meshlet_triangle_buffer_ =
+      create_storage_buffer(geometry.meshlet_triangles, geometry.meshlet_triangle_size);
 }
 
 void Mesh::InitializeVulkan(RenderCore &renderer) {
-  if (!pos_.empty()) {
+  UploadBatch batch(renderer);
+  InitializeVulkan(renderer, batch);
+  batch.Submit();
+}
+
+void Mesh::InitializeVulkan(RenderCore &renderer, UploadBatch &batch) {
+  if (material_) {
+    return;
+  }
+
+  // Cooked meshes come in the GPU layout already.
+  const auto geometry = external_.has_gpu_geometry ? external_.gpu_geometry : PackGeometry();
+
+  if (geometry.vertex_size != 0) {
     CreateBufferInfo create_info{};
-    create_info.buffer_size = pos_.size() * sizeof(glm::vec3);
-    create_info.initial_data = pos_.data();
+    create_info.buffer_size = geometry.vertex_size;
+    create_info.initial_data = geometry.vertices;
     create_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    // The mesh shader path fetches positions itself.
+    if (HasMeshlets()) {
+      create_info.usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    }
     create_info.memory_usage = VMA_MEMORY_USAGE_GPU_ONLY;
 
-    vertex_buffer_ = renderer.CreateBuffer(create_info);
+    vertex_buffer_ = batch.CreateBuffer(create_info);
   }
 
-  if (!indicies_.empty()) {
+  if (geometry.index_size != 0) {
     CreateBufferInfo create_info{};
-    create_info.buffer_size = indicies_.size() * sizeof(uint32_t);
-    create_info.initial_data = indicies_.data();
+    create_info.buffer_size = geometry.index_size;
+    create_info.initial_data = geometry.indices;
     create_info.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
     create_info.memory_usage = VMA_MEMORY_USAGE_GPU_ONLY;
 
-    index_buffer_ = renderer.CreateBuffer(create_info);
+    index_buffer_ = batch.CreateBuffer(create_info);
+  }
+
+  if (HasMeshlets()) {
+    CreateMeshletBuffers(batch, geometry);
   }
+  // The batch copied everything to staging memory.
+  packed_ = {};
 
-  material_ = GetDefaultMaterial(renderer.GetDevice());
+  material_ = renderer.GetDefaultMaterial(vertex_format_);
 }
 
-void Mesh::Render(rendering::RenderContext &context, const glm::mat4 &transform) {
+void Mesh::BindGeometry(rendering::RenderContext &context, const glm::mat4 &transform, size_t section) {
+  // Bindings are reset by every draw, so each primitive binds its state again.
   context.command_buffer->BindMaterial(*material_);
-  context.command_buffer->BindVertexBuffers(0, *vertex_buffer_, 0, sizeof(glm::vec3),
+  context.command_buffer->BindVertexBuffers(0, *vertex_buffer_, 0, GetPositionStride(vertex_format_),
                                             VK_VERTEX_INPUT_RATE_VERTEX);
-  context.command_buffer->BindIndexBuffer(*index_buffer_, 0, VK_INDEX_TYPE_UINT32);
 
-  {
-    rendering::UniformBufferObject data{};
-    data.model = transform;
-    data.view = context.render_data.camera_view;
-    data.proj = context.render_data.camera_projection;
+  rendering::UniformBufferObject data{};
+  data.model = transform * dequantize_transform_;
+  context.command_buffer->AllocateUniformBuffer(0, 0, data);
+  context.command_buffer->BindUniformBuffer(0, 1, *context.view_buffer, 0, sizeof(rendering::ViewUniforms));
+
+  context.command_buffer->BindIndexBuffer(*index_buffer_, index_sections_[section].offset,
+                                          index_sections_[section].type);
+}
 
-    context.command_buffer->AllocateUniformBuffer(0, 0, data);
+std::pair<size_t, uint32_t> Mesh::GetLodSection(size_t primitive_index, uint32_t lod) const {
+  const auto &primitive = primitives_[primitive_index];
+  if (const auto level = std::min(lod, primitive.lod_count); level != 0) {
+    return {primitives_.size() + primitive.lod_start + level - 1,
+            lods_[primitive.lod_start + level - 1].index_count};
   }
+  return {primitive_index, primitive.index_count};
+}
 
-  // TODO(dmitrygladky): normal primitive rendering
-  for (const auto &primitive : primitives_) {
-    context.command_buffer->DrawIndexed(static_cast<uint32_t>(primitive.index_count), 1, 0, 0, 0);
+uint32_t Mesh::GetLodIndexCount(size_t primitive, uint32_t lod) const {
+  return GetLodSection(primitive, lod).second;
+}
+
+std::pair<uint32_t, uint32_t> Mesh::GetLodIndexRange(size_t primitive_index, uint32_t lod) const {
+  const auto &primitive = primitives_[primitive_index];
+  if (const auto level = std::min(lod, primitive.lod_count); level != 0) {
+    const auto &primitive_lod = lods_[primitive.lod_start + level - 1];
+    return {primitive_lod.index_start, primitive_lod.index_count};
+  }
+  return {primitive.index_start, primitive.index_count};
+}
+
+void Mesh::Render(rendering::RenderContext &context, const glm::mat4 &transform, uint32_t lod) {
+  for (size_t i = 0; i < primitives_.size(); i++) {
+    const auto [section, index_count] = GetLodSection(i, lod);
+
+    BindGeometry(context, transform, section);
+    context.command_buffer->DrawIndexed(index_count, 1, 0, static_cast<int32_t>(primitives_[i].vertex_start),
+                                        0);
+  }
+}
+
+void Mesh::RenderIndirect(rendering::RenderContext &context, const glm::mat4 &transform, uint32_t lod,
+                          const Buffer &commands, VkDeviceSize offset) {
+  for (size_t i = 0; i < primitives_.size(); i++) {
+    BindGeometry(context, transform, GetLodSection(i, lod).first);
+    context.command_buffer->DrawIndexedIndirect(commands, offset + i * sizeof(VkDrawIndexedIndirectCommand),
+                                                1);
+  }
+}
+
+void Mesh::RenderMeshlets(rendering::RenderContext &context, const glm::mat4 &transform,
+                          const MeshletDraws &draws) {
+  VR_ASSERT(draws.primitives.size() == primitives_.size());
+
+  for (size_t i = 0; i < primitives_.size(); i++) {
+    const auto &primitive = primitives_[i];
+    const auto &range = draws.primitives[i];
+    if (primitive.meshlet_count != 0 && draws.commands == nullptr) {
+      continue;
+    }
+
+    BindGeometry(context, transform, i);
+    if (range.max_count != 0) {
+      context.command_buffer->DrawIndexedIndirectCount(*draws.commands, range.command_offset, *draws.counts,
+                                                       range.count_offset, range.max_count);
+    } else {
+      context.command_buffer->DrawIndexed(primitive.index_count, 1, 0,
+                                          static_cast<int32_t>(primitive.vertex_start), 0);
+    }
   }
 }
 
-}  // namespace vre::rendering
\ No newline at end of file
+}  // namespace vre::rendering
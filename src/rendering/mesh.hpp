@@ -1,14 +1,20 @@
 #pragma once
 
+#include <limits>
+
 #include "common.hpp"
 
+#include "geometry/mesh_optimizer.hpp"
+#include "geometry/meshlets.hpp"
 #include "rendering/buffers.hpp"
+#include "rendering/meshlet_renderer.hpp"
 #include "rendering/render_core.hpp"
 #include "rendering/shader.hpp"
 
 namespace vre::rendering {
 
 class RenderCore;
+class UploadBatch;
 
 struct Primitive {
   uint32_t index_start = 0;
@@ -16,24 +22,227 @@ struct Primitive {
 
   uint32_t index_count = 0;
   uint32_t vertex_count = 0;
+
+  int32_t material = -1;
+
+  // Simplified versions of the primitive, finest first, in Mesh::GetLods().
+  uint32_t lod_start = 0;
+  uint32_t lod_count = 0;
+
+  // Clusters of the full resolution primitive in Mesh::GetMeshlets(), only built for dense meshes.
+  uint32_t meshlet_start = 0;
+  uint32_t meshlet_count = 0;
+};
+
+struct PrimitiveLod {
+  uint32_t index_start = 0;
+  uint32_t index_count = 0;
+
+  // Object space deviation from the full resolution primitive.
+  float error = 0.0F;
+};
+
+struct Bounds {
+  glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+  glm::vec3 max = glm::vec3(std::numeric_limits<float>::lowest());
+
+  void Extend(const glm::vec3 &point) {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+  }
+
+  [[nodiscard]] bool IsValid() const { return min.x <= max.x && min.y <= max.y && min.z <= max.z; }
+  [[nodiscard]] glm::vec3 GetCenter() const { return (min + max) * 0.5F; }
+  [[nodiscard]] glm::vec3 GetExtent() const { return (max - min) * 0.5F; }
+};
+
+// Geometry in the layout uploaded to the GPU, see Mesh::PackGeometry(). Cooked scenes store it as is, so
+// it is uploaded straight from the mapped file.
+struct GpuGeometry {
+  const uint8_t *vertices = nullptr;
+  size_t vertex_size = 0;
+  const uint8_t *indices = nullptr;
+  size_t index_size = 0;
+
+  const GpuMeshlet *meshlets = nullptr;
+  uint32_t meshlet_count = 0;
+  const uint32_t *meshlet_vertices = nullptr;
+  uint32_t meshlet_vertex_count = 0;
+  const uint8_t *meshlet_triangles = nullptr;
+  uint32_t meshlet_triangle_size = 0;
+
+  [[nodiscard]] VkDeviceSize GetSize() const {
+    return vertex_size + index_size + VkDeviceSize(meshlet_count) * sizeof(GpuMeshlet) +
+           VkDeviceSize(meshlet_vertex_count) * sizeof(uint32_t) + meshlet_triangle_size;
+  }
 };
 
 class Mesh {
  public:
+  static constexpr uint32_t kMaxLodCount = 6;
+  // Meshes with fewer triangles are drawn whole, culling them per meshlet costs more than it saves.
+  static constexpr uint32_t kMinMeshletTriangleCount = 4096;
+
+  // Each primitive and each of its LODs gets its own section of the index buffer with indices relative to
+  // the primitive's first vertex, so primitives with less than 64k vertices use 16-bit indices. Sections
+  // of all primitives come first, followed by the sections of GetLods().
+  struct IndexSection {
+    VkDeviceSize offset = 0;
+    VkIndexType type = VK_INDEX_TYPE_UINT32;
+  };
+
+  struct PrimitiveStorage {
+    glm::vec3 *positions = nullptr;
+    uint32_t *indices = nullptr;
+    uint32_t vertex_start = 0;
+  };
+
+  void Reserve(size_t vertex_count, size_t index_count);
+
+  // Appends a primitive with uninitialized data and returns where it has to be written, so loaders can
+  // decode straight into the mesh. Indices must be rebased by |vertex_start|. Pointers stay valid until
+  // the next allocation that exceeds the reserved capacity.
+  PrimitiveStorage AllocatePrimitive(uint32_t vertex_count, uint32_t index_count, int32_t material = -1);
   void AddPrimitive(std::vector<glm::vec3> vert, const std::vector<uint32_t> &indicies);
 
+  // Uses geometry stored elsewhere (e.g. a memory mapped cooked scene) instead of an own copy. |owner|
+  // keeps that memory alive for as long as the mesh exists.
+  void SetExternalGeometry(std::shared_ptr<const void> owner, const glm::vec3 *positions,
+                           uint32_t vertex_count, const uint32_t *indices, uint32_t index_count,
+                           std::vector<Primitive> primitives, std::vector<PrimitiveLod> lods,
+                           const Bounds &bounds);
+  // Uploads |geometry| as is instead of packing the external positions and indices. It lives in the memory
+  // kept alive by the owner of SetExternalGeometry().
+  void SetExternalGpuGeometry(VertexFormat vertex_format, const glm::mat4 &dequantize_transform,
+                              std::vector<IndexSection> index_sections, const GpuGeometry &geometry);
+  [[nodiscard]] bool HasExternalGpuGeometry() const { return external_.has_gpu_geometry; }
+
+  void ComputeBounds();
+
+  // Welds duplicate vertices and reorders every primitive for the post-transform cache and for vertex
+  // fetch. Meant for import/cook time, before the mesh is uploaded.
+  geometry::OptimizationReport Optimize();
+
+  // Builds up to |max_lod_count| - 1 simplified index lists per primitive, each with about |reduction|
+  // of the previous triangle count. They share the vertex data of the full resolution primitive.
+  void GenerateLods(uint32_t max_lod_count = kMaxLodCount, float reduction = 0.5F);
+
+  // LOD 0 is the full resolution mesh.
+  [[nodiscard]] uint32_t GetLodCount() const;
+  [[nodiscard]] float GetLodError(uint32_t lod) const;
+  [[nodiscard]] uint32_t GetLodIndexCount(size_t primitive, uint32_t lod) const;
+  // First index into GetIndices() and index count of |primitive| at |lod|.
+  [[nodiscard]] std::pair<uint32_t, uint32_t> GetLodIndexRange(size_t primitive, uint32_t lod) const;
+  [[nodiscard]] const std::vector<PrimitiveLod> &GetLods() const { return lods_; }
+
+  // Splits the full resolution primitives of dense meshes into meshlets for GPU culling. Run it after
+  // Optimize(), meshlets follow the triangle order.
+  void GenerateMeshlets();
+  [[nodiscard]] bool HasMeshlets() const {
+    return external_.has_gpu_geometry ? external_.gpu_geometry.meshlet_count != 0
+                                      : !meshlets_.meshlets.empty();
+  }
+  [[nodiscard]] const geometry::MeshletData &GetMeshlets() const { return meshlets_; }
+
+  [[nodiscard]] const Bounds &GetBounds() const { return bounds_; }
+  [[nodiscard]] const std::vector<Primitive> &GetPrimitives() const { return primitives_; }
+
+  [[nodiscard]] const glm::vec3 *GetPositions() const;
+  [[nodiscard]] uint32_t GetVertexCount() const;
+  [[nodiscard]] const uint32_t *GetIndices() const;
+  [[nodiscard]] uint32_t GetIndexCount() const;
+  // Bytes uploaded for the mesh in the current vertex format.
+  [[nodiscard]] VkDeviceSize GetGeometrySize() const;
+
+  [[nodiscard]] bool IsUploaded() const { return material_ != nullptr; }
+
+  // Selects how positions are stored on the GPU, must be called before packing or uploading.
+  void SetVertexFormat(VertexFormat format);
+  [[nodiscard]] VertexFormat GetVertexFormat() const { return vertex_format_; }
+
+  // Builds the GPU layout of the geometry in the current vertex format, valid until the upload or the next
+  // call. Also decides GetIndexSections() and GetDequantizeTransform().
+  GpuGeometry PackGeometry();
+  [[nodiscard]] const std::vector<IndexSection> &GetIndexSections() const { return index_sections_; }
+
+  // Uploads geometry once; meshes shared between nodes and prefab instances are initialized only once.
   void InitializeVulkan(RenderCore &renderer);
-  void Render(rendering::RenderContext &context, const glm::mat4 &transform);
+  void InitializeVulkan(RenderCore &renderer, UploadBatch &batch);
+  void Render(rendering::RenderContext &context, const glm::mat4 &transform, uint32_t lod = 0);
+  // Draws the full resolution mesh with the meshlets that survived MeshletRenderer culling.
+  void RenderMeshlets(rendering::RenderContext &context, const glm::mat4 &transform,
+                      const MeshletDraws &draws);
+  // Draws every primitive of |lod| from consecutive VkDrawIndexedIndirectCommands at |offset|, with
+  // instance counts decided on the GPU (see OcclusionCuller).
+  void RenderIndirect(rendering::RenderContext &context, const glm::mat4 &transform, uint32_t lod,
+                      const Buffer &commands, VkDeviceSize offset);
+
+  // GPU data read by MeshletRenderer, available once uploaded.
+  [[nodiscard]] const Buffer &GetVertexBuffer() const { return *vertex_buffer_; }
+  [[nodiscard]] const Buffer &GetMeshletBuffer() const { return *meshlet_buffer_; }
+  [[nodiscard]] const Buffer &GetMeshletVertexBuffer() const { return *meshlet_vertex_buffer_; }
+  [[nodiscard]] const Buffer &GetMeshletTriangleBuffer() const { return *meshlet_triangle_buffer_; }
+  [[nodiscard]] const glm::mat4 &GetDequantizeTransform() const { return dequantize_transform_; }
 
  private:
   std::vector<Primitive> primitives_;
+  std::vector<PrimitiveLod> lods_;
+  geometry::MeshletData meshlets_;
 
   std::vector<glm::vec3> pos_;
   std::vector<uint32_t> indicies_;
+  Bounds bounds_;
+  VertexFormat vertex_format_ = VertexFormat::kFloat32;
+
+  struct {
+    std::shared_ptr<const void> owner;
+    const glm::vec3 *positions = nullptr;
+    uint32_t vertex_count = 0;
+    const uint32_t *indices = nullptr;
+    uint32_t index_count = 0;
+    bool has_gpu_geometry = false;
+    GpuGeometry gpu_geometry;
+  } external_;
+
+  // Storage of PackGeometry(), released once uploaded.
+  struct {
+    std::vector<uint8_t> vertices;
+    std::vector<uint8_t> indices;
+    std::vector<GpuMeshlet> meshlets;
+  } packed_;
+
+  std::vector<IndexSection> index_sections_;
+
+  glm::mat4 dequantize_transform_ = glm::mat4(1.0F);
 
   std::shared_ptr<Buffer> index_buffer_;
   std::shared_ptr<Buffer> vertex_buffer_;
+  std::shared_ptr<Buffer> meshlet_buffer_;
+  std::shared_ptr<Buffer> meshlet_vertex_buffer_;
+  std::shared_ptr<Buffer> meshlet_triangle_buffer_;
   std::shared_ptr<Material> material_;
+
+ private:
+  struct IndexRange {
+    uint32_t index_start;
+    uint32_t index_count;
+    const Primitive *primitive;
+  };
+  // Ranges of GetIndices() in index section order.
+  [[nodiscard]] std::vector<IndexRange> GetIndexRanges() const;
+  // Returns the size of the index buffer.
+  static VkDeviceSize LayoutIndexSections(const std::vector<IndexRange> &ranges,
+                                          std::vector<IndexSection> &sections);
+
+  std::vector<uint8_t> BuildVertexData();
+  std::vector<uint8_t> BuildIndexData();
+  std::vector<GpuMeshlet> BuildMeshletData() const;
+  void CreateMeshletBuffers(UploadBatch &batch, const GpuGeometry &geometry);
+
+  // Index section and index count of |primitive| at |lod|.
+  [[nodiscard]] std::pair<size_t, uint32_t> GetLodSection(size_t primitive, uint32_t lod) const;
+  void BindGeometry(rendering::RenderContext &context, const glm::mat4 &transform, size_t section);
 };
+using MeshPtr = std::shared_ptr<Mesh>;
 
 }  // namespace vre::rendering
\ No newline at end of file
@@ -0,0 +1,516 @@
+#include "meshlet_renderer.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include "helpers.hpp"
+#include "rendering/mesh.hpp"
+#include "rendering/render_core.hpp"
+
+namespace vre::rendering {
+
+namespace {
+
+constexpr uint32_t kCullGroupSize = 64;
+constexpr uint32_t kTaskGroupSize = 32;
+constexpr uint64_t kStatisticsLogInterval = 120;
+
+enum Binding : uint32_t {
+  kMeshletsBinding,
+  kCommandsBinding,
+  kCountsBinding,
+  kFrameDataBinding,
+  kPositionsBinding,
+  kMeshletVerticesBinding,
+  kMeshletTrianglesBinding,
+  kViewBufferBinding,
+  kBindingCount,
+};
+
+VkDescriptorType GetDescriptorType(uint32_t binding) {
+  return binding == kFrameDataBinding || binding == kViewBufferBinding ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER
+                                                                       : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+}
+
+struct CullConstants {
+  glm::mat4 model;
+  glm::vec4 dequantize_scale;
+  glm::vec4 dequantize_offset;
+  uint32_t first_meshlet;
+  uint32_t meshlet_count;
+  uint32_t command_offset;
+  uint32_t count_index;
+  uint32_t vertex_format;
+};
+static_assert(sizeof(CullConstants) <= 128, "Push constants must fit the guaranteed minimum size");
+
+// Left, right, bottom and top planes of |view_projection|, normalized so distances are in world units. Near
+// and far are left to the rasterizer.
+std::array<glm::vec4, 4> GetFrustumPlanes(const glm::mat4 &view_projection) {
+  const auto row = [&](int i) {
+    return glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i],
+                     view_projection[3][i]);
+  };
+
+  std::array<glm::vec4, 4> planes = {row(3) + row(0), row(3) - row(0), row(3) + row(1), row(3) - row(1)};
+  for (auto &plane : planes) {
+    plane /= glm::length(glm::vec3(plane));
+  }
+  return planes;
+}
+
+VkShaderStageFlags GetShaderStages(bool mesh_shaders) {
+  VkShaderStageFlags stages = VK_SHADER_STAGE_COMPUTE_BIT;
+#ifdef VK_EXT_mesh_shader
+  if (mesh_shaders) {
+    stages |= VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT;
+  }
+#endif
+  return stages;
+}
+
+VkPipelineStageFlags GetCullingStages(bool mesh_shaders) {
+  VkPipelineStageFlags stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+#ifdef VK_EXT_mesh_shader
+  if (mesh_shaders) {
+    stages |= VK_PIPELINE_STAGE_TASK_SHADER_BIT_EXT;
+  }
+#endif
+  return stages;
+}
+
+VkPipelineShaderStageCreateInfo GetStageInfo(VkShaderStageFlagBits stage, const Shader &shader) {
+  VkPipelineShaderStageCreateInfo info{VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+  info.stage = stage;
+  info.module = shader.GetShaderModule();
+  info.pName = "main";
+  return info;
+}
+
+}  // namespace
+
+MeshletRenderer::MeshletRenderer(RenderCore &core) : core_(core), device_(core.GetDevice()) {
+  const auto &features = core_.GetPhysicalDevice().features;
+  supported_ = features.draw_indirect_count;
+  if (!supported_) {
+    SPDLOG_WARN("drawIndirectCount is not supported, meshlet culling is disabled");
+    return;
+  }
+#ifdef VK_EXT_mesh_shader
+  // Mesh shader pipelines are not built for multiview passes.
+  use_mesh_shaders_ = features.mesh_shader && core_.GetViewCount() == 1;
+#endif
+
+  CreateLayouts();
+  CreateFrames();
+
+  cull_shader_ = std::make_unique<Shader>(device_, Shader::kCompute, "assets/shaders/meshlet_cull.comp");
+
+  VkComputePipelineCreateInfo pipeline_info{VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+  pipeline_info.stage = GetStageInfo(VK_SHADER_STAGE_COMPUTE_BIT, *cull_shader_);
+  pipeline_info.layout = pipeline_layout_;
+  CHECK_VK_SUCCESS(
+      vkCreateComputePipelines(device_, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &cull_pipeline_));
+
+#ifdef VK_EXT_mesh_shader
+  if (use_mesh_shaders_) {
+    task_shader_ = std::make_unique<Shader>(device_, Shader::kTask, "assets/shaders/meshlet.task");
+    mesh_shader_ = std::make_unique<Shader>(device_, Shader::kMesh, "assets/shaders/meshlet.mesh");
+    fragment_shader_ = std::make_unique<Shader>(device_, Shader::kFragment, "assets/shaders/shader.frag");
+
+    draw_mesh_tasks_ = vkGetDeviceProcAddr(device_, "vkCmdDrawMeshTasksEXT");
+    VR_CHECK(draw_mesh_tasks_ != nullptr);
+  }
+#endif
+
+  if (features.pipeline_statistics_query) {
+    VkQueryPoolCreateInfo query_info{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+    query_info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    query_info.queryCount = core_.GetFramesInFlight();
+    query_info.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT;
+    CHECK_VK_SUCCESS(vkCreateQueryPool(device_, &query_info, nullptr, &query_pool_));
+  }
+
+  SPDLOG_INFO("Meshlet culling enabled, {} path", use_mesh_shaders_ ? "mesh shader" : "compute");
+}
+
+MeshletRenderer::~MeshletRenderer() {
+  if (!supported_) {
+    return;
+  }
+
+  for (auto &frame : frames_) {
+    vkDestroyDescriptorPool(device_, frame.descriptor_pool, nullptr);
+  }
+  frames_.clear();
+
+  if (query_pool_ != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(device_, query_pool_, nullptr);
+  }
+  for (const auto &[key, pipeline] : mesh_pipelines_) {
+    vkDestroyPipeline(device_, pipeline, nullptr);
+  }
+  vkDestroyPipeline(device_, cull_pipeline_, nullptr);
+  vkDestroyPipelineLayout(device_, pipeline_layout_, nullptr);
+  vkDestroyDescriptorSetLayout(device_, set_layout_, nullptr);
+}
+
+void MeshletRenderer::CreateLayouts() {
+  const auto stages = GetShaderStages(use_mesh_shaders_);
+
+  std::array<VkDescriptorSetLayoutBinding, kBindingCount> bindings{};
+  for (uint32_t i = 0; i < kBindingCount; i++) {
+    bindings[i].binding = i;
+    bindings[i].descriptorCount = 1;
+    bindings[i].descriptorType = GetDescriptorType(i);
+    bindings[i].stageFlags = stages;
+  }
+
+  VkDescriptorSetLayoutCreateInfo layout_info{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+  layout_info.bindingCount = bindings.size();
+  layout_info.pBindings = bindings.data();
+  CHECK_VK_SUCCESS(vkCreateDescriptorSetLayout(device_, &layout_info, nullptr, &set_layout_));
+
+  VkPushConstantRange push_constants{};
+  push_constants.stageFlags = stages;
+  push_constants.size = sizeof(CullConstants);
+
+  VkPipelineLayoutCreateInfo pipeline_layout_info{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+  pipeline_layout_info.setLayoutCount = 1;
+  pipeline_layout_info.pSetLayouts = &set_layout_;
+  pipeline_layout_info.pushConstantRangeCount = 1;
+  pipeline_layout_info.pPushConstantRanges = &push_constants;
+  CHECK_VK_SUCCESS(vkCreatePipelineLayout(device_, &pipeline_layout_info, nullptr, &pipeline_layout_));
+}
+
+void MeshletRenderer::CreateFrames() {
+  frames_.resize(core_.GetFramesInFlight());
+
+  for (auto &frame : frames_) {
+    CreateBufferInfo commands_info{};
+    commands_info.buffer_size = kMaxDrawsPerFrame * sizeof(VkDrawIndexedIndirectCommand);
+    commands_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    commands_info.memory_usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    frame.commands = core_.CreateBuffer(commands_info);
+
+    // Slot 0 counts visible triangles, every culled primitive gets one of the following draw counters.
+    CreateBufferInfo counts_info{};
+    counts_info.buffer_size = (kMaxBatchesPerFrame + 1) * sizeof(uint32_t);
+    counts_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                        VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    counts_info.memory_usage = VMA_MEMORY_USAGE_GPU_TO_CPU;
+    frame.counts = core_.CreateBuffer(counts_info);
+
+    CreateBufferInfo frame_data_info{};
+    frame_data_info.buffer_size = sizeof(FrameData);
+    frame_data_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    frame_data_info.memory_usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+    frame.frame_data = core_.CreateBuffer(frame_data_info);
+
+    const VkDescriptorPoolSize pool_sizes[] = {
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, (kBindingCount - 2) * kMaxMeshesPerFrame},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 * kMaxMeshesPerFrame},
+    };
+
+    VkDescriptorPoolCreateInfo pool_info{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    pool_info.maxSets = kMaxMeshesPerFrame;
+    pool_info.poolSizeCount = 2;
+    pool_info.pPoolSizes = pool_sizes;
+    CHECK_VK_SUCCESS(vkCreateDescriptorPool(device_, &pool_info, nullptr, &frame.descriptor_pool));
+  }
+}
+
+VkPipeline MeshletRenderer::BuildMeshPipeline(VkRenderPass render_pass, uint32_t subpass) {
+  VkPipeline pipeline = VK_NULL_HANDLE;
+#ifdef VK_EXT_mesh_shader
+  const VkPipelineShaderStageCreateInfo stages[] = {
+      GetStageInfo(VK_SHADER_STAGE_TASK_BIT_EXT, *task_shader_),
+      GetStageInfo(VK_SHADER_STAGE_MESH_BIT_EXT, *mesh_shader_),
+      GetStageInfo(VK_SHADER_STAGE_FRAGMENT_BIT, *fragment_shader_),
+  };
+
+  VkPipelineViewportStateCreateInfo viewport_state{VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
+  viewport_state.viewportCount = 1;
+  viewport_state.scissorCount = 1;
+
+  const VkDynamicState dynamic_states[] = {VK_DYNAMIC_STATE_SCISSOR, VK_DYNAMIC_STATE_VIEWPORT};
+  VkPipelineDynamicStateCreateInfo dynamic_state{VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
+  dynamic_state.dynamicStateCount = 2;
+  dynamic_state.pDynamicStates = dynamic_states;
+
+  VkPipelineRasterizationStateCreateInfo rasterizer{
+      VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
+  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+  rasterizer.lineWidth = 1.0F;
+  rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+  rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+  VkPipelineMultisampleStateCreateInfo multisampling{
+      VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
+  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+  // Mesh shader draws are not part of the depth pre-pass, so they always test and write depth.
+  VkPipelineDepthStencilStateCreateInfo depth_stencil{
+      VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO};
+  depth_stencil.depthTestEnable = VK_TRUE;
+  depth_stencil.depthWriteEnable = VK_TRUE;
+  depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS;
+
+  VkPipelineColorBlendAttachmentState color_blend_attachment{};
+  color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                          VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+  VkPipelineColorBlendStateCreateInfo color_blending{
+      VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
+  color_blending.attachmentCount = 1;
+  color_blending.pAttachments = &color_blend_attachment;
+
+  VkGraphicsPipelineCreateInfo pipeline_info{VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+  pipeline_info.stageCount = 3;
+  pipeline_info.pStages = stages;
+  pipeline_info.pViewportState = &viewport_state;
+  pipeline_info.pDynamicState = &dynamic_state;
+  pipeline_info.pRasterizationState = &rasterizer;
+  pipeline_info.pMultisampleState = &multisampling;
+  pipeline_info.pDepthStencilState = &depth_stencil;
+  pipeline_info.pColorBlendState = &color_blending;
+  pipeline_info.layout = pipeline_layout_;
+  pipeline_info.renderPass = render_pass;
+  pipeline_info.subpass = subpass;
+
+  CHECK_VK_SUCCESS(vkCreateGraphicsPipelines(device_, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &pipeline));
+#endif
+  return pipeline;
+}
+
+void MeshletRenderer::BeginCulling(RenderContext &context) {
+  VR_ASSERT(supported_);
+
+  frame_index_ = core_.GetFrameIndex();
+  frame_ = &frames_[frame_index_];
+
+  // The last frame of this slot has been waited for, so the counters of its previous use are final.
+  CollectStatistics();
+
+  CHECK_VK_SUCCESS(vkResetDescriptorPool(device_, frame_->descriptor_pool, 0));
+  frame_->set_count = 0;
+  frame_->batch_count = 0;
+  frame_->draw_count = 0;
+  frame_->submitted_triangles = 0;
+  frame_->has_results = true;
+  frame_->has_query = false;
+
+  FrameData frame_data{};
+  // Culling keeps the camera of the snapshot, positions are transformed with the view buffer.
+  frame_data.planes =
+      GetFrustumPlanes(context.render_data.camera_projection * context.render_data.camera_view);
+  frame_data.camera_position = glm::vec4(context.render_data.camera_position, 1.0F);
+  // Turning the cameras by an angle moves a sphere by at most its distance from the eye times the angle.
+  const auto eye_offset = context.render_data.eye_offset;
+  frame_data.cone_margin = eye_offset + kMaxLatchTranslation;
+  frame_data.frustum_margin =
+      glm::vec2(kMaxLatchRotation * eye_offset + kMaxLatchTranslation, kMaxLatchRotation);
+  frame_->frame_data->Update(&frame_data);
+
+  const auto command_buffer = context.command_buffer->GetBuffer();
+  vkCmdFillBuffer(command_buffer, frame_->counts->GetBuffer(), 0, VK_WHOLE_SIZE, 0);
+  if (query_pool_ != VK_NULL_HANDLE) {
+    vkCmdResetQueryPool(command_buffer, query_pool_, frame_index_, 1);
+  }
+
+  VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, GetCullingStages(use_mesh_shaders_), 0,
+                       1, &barrier, 0, nullptr, 0, nullptr);
+
+  if (!use_mesh_shaders_) {
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull_pipeline_);
+  }
+}
+
+MeshletDraws MeshletRenderer::Cull(RenderContext &context, const Mesh &mesh, const glm::mat4 &transform) {
+  VR_ASSERT(frame_ != nullptr && !use_mesh_shaders_);
+
+  const auto &primitives = mesh.GetPrimitives();
+  MeshletDraws draws{frame_->commands.get(), frame_->counts.get()};
+  draws.primitives.resize(primitives.size());
+  if (!mesh.HasMeshlets() || frame_->set_count == kMaxMeshesPerFrame) {
+    return draws;
+  }
+
+  const auto command_buffer = context.command_buffer->GetBuffer();
+  const auto descriptor_set = AllocateSet(mesh);
+  vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout_, 0, 1,
+                          &descriptor_set, 0, nullptr);
+
+  for (size_t i = 0; i < primitives.size(); i++) {
+    const auto &primitive = primitives[i];
+    // Primitives that do not fit into this frame's buffers are drawn whole.
+    if (primitive.meshlet_count == 0 || frame_->batch_count == kMaxBatchesPerFrame ||
+        frame_->draw_count + primitive.meshlet_count > kMaxDrawsPerFrame) {
+      continue;
+    }
+
+    const auto count_index = ++frame_->batch_count;
+    auto &range = draws.primitives[i];
+    range.command_offset = VkDeviceSize(frame_->draw_count) * sizeof(VkDrawIndexedIndirectCommand);
+    range.count_offset = VkDeviceSize(count_index) * sizeof(uint32_t);
+    range.max_count = primitive.meshlet_count;
+
+    PushConstants(command_buffer, mesh, transform, primitive.meshlet_start, primitive.meshlet_count,
+                  frame_->draw_count, count_index);
+    vkCmdDispatch(command_buffer, (primitive.meshlet_count + kCullGroupSize - 1) / kCullGroupSize, 1, 1);
+
+    frame_->draw_count += primitive.meshlet_count;
+    frame_->submitted_triangles += primitive.index_count / 3;
+  }
+
+  return draws;
+}
+
+void MeshletRenderer::EndCulling(RenderContext &context) {
+  VkMemoryBarrier barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+  barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+  vkCmdPipelineBarrier(context.command_buffer->GetBuffer(), VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void MeshletRenderer::BeginStatistics(RenderContext &context) {
+  VR_ASSERT(frame_ != nullptr);
+
+  if (query_pool_ != VK_NULL_HANDLE) {
+    vkCmdBeginQuery(context.command_buffer->GetBuffer(), query_pool_, frame_index_, 0);
+    frame_->has_query = true;
+  }
+}
+
+void MeshletRenderer::EndStatistics(RenderContext &context) {
+  if (frame_ != nullptr && frame_->has_query) {
+    vkCmdEndQuery(context.command_buffer->GetBuffer(), query_pool_, frame_index_);
+  }
+}
+
+MeshletDraws MeshletRenderer::DrawMeshTasks(RenderContext &context, const Mesh &mesh,
+                                            const glm::mat4 &transform) {
+  VR_ASSERT(frame_ != nullptr && use_mesh_shaders_);
+
+  const auto &primitives = mesh.GetPrimitives();
+  MeshletDraws draws{};
+  draws.primitives.resize(primitives.size());
+  if (!mesh.HasMeshlets() || frame_->set_count == kMaxMeshesPerFrame) {
+    draws.commands = frame_->commands.get();
+    return draws;
+  }
+
+#ifdef VK_EXT_mesh_shader
+  const auto command_buffer = context.command_buffer->GetBuffer();
+  const auto &render_pass = context.command_buffer->GetRenderPass();
+  const std::pair key{render_pass.GetCompatibilityId(), context.command_buffer->GetSubpass()};
+  auto &mesh_pipeline = mesh_pipelines_[key];
+  if (mesh_pipeline == VK_NULL_HANDLE) {
+    mesh_pipeline = BuildMeshPipeline(render_pass.GetRenderPass(), key.second);
+  }
+
+  const auto descriptor_set = AllocateSet(mesh);
+  vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mesh_pipeline);
+  vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0, 1,
+                          &descriptor_set, 0, nullptr);
+
+  const auto draw_mesh_tasks = reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(draw_mesh_tasks_);
+  for (const auto &primitive : primitives) {
+    if (primitive.meshlet_count == 0) {
+      continue;
+    }
+
+    PushConstants(command_buffer, mesh, transform, primitive.meshlet_start, primitive.meshlet_count, 0, 0);
+    draw_mesh_tasks(command_buffer, (primitive.meshlet_count + kTaskGroupSize - 1) / kTaskGroupSize, 1, 1);
+    frame_->submitted_triangles += primitive.index_count / 3;
+  }
+#endif
+
+  return draws;
+}
+
+void MeshletRenderer::CollectStatistics() {
+  if (!frame_->has_results) {
+    return;
+  }
+
+  frame_->counts->Invalidate();
+  statistics_.submitted_triangles = frame_->submitted_triangles;
+  statistics_.visible_triangles = static_cast<const uint32_t *>(frame_->counts->GetMappedData())[0];
+  statistics_.rasterized_primitives = 0;
+
+  if (frame_->has_query) {
+    uint64_t rasterized_primitives = 0;
+    if (vkGetQueryPoolResults(device_, query_pool_, frame_index_, 1, sizeof(rasterized_primitives),
+                              &rasterized_primitives, sizeof(rasterized_primitives),
+                              VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+      statistics_.rasterized_primitives = rasterized_primitives;
+    }
+  }
+
+  if (++frame_counter_ % kStatisticsLogInterval == 0) {
+    SPDLOG_INFO("Meshlets: {} triangles submitted, {} after culling, {} primitives rasterized",
+                statistics_.submitted_triangles, statistics_.visible_triangles,
+                statistics_.rasterized_primitives);
+  }
+}
+
+VkDescriptorSet MeshletRenderer::AllocateSet(const Mesh &mesh) {
+  VkDescriptorSetAllocateInfo alloc_info{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+  alloc_info.descriptorPool = frame_->descriptor_pool;
+  alloc_info.descriptorSetCount = 1;
+  alloc_info.pSetLayouts = &set_layout_;
+
+  VkDescriptorSet descriptor_set;
+  CHECK_VK_SUCCESS(vkAllocateDescriptorSets(device_, &alloc_info, &descriptor_set));
+  frame_->set_count++;
+
+  const auto &view_buffer = core_.GetViewBuffer(core_.GetFrameIndex());
+  const std::array<const Buffer *, kBindingCount> buffers = {
+      &mesh.GetMeshletBuffer(),         frame_->commands.get(),  frame_->counts.get(),
+      frame_->frame_data.get(),         &mesh.GetVertexBuffer(), &mesh.GetMeshletVertexBuffer(),
+      &mesh.GetMeshletTriangleBuffer(), &view_buffer,
+  };
+
+  std::array<VkDescriptorBufferInfo, kBindingCount> buffer_infos{};
+  std::array<VkWriteDescriptorSet, kBindingCount> writes{};
+  for (uint32_t i = 0; i < kBindingCount; i++) {
+    buffer_infos[i].buffer = buffers[i]->GetBuffer();
+    buffer_infos[i].range = VK_WHOLE_SIZE;
+
+    writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].dstSet = descriptor_set;
+    writes[i].dstBinding = i;
+    writes[i].descriptorCount = 1;
+    writes[i].descriptorType = GetDescriptorType(i);
+    writes[i].pBufferInfo = &buffer_infos[i];
+  }
+  vkUpdateDescriptorSets(device_, writes.size(), writes.data(), 0, nullptr);
+
+  return descriptor_set;
+}
+
+void MeshletRenderer::PushConstants(VkCommandBuffer command_buffer, const Mesh &mesh,
+                                    const glm::mat4 &transform, uint32_t first_meshlet,
+                                    uint32_t meshlet_count, uint32_t command_offset, uint32_t count_index) {
+  const auto &dequantize = mesh.GetDequantizeTransform();
+
+  // Meshlet bounds are in object space, only the mesh shader decodes quantized positions.
+  CullConstants constants{};
+  constants.model = transform;
+  constants.dequantize_scale = glm::vec4(dequantize[0][0], dequantize[1][1], dequantize[2][2], 0.0F);
+  constants.dequantize_offset = glm::vec4(glm::vec3(dequantize[3]), 0.0F);
+  constants.first_meshlet = first_meshlet;
+  constants.meshlet_count = meshlet_count;
+  constants.command_offset = command_offset;
+  constants.count_index = count_index;
+  constants.vertex_format = static_cast<uint32_t>(mesh.GetVertexFormat());
+
+  vkCmdPushConstants(command_buffer, pipeline_layout_, GetShaderStages(use_mesh_shaders_), 0,
+                     sizeof(constants), &constants);
+}
+
+}  // namespace vre::rendering
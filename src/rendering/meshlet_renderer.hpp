@@ -0,0 +1,162 @@
+#pragma once
+
+#include <array>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "common.hpp"
+#include "rendering/buffers.hpp"
+#include "rendering/shader.hpp"
+
+namespace vre::rendering {
+
+class Mesh;
+class RenderCore;
+struct RenderContext;
+
+// Meshlet as read by assets/shaders/meshlet_cull.comp and the mesh shader path.
+struct GpuMeshlet {
+  glm::vec4 sphere;  // Object space center and radius.
+  glm::vec4 cone;    // Axis and cutoff, see geometry::MeshletBounds.
+
+  uint32_t first_index;  // Relative to the index section of the primitive.
+  uint32_t index_count;
+  int32_t base_vertex;
+  uint32_t reserved;
+
+  uint32_t vertex_offset;
+  uint32_t vertex_count;
+  uint32_t triangle_offset;  // In bytes.
+  uint32_t triangle_count;
+};
+static_assert(sizeof(GpuMeshlet) == 64, "GpuMeshlet must match the shader layout");
+
+// Where MeshletRenderer::Cull wrote the draws of the visible meshlets, one range per primitive. Ranges with
+// a zero |max_count| are drawn whole; without |commands| the meshlets were drawn by mesh shaders already.
+struct MeshletDraws {
+  struct Range {
+    VkDeviceSize command_offset = 0;
+    VkDeviceSize count_offset = 0;
+    uint32_t max_count = 0;
+  };
+
+  const Buffer *commands = nullptr;
+  const Buffer *counts = nullptr;
+  std::vector<Range> primitives;
+};
+
+struct MeshletStatistics {
+  // Triangles of the meshes handed to culling.
+  uint64_t submitted_triangles = 0;
+  // Triangles of the meshlets that survived frustum and cone culling.
+  uint64_t visible_triangles = 0;
+  // Primitives that reached the rasterizer during the main pass, zero without pipeline statistics queries.
+  uint64_t rasterized_primitives = 0;
+};
+
+// Culls meshlets of dense meshes on the GPU. The compute path writes compacted indirect draws over the
+// mesh index buffer; with VK_EXT_mesh_shader the task shader culls and the mesh shader draws instead.
+class MeshletRenderer {
+ public:
+  static constexpr uint32_t kMaxDrawsPerFrame = 256 * 1024;
+  static constexpr uint32_t kMaxBatchesPerFrame = 4096;
+  static constexpr uint32_t kMaxMeshesPerFrame = 1024;
+
+  explicit MeshletRenderer(RenderCore &core);
+  ~MeshletRenderer();
+
+  MeshletRenderer(MeshletRenderer &) = delete;
+  MeshletRenderer(MeshletRenderer &&) = delete;
+
+  // Indirect draws need drawIndirectCount; without it meshes are drawn whole.
+  [[nodiscard]] bool IsSupported() const { return supported_; }
+  [[nodiscard]] bool UsesMeshShaders() const { return use_mesh_shaders_; }
+
+  // Recorded before the main render pass.
+  void BeginCulling(RenderContext &context);
+  [[nodiscard]] MeshletDraws Cull(RenderContext &context, const Mesh &mesh, const glm::mat4 &transform);
+  void EndCulling(RenderContext &context);
+
+  // Recorded inside the shading subpass of the main render pass.
+  void BeginStatistics(RenderContext &context);
+  void EndStatistics(RenderContext &context);
+  // Culls in the task shader and draws the visible meshlets from the mesh shader. The returned draws leave
+  // only primitives without meshlets to Mesh::RenderMeshlets.
+  [[nodiscard]] MeshletDraws DrawMeshTasks(RenderContext &context, const Mesh &mesh,
+                                           const glm::mat4 &transform);
+
+  // Counters of the last frame whose results are available.
+  [[nodiscard]] const MeshletStatistics &GetStatistics() const { return statistics_; }
+
+ private:
+  struct FrameData {
+    std::array<glm::vec4, 4> planes;
+    glm::vec4 camera_position;
+    // How far the eyes may sit from |camera_position|, the cone test widens by it times (1 + |cutoff|).
+    float cone_margin;
+    // std140 aligns the vec2 to 8 bytes.
+    float padding;
+    // Widens the frustum test by how far the late latch may move a sphere: constant and per unit of distance
+    // from |camera_position|.
+    glm::vec2 frustum_margin;
+  };
+  static_assert(offsetof(FrameData, cone_margin) == 80, "FrameData must match the std140 layout");
+  static_assert(offsetof(FrameData, frustum_margin) == 88, "FrameData must match the std140 layout");
+  static_assert(sizeof(FrameData) == 96, "FrameData must match the std140 layout");
+
+  struct Frame {
+    std::shared_ptr<Buffer> commands;
+    std::shared_ptr<Buffer> counts;
+    std::shared_ptr<Buffer> frame_data;
+    VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+
+    uint32_t set_count = 0;
+    uint32_t batch_count = 0;
+    uint32_t draw_count = 0;
+    uint64_t submitted_triangles = 0;
+    bool has_results = false;
+    bool has_query = false;
+  };
+
+  RenderCore &core_;
+  VkDevice device_;
+
+  bool supported_ = false;
+  bool use_mesh_shaders_ = false;
+
+  VkDescriptorSetLayout set_layout_ = VK_NULL_HANDLE;
+  VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
+
+  std::unique_ptr<Shader> cull_shader_;
+  VkPipeline cull_pipeline_ = VK_NULL_HANDLE;
+
+  std::unique_ptr<Shader> task_shader_;
+  std::unique_ptr<Shader> mesh_shader_;
+  std::unique_ptr<Shader> fragment_shader_;
+  // Keyed by render pass compatibility id and subpass, the main pass changes with the depth pre-pass.
+  std::map<std::pair<uint64_t, uint32_t>, VkPipeline> mesh_pipelines_;
+  PFN_vkVoidFunction draw_mesh_tasks_ = nullptr;
+
+  VkQueryPool query_pool_ = VK_NULL_HANDLE;
+
+  std::vector<Frame> frames_;
+  Frame *frame_ = nullptr;
+  uint32_t frame_index_ = 0;
+
+  MeshletStatistics statistics_;
+  uint64_t frame_counter_ = 0;
+
+ private:
+  void CreateLayouts();
+  void CreateFrames();
+  VkPipeline BuildMeshPipeline(VkRenderPass render_pass, uint32_t subpass);
+
+  void CollectStatistics();
+  VkDescriptorSet AllocateSet(const Mesh &mesh);
+  void PushConstants(VkCommandBuffer command_buffer, const Mesh &mesh, const glm::mat4 &transform,
+                     uint32_t first_meshlet, uint32_t meshlet_count, uint32_t command_offset,
+                     uint32_t count_index);
+};
+
+}  // namespace vre::rendering
@@ -0,0 +1,611 @@
+#include "occlusion_culler.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <algorithm>
+
+#include "helpers.hpp"
+#include "rendering/mesh.hpp"
+#include "rendering/render_core.hpp"
+
+namespace vre::rendering {
+
+namespace {
+
+constexpr uint32_t kCullGroupSize = 64;
+constexpr uint32_t kPyramidGroupSize = 8;
+constexpr uint32_t kPhaseCount = 2;
+// Slots freed in a frame are reused only in the next one, so two frames worth of instances may hold a slot.
+constexpr uint32_t kSlotCount = 2 * OcclusionCuller::kMaxInstancesPerFrame;
+
+enum CullBinding : uint32_t {
+  kInstancesBinding,
+  kDrawsBinding,
+  kCommandsBinding,
+  kVisibilityBinding,
+  kFrameDataBinding,
+  kViewBufferBinding,
+  kPyramidBinding,
+  kCullBindingCount,
+};
+
+struct GpuInstance {
+  glm::vec4 bounds_min;
+  glm::vec4 bounds_max;
+  uint32_t slot;
+  uint32_t first_draw;
+  uint32_t draw_count;
+  uint32_t reserved;
+};
+static_assert(sizeof(GpuInstance) == 48, "GpuInstance must match the shader layout");
+
+struct GpuDraw {
+  uint32_t index_count;
+  int32_t vertex_offset;
+};
+
+struct CullConstants {
+  uint32_t instance_count;
+  uint32_t phase;
+  uint32_t command_offset;
+};
+
+struct PyramidConstants {
+  glm::ivec2 source_size;
+  glm::ivec2 destination_size;
+};
+
+uint32_t PreviousPowerOfTwo(uint32_t value) {
+  uint32_t result = 1;
+  while (result * 2 <= value) {
+    result *= 2;
+  }
+  return result;
+}
+
+uint32_t GetLevelCount(const VkExtent2D &extent) {
+  uint32_t levels = 1;
+  while ((std::max(extent.width, extent.height) >> levels) != 0) {
+    levels++;
+  }
+  return levels;
+}
+
+VkPipeline CreateComputePipeline(VkDevice device, const Shader &shader, VkPipelineLayout layout) {
+  VkComputePipelineCreateInfo pipeline_info{VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+  pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipeline_info.stage.module = shader.GetShaderModule();
+  pipeline_info.stage.pName = "main";
+  pipeline_info.layout = layout;
+
+  VkPipeline pipeline;
+  CHECK_VK_SUCCESS(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &pipeline));
+  return pipeline;
+}
+
+VkImageView CreateView(VkDevice device, VkImage image, VkFormat format, VkImageAspectFlags aspects,
+                       uint32_t base_level, uint32_t levels) {
+  VkImageViewCreateInfo view_info{VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+  view_info.image = image;
+  view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  view_info.format = format;
+  view_info.subresourceRange.aspectMask = aspects;
+  view_info.subresourceRange.baseMipLevel = base_level;
+  view_info.subresourceRange.levelCount = levels;
+  view_info.subresourceRange.baseArrayLayer = 0;
+  view_info.subresourceRange.layerCount = 1;
+
+  VkImageView view;
+  CHECK_VK_SUCCESS(vkCreateImageView(device, &view_info, nullptr, &view));
+  return view;
+}
+
+}  // namespace
+
+OcclusionCuller::OcclusionCuller(RenderCore &core) : core_(core), device_(core.GetDevice()) {
+  VkSamplerCreateInfo sampler_info{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+  sampler_info.magFilter = VK_FILTER_NEAREST;
+  sampler_info.minFilter = VK_FILTER_NEAREST;
+  sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+  sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+  sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+  CHECK_VK_SUCCESS(vkCreateSampler(device_, &sampler_info, nullptr, &sampler_));
+
+  CreateLayouts();
+  CreatePipelines();
+  CreateFrames();
+
+  CreateBufferInfo visibility_info{};
+  visibility_info.buffer_size = kSlotCount * sizeof(uint32_t);
+  visibility_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  visibility_info.memory_usage = VMA_MEMORY_USAGE_GPU_ONLY;
+  visibility_ = core_.CreateBuffer(visibility_info);
+
+  SPDLOG_INFO("Hierarchical-Z occlusion culling enabled");
+}
+
+OcclusionCuller::~OcclusionCuller() {
+  DestroyPyramid(pyramid_);
+  for (auto &pyramid : retired_pyramids_) {
+    DestroyPyramid(pyramid);
+  }
+
+  frames_.clear();
+  visibility_.reset();
+
+  vkDestroyDescriptorPool(device_, descriptor_pool_, nullptr);
+  vkDestroyPipeline(device_, pyramid_pipeline_, nullptr);
+  vkDestroyPipeline(device_, cull_pipeline_, nullptr);
+  vkDestroyPipelineLayout(device_, pyramid_pipeline_layout_, nullptr);
+  vkDestroyPipelineLayout(device_, cull_pipeline_layout_, nullptr);
+  vkDestroyDescriptorSetLayout(device_, pyramid_set_layout_, nullptr);
+  vkDestroyDescriptorSetLayout(device_, cull_set_layout_, nullptr);
+  vkDestroySampler(device_, sampler_, nullptr);
+}
+
+void OcclusionCuller::CreateLayouts() {
+  std::array<VkDescriptorSetLayoutBinding, kCullBindingCount> cull_bindings{};
+  for (uint32_t i = 0; i < kCullBindingCount; i++) {
+    cull_bindings[i].binding = i;
+    cull_bindings[i].descriptorCount = 1;
+    cull_bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    cull_bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  }
+  cull_bindings[kFrameDataBinding].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  cull_bindings[kViewBufferBinding].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  cull_bindings[kPyramidBinding].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+
+  std::array<VkDescriptorSetLayoutBinding, 2> pyramid_bindings{};
+  for (uint32_t i = 0; i < pyramid_bindings.size(); i++) {
+    pyramid_bindings[i].binding = i;
+    pyramid_bindings[i].descriptorCount = 1;
+    pyramid_bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  }
+  pyramid_bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  pyramid_bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+
+  const auto create_layouts = [this](const auto &bindings, uint32_t push_constants_size,
+                                     VkDescriptorSetLayout &set_layout, VkPipelineLayout &pipeline_layout) {
+    VkDescriptorSetLayoutCreateInfo layout_info{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    layout_info.bindingCount = bindings.size();
+    layout_info.pBindings = bindings.data();
+    CHECK_VK_SUCCESS(vkCreateDescriptorSetLayout(device_, &layout_info, nullptr, &set_layout));
+
+    VkPushConstantRange push_constants{};
+    push_constants.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    push_constants.size = push_constants_size;
+
+    VkPipelineLayoutCreateInfo pipeline_layout_info{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    pipeline_layout_info.setLayoutCount = 1;
+    pipeline_layout_info.pSetLayouts = &set_layout;
+    pipeline_layout_info.pushConstantRangeCount = 1;
+    pipeline_layout_info.pPushConstantRanges = &push_constants;
+    CHECK_VK_SUCCESS(vkCreatePipelineLayout(device_, &pipeline_layout_info, nullptr, &pipeline_layout));
+  };
+
+  create_layouts(cull_bindings, sizeof(CullConstants), cull_set_layout_, cull_pipeline_layout_);
+  create_layouts(pyramid_bindings, sizeof(PyramidConstants), pyramid_set_layout_, pyramid_pipeline_layout_);
+}
+
+void OcclusionCuller::CreatePipelines() {
+  cull_shader_ = std::make_unique<Shader>(device_, Shader::kCompute, "assets/shaders/occlusion_cull.comp");
+  cull_pipeline_ = CreateComputePipeline(device_, *cull_shader_, cull_pipeline_layout_);
+
+  pyramid_shader_ = std::make_unique<Shader>(device_, Shader::kCompute, "assets/shaders/depth_pyramid.comp");
+  pyramid_pipeline_ = CreateComputePipeline(device_, *pyramid_shader_, pyramid_pipeline_layout_);
+}
+
+void OcclusionCuller::CreateFrames() {
+  const uint32_t frame_count = core_.GetFramesInFlight();
+
+  const VkDescriptorPoolSize pool_sizes[] = {
+      {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 * frame_count},
+      {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2 * frame_count},
+      {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, frame_count},
+  };
+
+  VkDescriptorPoolCreateInfo pool_info{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+  pool_info.maxSets = frame_count;
+  pool_info.poolSizeCount = 3;
+  pool_info.pPoolSizes = pool_sizes;
+  CHECK_VK_SUCCESS(vkCreateDescriptorPool(device_, &pool_info, nullptr, &descriptor_pool_));
+
+  frames_.resize(frame_count);
+  for (uint32_t slot = 0; slot < frame_count; slot++) {
+    auto &frame = frames_[slot];
+    frame.view_buffer = &core_.GetViewBuffer(slot);
+
+    CreateBufferInfo instances_info{};
+    instances_info.buffer_size = kMaxInstancesPerFrame * sizeof(GpuInstance);
+    instances_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    instances_info.memory_usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+    frame.instances = core_.CreateBuffer(instances_info);
+
+    CreateBufferInfo draws_info{};
+    draws_info.buffer_size = kMaxDrawsPerFrame * sizeof(GpuDraw);
+    draws_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    draws_info.memory_usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+    frame.draws = core_.CreateBuffer(draws_info);
+
+    CreateBufferInfo commands_info{};
+    commands_info.buffer_size = kPhaseCount * kMaxDrawsPerFrame * sizeof(VkDrawIndexedIndirectCommand);
+    commands_info.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    commands_info.memory_usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    frame.commands = core_.CreateBuffer(commands_info);
+
+    CreateBufferInfo frame_data_info{};
+    frame_data_info.buffer_size = sizeof(FrameData);
+    frame_data_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    frame_data_info.memory_usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+    frame.frame_data = core_.CreateBuffer(frame_data_info);
+
+    VkDescriptorSetAllocateInfo alloc_info{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    alloc_info.descriptorPool = descriptor_pool_;
+    alloc_info.descriptorSetCount = 1;
+    alloc_info.pSetLayouts = &cull_set_layout_;
+    CHECK_VK_SUCCESS(vkAllocateDescriptorSets(device_, &alloc_info, &frame.descriptor_set));
+  }
+}
+
+void OcclusionCuller::UpdatePyramid() {
+  const auto completed_frame = core_.GetCompletedFrame();
+  auto retired = retired_pyramids_.begin();
+  while (retired != retired_pyramids_.end()) {
+    if (retired->retired_frame > completed_frame) {
+      ++retired;
+      continue;
+    }
+
+    DestroyPyramid(*retired);
+    retired = retired_pyramids_.erase(retired);
+  }
+
+  auto &depth = core_.GetDepthBuffer();
+  const VkExtent2D depth_extent{depth.GetWidth(), depth.GetHeight()};
+  if (pyramid_.depth_image == depth.GetImage() && pyramid_.depth_extent.width == depth_extent.width &&
+      pyramid_.depth_extent.height == depth_extent.height) {
+    return;
+  }
+
+  // The depth buffer changes with the swapchain and the render scale. Earlier frames may still reduce into
+  // the old pyramid.
+  if (pyramid_.image != VK_NULL_HANDLE) {
+    pyramid_.retired_frame = core_.GetFrameNumber() - 1;
+    retired_pyramids_.push_back(std::move(pyramid_));
+    pyramid_ = Pyramid{};
+  }
+
+  const auto depth_format = depth.GetCreateInfo().format;
+  pyramid_.depth_image = depth.GetImage();
+  pyramid_.depth_extent = depth_extent;
+  pyramid_.depth_view =
+      CreateView(device_, pyramid_.depth_image, depth_format, VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1);
+
+  pyramid_.extent = {PreviousPowerOfTwo(depth_extent.width), PreviousPowerOfTwo(depth_extent.height)};
+  const auto levels = GetLevelCount(pyramid_.extent);
+
+  VkImageCreateInfo image_info{VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+  image_info.imageType = VK_IMAGE_TYPE_2D;
+  image_info.format = VK_FORMAT_R32_SFLOAT;
+  image_info.extent = {pyramid_.extent.width, pyramid_.extent.height, 1};
+  image_info.mipLevels = levels;
+  image_info.arrayLayers = 1;
+  image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+  image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+  image_info.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+  image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  VmaAllocationCreateInfo alloc_info{};
+  alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+  CHECK_VK_SUCCESS(vmaCreateImage(core_.GetVmaAllocator(), &image_info, &alloc_info, &pyramid_.image,
+                                  &pyramid_.allocation, nullptr));
+
+  ImageCreateInfo target_info;
+  target_info.width = pyramid_.extent.width;
+  target_info.height = pyramid_.extent.height;
+  target_info.levels = levels;
+  target_info.format = VK_FORMAT_R32_SFLOAT;
+  target_info.usage = image_info.usage;
+  target_info.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+  pyramid_.target = std::make_unique<Image>(
+      device_, pyramid_.image,
+      CreateView(device_, pyramid_.image, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 0, levels),
+      target_info, VK_IMAGE_VIEW_TYPE_2D);
+  for (uint32_t level = 0; level < levels; level++) {
+    pyramid_.level_views.push_back(
+        CreateView(device_, pyramid_.image, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, level, 1));
+  }
+
+  // Enough sets for pyramids of up to 32k texels per side.
+  constexpr uint32_t kMaxLevels = 16;
+  const VkDescriptorPoolSize pool_sizes[] = {
+      {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, kMaxLevels},
+      {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, kMaxLevels},
+  };
+
+  VkDescriptorPoolCreateInfo pool_info{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+  pool_info.maxSets = kMaxLevels;
+  pool_info.poolSizeCount = 2;
+  pool_info.pPoolSizes = pool_sizes;
+  CHECK_VK_SUCCESS(vkCreateDescriptorPool(device_, &pool_info, nullptr, &pyramid_.descriptor_pool));
+
+  // Each level reads the previous one, the first reads the depth buffer.
+  pyramid_.level_sets.resize(levels);
+  for (uint32_t level = 0; level < levels; level++) {
+    VkDescriptorSetAllocateInfo set_info{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    set_info.descriptorPool = pyramid_.descriptor_pool;
+    set_info.descriptorSetCount = 1;
+    set_info.pSetLayouts = &pyramid_set_layout_;
+    CHECK_VK_SUCCESS(vkAllocateDescriptorSets(device_, &set_info, &pyramid_.level_sets[level]));
+
+    VkDescriptorImageInfo source{};
+    source.sampler = sampler_;
+    source.imageView = level == 0 ? pyramid_.depth_view : pyramid_.level_views[level - 1];
+    source.imageLayout =
+        level == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+    VkDescriptorImageInfo destination{};
+    destination.imageView = pyramid_.level_views[level];
+    destination.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+    std::array<VkWriteDescriptorSet, 2> writes{};
+    for (uint32_t i = 0; i < writes.size(); i++) {
+      writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+      writes[i].dstSet = pyramid_.level_sets[level];
+      writes[i].dstBinding = i;
+      writes[i].descriptorCount = 1;
+    }
+    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writes[0].pImageInfo = &source;
+    writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    writes[1].pImageInfo = &destination;
+    vkUpdateDescriptorSets(device_, writes.size(), writes.data(), 0, nullptr);
+  }
+
+  // Frames in flight still use the sets of their slots.
+  for (auto &frame : frames_) {
+    frame.descriptor_set_dirty = true;
+  }
+}
+
+void OcclusionCuller::DestroyPyramid(Pyramid &pyramid) {
+  if (pyramid.image == VK_NULL_HANDLE) {
+    return;
+  }
+
+  vkDestroyDescriptorPool(device_, pyramid.descriptor_pool, nullptr);
+  for (auto view : pyramid.level_views) {
+    vkDestroyImageView(device_, view, nullptr);
+  }
+  pyramid.target.reset();
+  vkDestroyImageView(device_, pyramid.depth_view, nullptr);
+  vmaDestroyImage(core_.GetVmaAllocator(), pyramid.image, pyramid.allocation);
+
+  pyramid = Pyramid{};
+}
+
+void OcclusionCuller::WriteFrameSet(const Frame &frame) {
+  const std::array<const Buffer *, kViewBufferBinding + 1> buffers = {
+      frame.instances.get(),  frame.draws.get(),  frame.commands.get(), visibility_.get(),
+      frame.frame_data.get(), frame.view_buffer,
+  };
+
+  std::array<VkDescriptorBufferInfo, kViewBufferBinding + 1> buffer_infos{};
+  std::array<VkWriteDescriptorSet, kCullBindingCount> writes{};
+  for (uint32_t i = 0; i < kCullBindingCount; i++) {
+    writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].dstSet = frame.descriptor_set;
+    writes[i].dstBinding = i;
+    writes[i].descriptorCount = 1;
+    writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+    if (i < buffers.size()) {
+      buffer_infos[i].buffer = buffers[i]->GetBuffer();
+      buffer_infos[i].range = VK_WHOLE_SIZE;
+      writes[i].pBufferInfo = &buffer_infos[i];
+    }
+  }
+  writes[kFrameDataBinding].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+  writes[kViewBufferBinding].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+
+  VkDescriptorImageInfo pyramid_info{};
+  pyramid_info.sampler = sampler_;
+  pyramid_info.imageView = pyramid_.target->GetView()->GetRenderTargetView();
+  pyramid_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+  writes[kPyramidBinding].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  writes[kPyramidBinding].pImageInfo = &pyramid_info;
+
+  vkUpdateDescriptorSets(device_, writes.size(), writes.data(), 0, nullptr);
+}
+
+void OcclusionCuller::BeginFrame(RenderContext &context) {
+  UpdatePyramid();
+
+  // The previous frame of this slot has finished, so its set can be rewritten before this frame binds it.
+  frame_ = &frames_[core_.GetFrameIndex()];
+  if (frame_->descriptor_set_dirty) {
+    WriteFrameSet(*frame_);
+    frame_->descriptor_set_dirty = false;
+  }
+  frame_->instance_count = 0;
+  frame_->draw_count = 0;
+
+  FrameData frame_data{};
+  frame_data.pyramid_size = glm::vec4(pyramid_.extent.width, pyramid_.extent.height,
+                                      static_cast<float>(pyramid_.level_views.size()), 0.0F);
+  frame_->frame_data->Update(&frame_data);
+
+  previous_slots_.swap(slots_);
+  slots_.clear();
+
+  // Everything is drawn by the first phase of the first frame.
+  if (!visibility_initialized_) {
+    vkCmdFillBuffer(context.command_buffer->GetBuffer(), visibility_->GetBuffer(), 0, VK_WHOLE_SIZE, 1);
+    visibility_initialized_ = true;
+  }
+
+  // Visibility is filled above or written by the second phase of the previous frame, which also sampled the
+  // pyramid. Commands of this frame slot were last read by a frame that has finished.
+  auto &graph = *context.render_graph;
+  graph_commands_ = graph.ImportBuffer("occlusion commands", *frame_->commands, {});
+  graph_visibility_ = graph.ImportBuffer(
+      "occlusion visibility", *visibility_,
+      {VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+       VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT},
+      true);
+  graph_pyramid_ = graph.ImportImage(
+      "depth pyramid", *pyramid_.target,
+      {pyramid_.initialized ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED,
+       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT});
+  pyramid_.initialized = true;
+}
+
+uint32_t OcclusionCuller::AcquireSlot(const void *key) {
+  uint32_t slot = 0;
+  if (const auto it = previous_slots_.find(key); it != previous_slots_.end()) {
+    slot = it->second;
+    previous_slots_.erase(it);
+  } else if (!free_slots_.empty()) {
+    slot = free_slots_.back();
+    free_slots_.pop_back();
+  } else {
+    VR_ASSERT(slot_count_ < kSlotCount);
+    slot = slot_count_++;
+  }
+
+  slots_[key] = slot;
+  return slot;
+}
+
+std::optional<OcclusionDraws> OcclusionCuller::AddInstance(const void *key, const Mesh &mesh,
+                                                           const glm::mat4 &transform, uint32_t lod) {
+  VR_ASSERT(frame_ != nullptr);
+
+  const auto &bounds = mesh.GetBounds();
+  const auto primitive_count = static_cast<uint32_t>(mesh.GetPrimitives().size());
+  if (!bounds.IsValid() || frame_->instance_count == kMaxInstancesPerFrame ||
+      frame_->draw_count + primitive_count > kMaxDrawsPerFrame || slots_.count(key) != 0) {
+    return std::nullopt;
+  }
+
+  Bounds world_bounds;
+  for (int i = 0; i < 8; i++) {
+    const glm::vec3 corner((i & 1) != 0 ? bounds.max.x : bounds.min.x,
+                           (i & 2) != 0 ? bounds.max.y : bounds.min.y,
+                           (i & 4) != 0 ? bounds.max.z : bounds.min.z);
+    world_bounds.Extend(glm::vec3(transform * glm::vec4(corner, 1.0F)));
+  }
+
+  auto &instance = static_cast<GpuInstance *>(frame_->instances->GetMappedData())[frame_->instance_count++];
+  instance.bounds_min = glm::vec4(world_bounds.min, 1.0F);
+  instance.bounds_max = glm::vec4(world_bounds.max, 1.0F);
+  instance.slot = AcquireSlot(key);
+  instance.first_draw = frame_->draw_count;
+  instance.draw_count = primitive_count;
+
+  auto *draws = static_cast<GpuDraw *>(frame_->draws->GetMappedData()) + frame_->draw_count;
+  for (uint32_t i = 0; i < primitive_count; i++) {
+    draws[i].index_count = mesh.GetLodIndexCount(i, lod);
+    draws[i].vertex_offset = static_cast<int32_t>(mesh.GetPrimitives()[i].vertex_start);
+  }
+
+  OcclusionDraws result{frame_->commands.get()};
+  for (uint32_t phase = 0; phase < kPhaseCount; phase++) {
+    result.offsets[phase] =
+        VkDeviceSize(phase * kMaxDrawsPerFrame + frame_->draw_count) * sizeof(VkDrawIndexedIndirectCommand);
+  }
+
+  frame_->draw_count += primitive_count;
+  return result;
+}
+
+void OcclusionCuller::AddCullPass(RenderContext &context, uint32_t phase) {
+  VR_ASSERT(frame_ != nullptr && phase < kPhaseCount);
+
+  // Instances that left the scene give their slots back.
+  if (phase == 0) {
+    for (const auto &[key, slot] : previous_slots_) {
+      free_slots_.push_back(slot);
+    }
+    previous_slots_.clear();
+  }
+
+  auto &pass = context.render_graph->AddPass(phase == 0 ? "occlusion cull" : "occlusion cull late",
+                                             RenderGraphPass::kCompute);
+  pass.AddBufferOutput(graph_commands_, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+  if (phase == 0) {
+    pass.AddBufferInput(graph_visibility_, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+  } else {
+    pass.AddBufferOutput(graph_visibility_, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+    pass.AddImageInput(graph_pyramid_, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+                       VK_IMAGE_LAYOUT_GENERAL);
+  }
+  pass.SetCallback([this, phase](RenderContext &pass_context) { Dispatch(pass_context, phase); });
+}
+
+void OcclusionCuller::AddDepthPyramidPass(RenderContext &context) {
+  auto &pass = context.render_graph->AddPass("depth pyramid", RenderGraphPass::kCompute);
+  pass.AddTextureInput(context.depth_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+  // Levels are read back while the next one is reduced.
+  pass.AddImageOutput(graph_pyramid_, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL);
+  pass.SetCallback([this](RenderContext &pass_context) { BuildDepthPyramid(pass_context); });
+}
+
+void OcclusionCuller::BuildDepthPyramid(RenderContext &context) {
+  VR_ASSERT(pyramid_.image != VK_NULL_HANDLE);
+
+  const auto command_buffer = context.command_buffer->GetBuffer();
+
+  vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pyramid_pipeline_);
+
+  VkExtent2D source_extent = pyramid_.depth_extent;
+  for (uint32_t level = 0; level < pyramid_.level_sets.size(); level++) {
+    const VkExtent2D extent{std::max(pyramid_.extent.width >> level, 1U),
+                            std::max(pyramid_.extent.height >> level, 1U)};
+
+    PyramidConstants constants{};
+    constants.source_size = glm::ivec2(source_extent.width, source_extent.height);
+    constants.destination_size = glm::ivec2(extent.width, extent.height);
+
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pyramid_pipeline_layout_, 0, 1,
+                            &pyramid_.level_sets[level], 0, nullptr);
+    vkCmdPushConstants(command_buffer, pyramid_pipeline_layout_, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(constants), &constants);
+    vkCmdDispatch(command_buffer, (extent.width + kPyramidGroupSize - 1) / kPyramidGroupSize,
+                  (extent.height + kPyramidGroupSize - 1) / kPyramidGroupSize, 1);
+
+    VkMemoryBarrier level_barrier{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    level_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    level_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &level_barrier, 0, nullptr, 0, nullptr);
+
+    source_extent = extent;
+  }
+}
+
+void OcclusionCuller::Dispatch(RenderContext &context, uint32_t phase) {
+  const auto command_buffer = context.command_buffer->GetBuffer();
+
+  if (frame_->instance_count != 0) {
+    CullConstants constants{};
+    constants.instance_count = frame_->instance_count;
+    constants.phase = phase;
+    constants.command_offset = phase * kMaxDrawsPerFrame;
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull_pipeline_);
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, cull_pipeline_layout_, 0, 1,
+                            &frame_->descriptor_set, 0, nullptr);
+    vkCmdPushConstants(command_buffer, cull_pipeline_layout_, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(constants), &constants);
+    vkCmdDispatch(command_buffer, (frame_->instance_count + kCullGroupSize - 1) / kCullGroupSize, 1, 1);
+  }
+}
+
+}  // namespace vre::rendering
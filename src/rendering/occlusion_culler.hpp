@@ -0,0 +1,148 @@
+#pragma once
+
+#include <array>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "common.hpp"
+#include "rendering/buffers.hpp"
+#include "rendering/image.hpp"
+#include "rendering/render_graph.hpp"
+#include "rendering/shader.hpp"
+
+namespace vre::rendering {
+
+class Mesh;
+class RenderCore;
+struct RenderContext;
+
+// Indirect draws of one instance written by OcclusionCuller, one VkDrawIndexedIndirectCommand per
+// primitive starting at the offset of each phase. See Mesh::RenderIndirect.
+struct OcclusionDraws {
+  const Buffer *commands = nullptr;
+  std::array<VkDeviceSize, 2> offsets{};
+};
+
+// Two-phase hierarchical-Z occlusion culling of whole instances. The first phase draws the instances that
+// were visible last frame. Their depth is reduced into a pyramid of farthest depths, and the second phase
+// draws the remaining instances whose screen space bounds are not fully behind it. All instances are
+// tested against the pyramid in the second phase, which decides what the next frame draws first.
+class OcclusionCuller {
+ public:
+  static constexpr uint32_t kMaxInstancesPerFrame = 16 * 1024;
+  static constexpr uint32_t kMaxDrawsPerFrame = 64 * 1024;
+
+  explicit OcclusionCuller(RenderCore &core);
+  ~OcclusionCuller();
+
+  OcclusionCuller(OcclusionCuller &) = delete;
+  OcclusionCuller(OcclusionCuller &&) = delete;
+
+  // Imports this frame's buffers and the depth pyramid into the render graph of |context|.
+  void BeginFrame(RenderContext &context);
+  // |key| identifies the instance across frames. Returns nothing once this frame's buffers are full, the
+  // instance then has to be drawn directly.
+  [[nodiscard]] std::optional<OcclusionDraws> AddInstance(const void *key, const Mesh &mesh,
+                                                          const glm::mat4 &transform, uint32_t lod);
+
+  // The pass writing the indirect commands of |phase|, the second phase tests against the depth pyramid.
+  void AddCullPass(RenderContext &context, uint32_t phase);
+  // Reduces the depth buffer, as written by the passes declared so far, into the pyramid.
+  void AddDepthPyramidPass(RenderContext &context);
+  // Indirect commands of both phases, read by the draws of the main passes.
+  [[nodiscard]] RenderGraphBuffer GetCommands() const { return graph_commands_; }
+
+  [[nodiscard]] uint32_t GetInstanceCount() const { return frame_ != nullptr ? frame_->instance_count : 0; }
+
+ private:
+  struct FrameData {
+    glm::vec4 pyramid_size;
+  };
+
+  struct Frame {
+    std::shared_ptr<Buffer> instances;
+    std::shared_ptr<Buffer> draws;
+    std::shared_ptr<Buffer> commands;
+    std::shared_ptr<Buffer> frame_data;
+    // RenderContext::view_buffer of the frame slot.
+    const Buffer *view_buffer = nullptr;
+    VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+    // Set once the pyramid is replaced, the set is rewritten when the slot is reused.
+    bool descriptor_set_dirty = true;
+
+    uint32_t instance_count = 0;
+    uint32_t draw_count = 0;
+  };
+
+  // Farthest depth per texel, the first level is the largest power of two that fits the depth buffer.
+  struct Pyramid {
+    VkImage depth_image = VK_NULL_HANDLE;
+    VkImageView depth_view = VK_NULL_HANDLE;
+    VkExtent2D depth_extent{};
+
+    VkImage image = VK_NULL_HANDLE;
+    VmaAllocation allocation = VK_NULL_HANDLE;
+    // Owns the view of all levels.
+    std::unique_ptr<Image> target;
+    std::vector<VkImageView> level_views;
+    VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> level_sets;
+    VkExtent2D extent{};
+    bool initialized = false;
+    // Last frame using the pyramid once it was replaced, destroyed when the GPU finished it.
+    uint64_t retired_frame = 0;
+  };
+
+  RenderCore &core_;
+  VkDevice device_;
+
+  VkSampler sampler_ = VK_NULL_HANDLE;
+  VkDescriptorPool descriptor_pool_ = VK_NULL_HANDLE;
+
+  VkDescriptorSetLayout cull_set_layout_ = VK_NULL_HANDLE;
+  VkPipelineLayout cull_pipeline_layout_ = VK_NULL_HANDLE;
+  std::unique_ptr<Shader> cull_shader_;
+  VkPipeline cull_pipeline_ = VK_NULL_HANDLE;
+
+  VkDescriptorSetLayout pyramid_set_layout_ = VK_NULL_HANDLE;
+  VkPipelineLayout pyramid_pipeline_layout_ = VK_NULL_HANDLE;
+  std::unique_ptr<Shader> pyramid_shader_;
+  VkPipeline pyramid_pipeline_ = VK_NULL_HANDLE;
+
+  // Visibility of the last frame per slot. Slots follow instances across frames, a slot taken over by another
+  // instance only costs a wrongly placed draw, never a missing one.
+  std::shared_ptr<Buffer> visibility_;
+  bool visibility_initialized_ = false;
+  std::unordered_map<const void *, uint32_t> slots_;
+  std::unordered_map<const void *, uint32_t> previous_slots_;
+  std::vector<uint32_t> free_slots_;
+  uint32_t slot_count_ = 0;
+
+  Pyramid pyramid_;
+  // Replaced along with the depth buffer, while frames in flight may still read them.
+  std::vector<Pyramid> retired_pyramids_;
+
+  std::vector<Frame> frames_;
+  Frame *frame_ = nullptr;
+
+  RenderGraphBuffer graph_commands_;
+  RenderGraphBuffer graph_visibility_;
+  RenderGraphImage graph_pyramid_;
+
+ private:
+  void CreateLayouts();
+  void CreatePipelines();
+  void CreateFrames();
+
+  void UpdatePyramid();
+  void DestroyPyramid(Pyramid &pyramid);
+  void WriteFrameSet(const Frame &frame);
+
+  uint32_t AcquireSlot(const void *key);
+  void Dispatch(RenderContext &context, uint32_t phase);
+  void BuildDepthPyramid(RenderContext &context);
+};
+
+}  // namespace vre::rendering
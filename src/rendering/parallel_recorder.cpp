@@ -0,0 +1,99 @@
+#include "parallel_recorder.hpp"
+
+#include "platform/job_system.hpp"
+#include "rendering/render_core.hpp"
+
+namespace vre::rendering {
+
+ParallelRecorder::ParallelRecorder(RenderCore &core, uint32_t frames_in_flight)
+    : core_(core),
+      device_(core.GetDevice()),
+      max_ranges_(std::min(kMaxRanges, platform::JobSystem::Default().GetWorkerCount() + 1)) {
+  VkCommandPoolCreateInfo pool_info{};
+  pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  pool_info.queueFamilyIndex = core.GetPhysicalDevice().indices.graphics_family;
+  pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+  frames_.resize(frames_in_flight);
+  for (auto &slots : frames_) {
+    slots.resize(max_ranges_);
+    for (auto &slot : slots) {
+      CHECK_VK_SUCCESS(vkCreateCommandPool(device_, &pool_info, nullptr, &slot.pool));
+    }
+  }
+}
+
+ParallelRecorder::~ParallelRecorder() {
+  for (auto &slots : frames_) {
+    for (auto &slot : slots) {
+      slot.recorded.clear();
+      vkDestroyCommandPool(device_, slot.pool, nullptr);
+    }
+  }
+}
+
+void ParallelRecorder::BeginFrame(uint32_t frame_index) {
+  VR_ASSERT(frame_index < frames_.size());
+  frame_index_ = frame_index;
+
+  for (auto &slot : frames_[frame_index_]) {
+    if (slot.used_buffers == 0) {
+      continue;
+    }
+
+    slot.recorded.clear();
+    slot.used_buffers = 0;
+    CHECK_VK_SUCCESS(vkResetCommandPool(device_, slot.pool, 0));
+  }
+}
+
+VkCommandBuffer ParallelRecorder::GetBuffer(Slot &slot) {
+  if (slot.used_buffers == slot.buffers.size()) {
+    VkCommandBufferAllocateInfo alloc_info{};
+    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    alloc_info.commandPool = slot.pool;
+    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    alloc_info.commandBufferCount = 1;
+
+    CHECK_VK_SUCCESS(vkAllocateCommandBuffers(device_, &alloc_info, &slot.buffers.emplace_back()));
+  }
+
+  return slot.buffers[slot.used_buffers++];
+}
+
+void ParallelRecorder::Record(RenderContext &context, size_t count, const RecordRange &record) {
+  if (count == 0) {
+    return;
+  }
+
+  const auto range_count =
+      static_cast<uint32_t>(std::clamp<size_t>(count / kMinItemsPerRange, 1, max_ranges_));
+  std::vector<VkCommandBuffer> buffers(range_count);
+
+  // A range only uses its own slot, whichever thread records it.
+  auto &slots = frames_[frame_index_];
+  platform::JobSystem::Default().ParallelFor(range_count, [&](size_t range) {
+    auto &slot = slots[range];
+    buffers[range] = GetBuffer(slot);
+
+    RenderContext range_context;
+    range_context.command_buffer =
+        std::make_unique<CommandBuffer>(&core_, buffers[range], core_.GetPipelineCache());
+    range_context.render_data = context.render_data;
+    range_context.render_graph = context.render_graph;
+    range_context.backbuffer = context.backbuffer;
+    range_context.depth_buffer = context.depth_buffer;
+    range_context.scene_color = context.scene_color;
+    range_context.view_buffer = context.view_buffer;
+
+    range_context.command_buffer->StartSecondary(*context.command_buffer);
+    record(range_context, count * range / range_count, count * (range + 1) / range_count);
+    range_context.command_buffer->End();
+
+    slot.recorded.push_back(std::move(range_context.command_buffer));
+  });
+
+  context.command_buffer->ExecuteCommands(buffers);
+}
+
+}  // namespace vre::rendering
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "common.hpp"
+#include "rendering/command_buffer.hpp"
+
+namespace vre::rendering {
+
+class RenderCore;
+struct RenderContext;
+
+// Records the draws of a subpass on the job system into secondary command buffers. Every range of a split
+// records from its own command pool, and with its own CommandBuffer and uniform buffer block, per frame in
+// flight. They are reset once the frame slot comes around again.
+class ParallelRecorder {
+ public:
+  static constexpr uint32_t kMaxRanges = 8;
+  // Splitting fewer draws costs more than it saves.
+  static constexpr size_t kMinItemsPerRange = 64;
+
+  using RecordRange = std::function<void(RenderContext &context, size_t begin, size_t end)>;
+
+  ParallelRecorder(RenderCore &core, uint32_t frames_in_flight);
+  ~ParallelRecorder();
+
+  ParallelRecorder(ParallelRecorder &) = delete;
+  ParallelRecorder(ParallelRecorder &&) = delete;
+
+  // Called once the previous submission of |frame_index| has finished.
+  void BeginFrame(uint32_t frame_index);
+
+  // Up to this many ranges are recorded at the same time.
+  [[nodiscard]] uint32_t GetMaxRanges() const { return max_ranges_; }
+
+  // Splits [0, count) into contiguous ranges recorded concurrently, and executes them in order in the current
+  // subpass of |context|, which has to have secondary command buffer contents. |record| gets a context whose
+  // command buffer continues that subpass.
+  void Record(RenderContext &context, size_t count, const RecordRange &record);
+
+ private:
+  struct Slot {
+    VkCommandPool pool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> buffers;
+    uint32_t used_buffers = 0;
+    // Kept until the frame finished, they return their uniform buffer blocks.
+    std::vector<std::unique_ptr<CommandBuffer>> recorded;
+  };
+
+  [[nodiscard]] VkCommandBuffer GetBuffer(Slot &slot);
+
+  RenderCore &core_;
+  VkDevice device_;
+  uint32_t max_ranges_;
+
+  // Indexed by frame in flight, then range.
+  std::vector<std::vector<Slot>> frames_;
+  uint32_t frame_index_ = 0;
+};
+
+}  // namespace vre::rendering
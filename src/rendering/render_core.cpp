@@ -3,6 +3,7 @@
 #include <cstddef>
 #include <memory>
 #include <tuple>
+#include <utility>
 #include <vector>
 
 #include <vulkan/vulkan_core.h>
@@ -20,8 +21,6 @@ namespace vre::rendering {
 
 namespace {
 
-constexpr int kMaxFramesInFlight = 2;
-
 const std::vector<const char *> kValidationLayers = {"VK_LAYER_KHRONOS_validation"};
 
 const std::vector<const char *> kDeviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
@@ -266,7 +265,27 @@ bool QuerySwapChainSupport(PhysicalDeviceContext &context) {
   return !context.surface_formats.empty() && !context.present_modes.empty();
 }
 
+// Frames are paced by a timeline semaphore, core since Vulkan 1.2.
+bool SupportsTimelineSemaphore(VkPhysicalDevice device) {
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(device, &properties);
+  if (properties.apiVersion < VK_API_VERSION_1_2) {
+    return false;
+  }
+
+  VkPhysicalDeviceVulkan12Features vulkan12_features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+  VkPhysicalDeviceFeatures2 features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+  features.pNext = &vulkan12_features;
+  vkGetPhysicalDeviceFeatures2(device, &features);
+
+  return vulkan12_features.timelineSemaphore == VK_TRUE;
+}
+
 bool IsDeviceSuitable(PhysicalDeviceContext &context) {
+  if (!SupportsTimelineSemaphore(context.device)) {
+    return false;
+  }
+
   if (!FindQueueFamilies(context)) {
     return false;
   }
@@ -278,6 +297,60 @@ bool IsDeviceSuitable(PhysicalDeviceContext &context) {
   return QuerySwapChainSupport(context);
 }
 
+bool HasDeviceExtension(VkPhysicalDevice device, const char *name) {
+  uint32_t extension_count;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr);
+
+  std::vector<VkExtensionProperties> extensions(extension_count);
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, extensions.data());
+
+  return std::any_of(extensions.begin(), extensions.end(),
+                     [name](const auto &extension) { return strcmp(extension.extensionName, name) == 0; });
+}
+
+void QueryOptionalFeatures(PhysicalDeviceContext &context) {
+  VkPhysicalDeviceVulkan12Features vulkan12_features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+  VkPhysicalDeviceFeatures2 features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+  features.pNext = &vulkan12_features;
+
+#ifdef VK_EXT_mesh_shader
+  VkPhysicalDeviceMeshShaderFeaturesEXT mesh_shader_features{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT};
+  const bool has_mesh_shader = HasDeviceExtension(context.device, VK_EXT_MESH_SHADER_EXTENSION_NAME);
+  if (has_mesh_shader) {
+    vulkan12_features.pNext = &mesh_shader_features;
+  }
+#endif
+
+  vkGetPhysicalDeviceFeatures2(context.device, &features);
+
+  context.features.draw_indirect_count = vulkan12_features.drawIndirectCount == VK_TRUE;
+  context.features.pipeline_statistics_query = features.features.pipelineStatisticsQuery == VK_TRUE;
+#ifdef VK_EXT_mesh_shader
+  // The mesh shader path culls through the same indirect count data, so it needs both.
+  context.features.mesh_shader = has_mesh_shader && context.features.draw_indirect_count &&
+                                 mesh_shader_features.taskShader == VK_TRUE &&
+                                 mesh_shader_features.meshShader == VK_TRUE;
+  if (context.features.mesh_shader) {
+    context.required_extensions.insert(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+  }
+#endif
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(context.device, &properties);
+  context.timestamp_period = properties.limits.timestampPeriod;
+
+  uint32_t queue_family_count = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(context.device, &queue_family_count, nullptr);
+  std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+  vkGetPhysicalDeviceQueueFamilyProperties(context.device, &queue_family_count, queue_families.data());
+  context.timestamp_valid_bits = queue_families[context.indices.graphics_family].timestampValidBits;
+
+  SPDLOG_INFO("drawIndirectCount: {}, mesh shaders: {}, pipeline statistics: {}, timestamp bits: {}",
+              context.features.draw_indirect_count, context.features.mesh_shader,
+              context.features.pipeline_statistics_query, context.timestamp_valid_bits);
+}
+
 VkSurfaceKHR CreateSurface(VkInstance instance, GLFWwindow *window) {
   VkSurfaceKHR surface;
 
@@ -302,6 +375,7 @@ PhysicalDeviceContext PickPhysicalDevice(VkInstance instance, VkSurfaceKHR surfa
     PhysicalDeviceContext context{device, surface};
     context.required_extensions.insert(kDeviceExtensions.begin(), kDeviceExtensions.end());
     if (IsDeviceSuitable(context)) {
+      QueryOptionalFeatures(context);
       return context;
     }
   }
@@ -324,16 +398,36 @@ VkDevice CreateLogicalDevice(const PhysicalDeviceContext &context) {
     queue_create_infos.push_back(queue_create_info);
   }
 
-  VkPhysicalDeviceFeatures device_features{};
+  VkPhysicalDeviceFeatures2 device_features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+  device_features.features.pipelineStatisticsQuery = context.features.pipeline_statistics_query;
+
+  // Multiview is mandatory since Vulkan 1.1, the vertex shaders index the view buffer with gl_ViewIndex.
+  VkPhysicalDeviceVulkan11Features vulkan11_features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES};
+  vulkan11_features.multiview = VK_TRUE;
+  device_features.pNext = &vulkan11_features;
+
+  VkPhysicalDeviceVulkan12Features vulkan12_features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+  vulkan12_features.timelineSemaphore = VK_TRUE;
+  vulkan12_features.drawIndirectCount = context.features.draw_indirect_count ? VK_TRUE : VK_FALSE;
+  vulkan11_features.pNext = &vulkan12_features;
+
+#ifdef VK_EXT_mesh_shader
+  VkPhysicalDeviceMeshShaderFeaturesEXT mesh_shader_features{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT};
+  if (context.features.mesh_shader) {
+    mesh_shader_features.taskShader = VK_TRUE;
+    mesh_shader_features.meshShader = VK_TRUE;
+    vulkan12_features.pNext = &mesh_shader_features;
+  }
+#endif
 
   VkDeviceCreateInfo create_info{};
   create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  create_info.pNext = &device_features;
 
   create_info.queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size());
   create_info.pQueueCreateInfos = queue_create_infos.data();
 
-  create_info.pEnabledFeatures = &device_features;
-
   std::vector<const char *> enabled_extension_names;
   for (const auto &extension : context.required_extensions) {
     enabled_extension_names.push_back(extension.c_str());
@@ -365,26 +459,39 @@ VkSurfaceFormatKHR ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>
   return available_formats[0];
 }
 
-VkPresentModeKHR ChooseSwapPresentMode(const std::vector<VkPresentModeKHR> &available_present_modes) {
-  for (const auto &available_present_mode : available_present_modes) {
-    if (available_present_mode == VK_PRESENT_MODE_MAILBOX_KHR) {
-      return available_present_mode;
-    }
+VkPresentModeKHR ChooseSwapPresentMode(const std::vector<VkPresentModeKHR> &available_present_modes,
+                                       RenderCore::PresentMode present_mode) {
+  const auto is_available = [&available_present_modes](VkPresentModeKHR mode) {
+    return std::find(available_present_modes.begin(), available_present_modes.end(), mode) !=
+           available_present_modes.end();
+  };
+
+  if (present_mode == RenderCore::PresentMode::kImmediate && is_available(VK_PRESENT_MODE_IMMEDIATE_KHR)) {
+    return VK_PRESENT_MODE_IMMEDIATE_KHR;
+  }
+  if (present_mode != RenderCore::PresentMode::kFifo && is_available(VK_PRESENT_MODE_MAILBOX_KHR)) {
+    return VK_PRESENT_MODE_MAILBOX_KHR;
   }
 
+  // The only mode every device supports.
   return VK_PRESENT_MODE_FIFO_KHR;
 }
 
-VkExtent2D ChooseSwapExtent(GLFWwindow *window, const VkSurfaceCapabilitiesKHR &capabilities) {
+uint32_t ChooseSwapImageCount(const VkSurfaceCapabilitiesKHR &capabilities, uint32_t requested_count) {
+  auto image_count = requested_count != 0 ? requested_count : capabilities.minImageCount + 1;
+  image_count = std::max(image_count, capabilities.minImageCount);
+  if (capabilities.maxImageCount > 0) {
+    image_count = std::min(image_count, capabilities.maxImageCount);
+  }
+  return image_count;
+}
+
+VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities, VkExtent2D framebuffer_extent) {
   if (capabilities.currentExtent.width != UINT32_MAX) {
     return capabilities.currentExtent;
   }
 
-  int width;
-  int height;
-  glfwGetFramebufferSize(window, &width, &height);
-
-  VkExtent2D actual_extent = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+  VkExtent2D actual_extent = framebuffer_extent;
 
   actual_extent.width =
       std::clamp(actual_extent.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
@@ -394,6 +501,21 @@ VkExtent2D ChooseSwapExtent(GLFWwindow *window, const VkSurfaceCapabilitiesKHR &
   return actual_extent;
 }
 
+// The scene color is blitted into the swapchain image with a linear filter.
+bool SupportsCompositeBlit(const PhysicalDeviceContext &context) {
+  if ((context.surface_capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT) == 0) {
+    return false;
+  }
+
+  VkFormatProperties properties;
+  vkGetPhysicalDeviceFormatProperties(context.device, ChooseSwapSurfaceFormat(context.surface_formats).format,
+                                      &properties);
+  constexpr VkFormatFeatureFlags kRequiredFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT |
+                                                     VK_FORMAT_FEATURE_BLIT_DST_BIT |
+                                                     VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+  return (properties.optimalTilingFeatures & kRequiredFeatures) == kRequiredFeatures;
+}
+
 VkCommandPool CreateCommandPool(VkDevice device, uint32_t queue_family_index) {
   VkCommandPoolCreateInfo pool_info{};
   pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -421,22 +543,21 @@ std::vector<VkCommandBuffer> AllocateCommandBuffers(uint8_t count, VkDevice devi
   return command_buffers;
 }
 
-RenderPassInfo CreateDefaultRenderPass(ImageViewPtr image_view) {
-  RenderPassInfo info;
-  info.color_attachments.push_back(image_view);
-  info.clear_attachments = 1U << 0;
-  info.store_attachments = 1U << 0;
-
-  info.clear_color.push_back({.0F, .0F, .0F});
-
-  RenderPassInfo::Subpass subpass_info{};
-  subpass_info.color_attachments.reserve(info.color_attachments.size());
-  for (unsigned i = 0; i < info.color_attachments.size(); i++) {
-    subpass_info.color_attachments.push_back(i);
+VkFormat ChooseDepthFormat(VkPhysicalDevice physical_device) {
+  for (const auto format :
+       {VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT}) {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(physical_device, format, &properties);
+    if ((properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) != 0) {
+      return format;
+    }
   }
-  info.subpasses.push_back(std::move(subpass_info));
 
-  return info;
+  throw std::runtime_error("failed to find a supported depth format!");
+}
+
+bool HasStencil(VkFormat format) {
+  return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
 }
 
 void InitVMA(VmaAllocator &allocator, VkInstance instance, VkPhysicalDevice physical_device,
@@ -455,7 +576,10 @@ void InitVMA(VmaAllocator &allocator, VkInstance instance, VkPhysicalDevice phys
 RenderCore::RenderCore() {
 }
 
-void RenderCore::InitVulkan(GLFWwindow *window) {
+void RenderCore::InitVulkan(GLFWwindow *window, const Config &config) {
+  VR_CHECK(config.frames_in_flight >= 1 && config.frames_in_flight <= kMaxFramesInFlight);
+  config_ = config;
+
   instance_ = CreateInstance();
   debug_messenger_ = SetupDebugMessenger(instance_);
   surface_ = CreateSurface(instance_, window);
@@ -473,18 +597,65 @@ void RenderCore::InitVulkan(GLFWwindow *window) {
 
   vkGetDeviceQueue(device_, physical_device_.indices.graphics_family, 0, &graphics_queue_);
   vkGetDeviceQueue(device_, physical_device_.indices.present_family, 0, &present_queue_);
+  submit_thread_ = std::make_unique<SubmitThread>(device_, graphics_queue_, present_queue_);
 
-  CreateSwapChain(window);
+  depth_format_ = ChooseDepthFormat(physical_device_.device);
+  if (config_.stereo && !SupportsCompositeBlit(physical_device_)) {
+    throw std::runtime_error("stereo rendering needs blits to the swapchain!");
+  }
+  InitDynamicResolution();
+
+  view_buffers_.resize(config_.frames_in_flight);
+  for (auto &view_buffer : view_buffers_) {
+    CreateBufferInfo view_buffer_info{};
+    view_buffer_info.buffer_size = sizeof(ViewUniforms);
+    view_buffer_info.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    view_buffer_info.memory_usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+    view_buffer = CreateBuffer(view_buffer_info);
+  }
+
+  int width;
+  int height;
+  glfwGetFramebufferSize(window, &width, &height);
+  framebuffer_extent_ = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+
+  const auto extent = ChooseSwapExtent(physical_device_.surface_capabilities, framebuffer_extent_);
+  CreateSwapChain(extent, VK_NULL_HANDLE);
   CreateImageViews();
+  CreateDepthBuffer();
+
+  render_pass_cache_ = std::make_unique<RenderPassCache>(device_);
+  render_target_pool_ = std::make_unique<RenderTargetPool>(device_, vma_allocator_, *render_pass_cache_);
+  parallel_recorder_ = std::make_unique<ParallelRecorder>(*this, config_.frames_in_flight);
+  render_graph_ = std::make_unique<RenderGraph>(*this);
 
   command_pool_ = CreateCommandPool(device_, physical_device_.indices.graphics_family);
 
   CreateSyncObjects();
-  command_buffers_ = AllocateCommandBuffers(backbuffers_.size(), device_, command_pool_);
+  command_buffers_ = AllocateCommandBuffers(config_.frames_in_flight, device_, command_pool_);
 
   InitPipelineCache();
 }
 
+void RenderCore::InitDynamicResolution() {
+  frame_scales_.assign(config_.frames_in_flight, 0.0F);
+  if (!config_.dynamic_resolution.enabled) {
+    return;
+  }
+
+  if (physical_device_.timestamp_valid_bits == 0 || !SupportsCompositeBlit(physical_device_)) {
+    SPDLOG_WARN("Dynamic resolution needs timestamps and blits to the swapchain, rendering at full size");
+    return;
+  }
+
+  dynamic_resolution_ = std::make_unique<DynamicResolution>(config_.dynamic_resolution);
+
+  VkQueryPoolCreateInfo query_info{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+  query_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  query_info.queryCount = 2 * config_.frames_in_flight;
+  CHECK_VK_SUCCESS(vkCreateQueryPool(device_, &query_info, nullptr, &timestamp_pool_));
+}
+
 void RenderCore::InitPipelineCache() {
   auto file_data = vre::platform::Platform::ReadFile("pipeline_cache.bin", false);
 
@@ -508,29 +679,45 @@ void RenderCore::SaveAndDestroyPipelineCache() {
 }
 
 void RenderCore::CleanupSwapChain() {
-  vkFreeCommandBuffers(device_, command_pool_, static_cast<uint32_t>(command_buffers_.size()),
-                       command_buffers_.data());
+  for (auto &retired : retired_swap_chains_) {
+    DestroyRetiredSwapChain(retired);
+  }
+  retired_swap_chains_.clear();
 
+  render_graph_->ClearCaches();
+  render_pass_cache_->Clear();
+  render_target_pool_->Clear();
   backbuffers_.clear();
-  framebuffers_.clear();
+  depth_buffer_.reset();
 
   vkDestroySwapchainKHR(device_, swap_chain_, nullptr);
 }
 
 void RenderCore::Cleanup() {
+  submit_thread_.reset();
   SaveAndDestroyPipelineCache();
 
   CleanupSwapChain();
 
-  render_pass_.reset();
+  render_graph_.reset();
+  render_pass_cache_.reset();
+  render_target_pool_.reset();
+  parallel_recorder_.reset();
   ubo_allocator_.reset();
+  view_buffers_.clear();
+  default_materials_.clear();
 
-  for (size_t i = 0; i < kMaxFramesInFlight; i++) {
+  if (timestamp_pool_ != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(device_, timestamp_pool_, nullptr);
+  }
+
+  for (size_t i = 0; i < config_.frames_in_flight; i++) {
     vkDestroySemaphore(device_, render_finished_semaphores_[i], nullptr);
     vkDestroySemaphore(device_, image_available_semaphores_[i], nullptr);
-    vkDestroyFence(device_, in_flight_fences_[i], nullptr);
   }
 
+  vkFreeCommandBuffers(device_, command_pool_, static_cast<uint32_t>(command_buffers_.size()),
+                       command_buffers_.data());
   vkDestroyCommandPool(device_, command_pool_, nullptr);
 
   vmaDestroyAllocator(vma_allocator_);
@@ -544,17 +731,19 @@ void RenderCore::Cleanup() {
   vkDestroyInstance(instance_, nullptr);
 }
 
-void RenderCore::CreateSwapChain(GLFWwindow *window) {
+void RenderCore::SetFramebufferSize(uint32_t width, uint32_t height) {
+  std::lock_guard lock(framebuffer_mutex_);
+  framebuffer_extent_ = {width, height};
+  framebuffer_resized_ = true;
+}
+
+void RenderCore::CreateSwapChain(VkExtent2D extent, VkSwapchainKHR old_swap_chain) {
   const auto &capabilities = physical_device_.surface_capabilities;
 
   VkSurfaceFormatKHR surface_format = ChooseSwapSurfaceFormat(physical_device_.surface_formats);
-  VkPresentModeKHR present_mode = ChooseSwapPresentMode(physical_device_.present_modes);
-  VkExtent2D extent = ChooseSwapExtent(window, capabilities);
+  VkPresentModeKHR present_mode = ChooseSwapPresentMode(physical_device_.present_modes, config_.present_mode);
 
-  uint32_t image_count = capabilities.minImageCount + 1;
-  if (capabilities.maxImageCount > 0 && image_count > capabilities.maxImageCount) {
-    image_count = capabilities.maxImageCount;
-  }
+  uint32_t image_count = ChooseSwapImageCount(capabilities, config_.swapchain_images);
 
   VkSwapchainCreateInfoKHR create_info{};
   create_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -566,6 +755,9 @@ void RenderCore::CreateSwapChain(GLFWwindow *window) {
   create_info.imageExtent = extent;
   create_info.imageArrayLayers = 1;
   create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  if (IsSceneOffscreen()) {
+    create_info.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  }
 
   uint32_t queue_family_indices[] = {physical_device_.indices.graphics_family,
                                      physical_device_.indices.present_family};
@@ -583,9 +775,10 @@ void RenderCore::CreateSwapChain(GLFWwindow *window) {
   create_info.presentMode = present_mode;
   create_info.clipped = VK_TRUE;
 
-  create_info.oldSwapchain = VK_NULL_HANDLE;
+  // Lets the driver hand resources over, images acquired from the old swapchain can still be presented.
+  create_info.oldSwapchain = old_swap_chain;
 
-  if (vkCreateSwapchainKHR(device_, &create_info, nullptr, &swap_chain_) != VK_SUCCESS) {
+  if (submit_thread_->CreateSwapchain(device_, create_info, swap_chain_) != VK_SUCCESS) {
     throw std::runtime_error("failed to create swap chain!");
   }
 
@@ -595,11 +788,64 @@ void RenderCore::CreateSwapChain(GLFWwindow *window) {
 
   swap_chain_image_format_ = surface_format.format;
   swap_chain_extent_ = extent;
+
+  SPDLOG_INFO("Swapchain: {}x{}, {} images, present mode {}, {} frames in flight", extent.width,
+              extent.height, image_count, static_cast<int>(present_mode), config_.frames_in_flight);
+}
+
+bool RenderCore::RecreateSwapChain() {
+  auto &capabilities = physical_device_.surface_capabilities;
+  CHECK_VK_SUCCESS(
+      vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device_.device, surface_, &capabilities));
+
+  VkExtent2D framebuffer_extent;
+  {
+    std::lock_guard lock(framebuffer_mutex_);
+    framebuffer_extent = framebuffer_extent_;
+  }
+  const auto extent = ChooseSwapExtent(capabilities, framebuffer_extent);
+  if (extent.width == 0 || extent.height == 0) {
+    return false;
+  }
+
+  // No device idle: frames in flight keep rendering to and presenting the old images.
+  auto &retired = retired_swap_chains_.emplace_back();
+  retired.swap_chain = swap_chain_;
+  retired.backbuffers = std::move(backbuffers_);
+  retired.depth_buffer = std::move(depth_buffer_);
+  // Once a later submission finished, the submit thread got past every present to the old swapchain.
+  retired.value = last_frame_value_ + 1;
+  backbuffers_.clear();
+
+  CreateSwapChain(extent, retired.swap_chain);
+  CreateImageViews();
+  CreateDepthBuffer();
+  image_values_.assign(swap_chain_images_.size(), 0);
+
+  swap_chain_outdated_ = false;
+  return true;
+}
+
+void RenderCore::DestroyRetiredSwapChain(RetiredSwapChain &retired) {
+  // Cached framebuffers keep the views of their attachments alive.
+  std::vector<VkImageView> views;
+  for (auto &backbuffer : retired.backbuffers) {
+    views.push_back(backbuffer.GetView()->GetRenderTargetView());
+  }
+  views.push_back(retired.depth_buffer->GetView()->GetRenderTargetView());
+  render_pass_cache_->DestroyFramebuffers(views);
+
+  retired.backbuffers.clear();
+  retired.depth_buffer.reset();
+  vkDestroySwapchainKHR(device_, retired.swap_chain, nullptr);
 }
 
 void RenderCore::CreateImageViews() {
-  const auto image_create_info = ImageCreateInfo::RenderTarget(
-      swap_chain_extent_.width, swap_chain_extent_.height, swap_chain_image_format_);
+  auto image_create_info = ImageCreateInfo::RenderTarget(swap_chain_extent_.width, swap_chain_extent_.height,
+                                                         swap_chain_image_format_);
+  if (IsSceneOffscreen()) {
+    image_create_info.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  }
   backbuffers_.reserve(swap_chain_images_.size());
 
   for (auto &swap_chain_image : swap_chain_images_) {
@@ -627,84 +873,175 @@ void RenderCore::CreateImageViews() {
                               VK_IMAGE_VIEW_TYPE_2D);
     backbuffers_.back().SetSwapchainLayout(VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
   }
+}
+
+VkExtent2D RenderCore::GetViewExtent() const {
+  // Stereo views are shown side by side.
+  return {std::max(swap_chain_extent_.width / GetViewCount(), 1U), swap_chain_extent_.height};
+}
+
+void RenderCore::CreateDepthBuffer() {
+  const auto view_extent = GetViewExtent();
+  render_extent_ = dynamic_resolution_ ? dynamic_resolution_->GetRenderExtent(view_extent) : view_extent;
+  auto image_create_info =
+      ImageCreateInfo::DepthStencilTarget(render_extent_.width, render_extent_.height, depth_format_);
+  image_create_info.layers = GetViewCount();
+  const auto view_type = image_create_info.layers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+
+  VkImageCreateInfo image_info{};
+  image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  image_info.imageType = image_create_info.type;
+  image_info.format = image_create_info.format;
+  image_info.extent = {image_create_info.width, image_create_info.height, image_create_info.depth};
+  image_info.mipLevels = image_create_info.levels;
+  image_info.arrayLayers = image_create_info.layers;
+  image_info.samples = image_create_info.samples;
+  image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+  image_info.usage = image_create_info.usage;
+  image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  VmaAllocationCreateInfo alloc_info{};
+  alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+  alloc_info.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+
+  VkImage depth_image;
+  VmaAllocation depth_allocation;
+  CHECK_VK_SUCCESS(
+      vmaCreateImage(vma_allocator_, &image_info, &alloc_info, &depth_image, &depth_allocation, nullptr));
+
+  VkImageViewCreateInfo view_info{};
+  view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  view_info.image = depth_image;
+  view_info.viewType = view_type;
+  view_info.format = depth_format_;
+  view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+  if (HasStencil(depth_format_)) {
+    view_info.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
+  }
+  view_info.subresourceRange.baseMipLevel = 0;
+  view_info.subresourceRange.levelCount = 1;
+  view_info.subresourceRange.baseArrayLayer = 0;
+  view_info.subresourceRange.layerCount = image_create_info.layers;
 
-  framebuffers_.resize(backbuffers_.size());
+  VkImageView depth_view;
+  CHECK_VK_SUCCESS(vkCreateImageView(device_, &view_info, nullptr, &depth_view));
+
+  depth_buffer_ = std::make_unique<Image>(device_, vma_allocator_, depth_image, depth_allocation, depth_view,
+                                         image_create_info, view_type);
 }
 
 void RenderCore::CreateSyncObjects() {
-  image_available_semaphores_.resize(kMaxFramesInFlight);
-  render_finished_semaphores_.resize(kMaxFramesInFlight);
-  in_flight_fences_.resize(kMaxFramesInFlight);
-  images_in_flight_.resize(swap_chain_images_.size(), VK_NULL_HANDLE);
+  image_available_semaphores_.resize(config_.frames_in_flight);
+  render_finished_semaphores_.resize(config_.frames_in_flight);
+  frame_values_.resize(config_.frames_in_flight, 0);
+  image_values_.resize(swap_chain_images_.size(), 0);
 
   VkSemaphoreCreateInfo semaphore_info{};
   semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-  VkFenceCreateInfo fence_info{};
-  fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-  fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-  for (size_t i = 0; i < kMaxFramesInFlight; i++) {
+  for (size_t i = 0; i < config_.frames_in_flight; i++) {
     if (vkCreateSemaphore(device_, &semaphore_info, nullptr, &image_available_semaphores_[i]) != VK_SUCCESS ||
-        vkCreateSemaphore(device_, &semaphore_info, nullptr, &render_finished_semaphores_[i]) != VK_SUCCESS ||
-        vkCreateFence(device_, &fence_info, nullptr, &in_flight_fences_[i]) != VK_SUCCESS) {
+        vkCreateSemaphore(device_, &semaphore_info, nullptr, &render_finished_semaphores_[i]) != VK_SUCCESS) {
       throw std::runtime_error("failed to create synchronization objects for a frame!");
     }
   }
 }
 
-RenderContext RenderCore::BeginDraw() {
-  vkWaitForFences(device_, 1, &in_flight_fences_[current_frame_], VK_TRUE, UINT64_MAX);
+std::optional<RenderContext> RenderCore::BeginFrame() {
+  const auto slot = GetFrameIndex();
+  submit_thread_->Wait(frame_values_[slot]);
 
-  vkAcquireNextImageKHR(device_, swap_chain_, UINT64_MAX, image_available_semaphores_[current_frame_],
-                        VK_NULL_HANDLE, &next_image_index_);
-
-  if (images_in_flight_[next_image_index_] != VK_NULL_HANDLE) {
-    vkWaitForFences(device_, 1, &images_in_flight_[next_image_index_], VK_TRUE, UINT64_MAX);
+  swap_chain_outdated_ |= submit_thread_->TakeSwapchainOutdated();
+  {
+    std::lock_guard lock(framebuffer_mutex_);
+    swap_chain_outdated_ |= std::exchange(framebuffer_resized_, false);
   }
 
-  images_in_flight_[next_image_index_] = in_flight_fences_[current_frame_];
-
-  RenderContext context{
-      std::make_unique<CommandBuffer>(this, command_buffers_[next_image_index_], pipeline_cache_)};
+  while (true) {
+    if (swap_chain_outdated_ && !RecreateSwapChain()) {
+      return std::nullopt;
+    }
 
-  context.image_available_semaphore = image_available_semaphores_[current_frame_];
-  context.render_finished_semaphore = render_finished_semaphores_[current_frame_];
-  context.in_flight_fence = in_flight_fences_[current_frame_];
-  context.images_in_flight = images_in_flight_[next_image_index_];
+    const auto result = submit_thread_->AcquireNextImage(
+        device_, swap_chain_, image_available_semaphores_[slot], next_image_index_);
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+      swap_chain_outdated_ = true;
+      continue;
+    }
+    if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+      throw std::runtime_error("failed to acquire swap chain image!");
+    }
 
-  context.command_buffer->Start();
+    // A suboptimal image can still be presented, the swapchain is replaced for the next frame.
+    swap_chain_outdated_ = result == VK_SUBOPTIMAL_KHR;
+    break;
+  }
 
-  BeginRenderInfo begin_render_info{};
-  begin_render_info.render_pass_info = CreateDefaultRenderPass(backbuffers_[next_image_index_].GetView());
+  // An image is only acquired again once it was presented, after its frame was submitted.
+  submit_thread_->Wait(image_values_[next_image_index_]);
 
-  if (render_pass_ == nullptr) {
-    render_pass_ = std::make_shared<RenderPass>(device_, begin_render_info.render_pass_info);
+  // Frames finish in submission order. Fewer than GetFramesInFlight() are in flight after the wait above,
+  // their values are still in |frame_values_|.
+  const auto completed_value = submit_thread_->GetCompletedValue();
+  while (completed_frame_ < submitted_frames_ &&
+         frame_values_[completed_frame_ % config_.frames_in_flight] <= completed_value) {
+    completed_frame_++;
   }
 
-  begin_render_info.render_pass = render_pass_;
+  auto retired = retired_swap_chains_.begin();
+  while (retired != retired_swap_chains_.end()) {
+    if (retired->value > completed_value) {
+      ++retired;
+      continue;
+    }
 
-  if (framebuffers_[next_image_index_] == nullptr) {
-    framebuffers_[next_image_index_] = std::make_shared<Framebuffer>(device_, *begin_render_info.render_pass,
-                                                                     begin_render_info.render_pass_info);
+    DestroyRetiredSwapChain(*retired);
+    retired = retired_swap_chains_.erase(retired);
   }
-  begin_render_info.framebuffer = framebuffers_[next_image_index_];
 
-  context.command_buffer->BeginRenderPass(begin_render_info);
+  UpdateRenderScale(slot);
+
+  RenderContext context{std::make_unique<CommandBuffer>(this, command_buffers_[slot], pipeline_cache_)};
+
+  context.image_available_semaphore = image_available_semaphores_[slot];
+  context.render_finished_semaphore = render_finished_semaphores_[slot];
+  context.render_data.viewport_extent = render_extent_;
+  context.render_data.view_count = GetViewCount();
+  context.render_data.depth_pre_pass = depth_pre_pass_;
+  context.view_buffer = view_buffers_[slot].get();
+
+  render_pass_cache_->BeginFrame(GetFrameNumber(), completed_frame_);
+  render_target_pool_->BeginFrame(GetFrameNumber(), completed_frame_);
+  parallel_recorder_->BeginFrame(slot);
+
+  // The acquire semaphore is waited for at the first stage using the backbuffer, the depth buffer was last
+  // tested, or sampled by compute work, in an earlier frame.
+  render_graph_->Reset();
+  context.render_graph = render_graph_.get();
+  context.backbuffer = render_graph_->ImportImage("backbuffer", backbuffers_[next_image_index_],
+                                                  {VK_IMAGE_LAYOUT_UNDEFINED, GetAcquireWaitStage(), 0},
+                                                  VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, true);
+  context.depth_buffer = render_graph_->ImportImage(
+      "depth", *depth_buffer_,
+      {VK_IMAGE_LAYOUT_UNDEFINED,
+       VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT});
+  context.scene_color = context.backbuffer;
+  if (IsSceneOffscreen()) {
+    context.scene_color = render_graph_->CreateImage(
+        "scene color", {render_extent_.width, render_extent_.height, swap_chain_image_format_,
+                        VK_SAMPLE_COUNT_1_BIT, GetViewCount()});
+  }
 
-  VkViewport viewport{};
-  viewport.x = 0.0F;
-  viewport.y = 0.0F;
-  viewport.width = static_cast<float>(swap_chain_extent_.width);
-  viewport.height = static_cast<float>(swap_chain_extent_.height);
-  viewport.minDepth = 0.0F;
-  viewport.maxDepth = 1.0F;
-  context.command_buffer->SetViewport(viewport);
+  context.command_buffer->Start();
 
-  VkRect2D scissor{};
-  scissor.offset = {0, 0};
-  scissor.extent = swap_chain_extent_;
-  context.command_buffer->SetScissors(scissor);
+  if (dynamic_resolution_) {
+    const auto command_buffer = context.command_buffer->GetBuffer();
+    vkCmdResetQueryPool(command_buffer, timestamp_pool_, 2 * slot, 2);
+    vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestamp_pool_, 2 * slot);
+  }
 
   return context;
 }
@@ -712,57 +1049,158 @@ RenderContext RenderCore::BeginDraw() {
 void RenderCore::Present(RenderContext &context) {
   const auto cmd_buffer = context.command_buffer->GetBuffer();
 
-  vkCmdEndRenderPass(cmd_buffer);
+  if (dynamic_resolution_) {
+    AddTimestampPass(context);
+  }
+  if (IsSceneOffscreen()) {
+    AddCompositePass(context);
+  }
+
+  // The previous frame of the slot finished before BeginFrame() returned. The views of the snapshot stay
+  // unless a pose within the latch bounds was published.
+  const auto slot = GetFrameIndex();
+  view_buffers_[slot]->Update(&context.render_data.views);
+
+  render_graph_->Compile();
+  render_graph_->Execute(context);
+
+  if (dynamic_resolution_) {
+    frame_scales_[slot] = dynamic_resolution_->GetScale();
+  }
 
   if (vkEndCommandBuffer(cmd_buffer) != VK_SUCCESS) {
     throw std::runtime_error("failed to record command buffer!");
   }
 
-  VkSubmitInfo submit_info{};
-  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-
-  VkSemaphore wait_semaphores[] = {context.image_available_semaphore};
-  VkPipelineStageFlags wait_stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-  submit_info.waitSemaphoreCount = 1;
-  submit_info.pWaitSemaphores = wait_semaphores;
-  submit_info.pWaitDstStageMask = wait_stages;
+  Submission submission;
+  submission.command_buffer = cmd_buffer;
+  submission.wait_semaphore = context.image_available_semaphore;
+  submission.wait_stage = GetAcquireWaitStage();
+  submission.signal_semaphore = context.render_finished_semaphore;
+  submission.swapchain = swap_chain_;
+  submission.image_index = next_image_index_;
+  submission.before_submit = [this, slot, snapshot = context.render_data.views] {
+    ViewUniforms views;
+    if (view_latch_.Read(snapshot, views)) {
+      view_buffers_[slot]->Update(&views);
+    }
+  };
+  const auto value = submit_thread_->Submit(submission);
+  frame_values_[slot] = value;
+  image_values_[next_image_index_] = value;
+  last_frame_value_ = value;
 
-  submit_info.commandBufferCount = 1;
-  submit_info.pCommandBuffers = &cmd_buffer;
+  submitted_frames_++;
+  ++current_frame;
+}
 
-  VkSemaphore signal_semaphores[] = {context.render_finished_semaphore};
-  submit_info.signalSemaphoreCount = 1;
-  submit_info.pSignalSemaphores = signal_semaphores;
+void RenderCore::UpdateRenderScale(uint32_t slot) {
+  if (!dynamic_resolution_) {
+    return;
+  }
 
-  vkResetFences(device_, 1, &context.in_flight_fence);
+  // The last frame of the slot has been waited for, its timestamps are available.
+  if (frame_scales_[slot] > 0.0F) {
+    uint64_t timestamps[2] = {};
+    if (vkGetQueryPoolResults(device_, timestamp_pool_, 2 * slot, 2, sizeof(timestamps), timestamps,
+                              sizeof(timestamps[0]), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+      const auto valid_bits = physical_device_.timestamp_valid_bits;
+      const auto mask = valid_bits >= 64 ? UINT64_MAX : (uint64_t{1} << valid_bits) - 1;
+      const auto ticks = (timestamps[1] - timestamps[0]) & mask;
+      const auto gpu_frame_ms = static_cast<float>(ticks) * physical_device_.timestamp_period * 1e-6F;
+      dynamic_resolution_->Update(gpu_frame_ms, frame_scales_[slot]);
+    }
+    frame_scales_[slot] = 0.0F;
+  }
 
-  if (vkQueueSubmit(graphics_queue_, 1, &submit_info, context.in_flight_fence) != VK_SUCCESS) {
-    throw std::runtime_error("failed to submit draw command buffer!");
+  const auto extent = dynamic_resolution_->GetRenderExtent(GetViewExtent());
+  if (extent.width == render_extent_.width && extent.height == render_extent_.height) {
+    return;
   }
 
-  VkPresentInfoKHR present_info{};
-  present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+  // Frames in flight keep testing against the old depth buffer, only the last one submitted has to finish.
+  auto &retired = retired_swap_chains_.emplace_back();
+  retired.depth_buffer = std::move(depth_buffer_);
+  retired.value = last_frame_value_;
+  CreateDepthBuffer();
 
-  present_info.waitSemaphoreCount = 1;
-  present_info.pWaitSemaphores = signal_semaphores;
+  SPDLOG_INFO("Render scale {:.2f}: {}x{}, {:.2f} ms GPU time at full scale", dynamic_resolution_->GetScale(),
+              render_extent_.width, render_extent_.height, dynamic_resolution_->GetFullScaleFrameTime());
+}
 
-  VkSwapchainKHR swap_chains[] = {swap_chain_};
-  present_info.swapchainCount = 1;
-  present_info.pSwapchains = swap_chains;
+VkPipelineStageFlags RenderCore::GetAcquireWaitStage() const {
+  // Offscreen scenes only touch the swapchain image in the final blit, so they do not wait for it.
+  return IsSceneOffscreen() ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+}
 
-  present_info.pImageIndices = &next_image_index_;
+void RenderCore::AddTimestampPass(RenderContext &context) {
+  // Ends the measured GPU time once the scene is done, before the blit waits for the swapchain image. It
+  // reads the scene color like the blit, so it is ordered after every pass writing it.
+  auto &pass = render_graph_->AddPass("frame timestamp", RenderGraphPass::kTransfer);
+  pass.AddImageInput(context.scene_color, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                     VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+  pass.SetSideEffects();
+
+  pass.SetCallback([this](RenderContext &pass_context) {
+    vkCmdWriteTimestamp(pass_context.command_buffer->GetBuffer(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                        timestamp_pool_, 2 * GetFrameIndex() + 1);
+  });
+}
 
-  vkQueuePresentKHR(present_queue_, &present_info);
+void RenderCore::AddCompositePass(RenderContext &context) {
+  auto &pass = render_graph_->AddPass("composite", RenderGraphPass::kTransfer);
+  pass.AddImageInput(context.scene_color, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+                     VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+  pass.AddImageOutput(context.backbuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+                      VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+  pass.SetCallback([this](RenderContext &pass_context) {
+    const auto &source = render_graph_->GetImage(pass_context.scene_color);
+    const auto &destination = render_graph_->GetImage(pass_context.backbuffer);
+    const auto view_width = static_cast<int32_t>(GetViewExtent().width);
+
+    std::vector<VkImageBlit> regions(GetViewCount());
+    for (uint32_t view = 0; view < regions.size(); view++) {
+      auto &region = regions[view];
+      const auto x = static_cast<int32_t>(view) * view_width;
+      region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, view, 1};
+      region.srcOffsets[1] = {static_cast<int32_t>(source.GetWidth()),
+                              static_cast<int32_t>(source.GetHeight()), 1};
+      region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+      region.dstOffsets[0] = {x, 0, 0};
+      region.dstOffsets[1] = {x + view_width, static_cast<int32_t>(destination.GetHeight()), 1};
+    }
+    vkCmdBlitImage(pass_context.command_buffer->GetBuffer(), source.GetImage(),
+                   VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, destination.GetImage(),
+                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()),
+                   regions.data(), VK_FILTER_LINEAR);
+  });
+}
 
-  current_frame_ = (current_frame_ + 1) % kMaxFramesInFlight;
-  ++current_frame;
+void RenderCore::WaitForSubmittedFrames() {
+  submit_thread_->Wait(last_frame_value_);
 }
 
 void RenderCore::WaitDeviceIdle() {
+  submit_thread_->WaitIdle();
   vkDeviceWaitIdle(device_);
 }
 
 UniformBufferPoolAllocator &RenderCore::GetUniformBufferPoolAllocator() {
   return *ubo_allocator_;
 }
+
+std::shared_ptr<Material> RenderCore::GetDefaultMaterial(VertexFormat vertex_format) {
+  auto &default_material = default_materials_[vertex_format];
+  if (auto material = default_material.lock()) {
+    return material;
+  }
+
+  auto material = std::make_shared<Material>(
+      device_, std::make_shared<Shader>(device_, Shader::kFragment, "assets/shaders/shader.frag"),
+      std::make_shared<Shader>(device_, Shader::kVertex, "assets/shaders/shader.vert"), vertex_format,
+      std::make_shared<Shader>(device_, Shader::kVertex, "assets/shaders/depth.vert"));
+  default_material = material;
+  return material;
+}
 }  // namespace vre::rendering
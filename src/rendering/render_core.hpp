@@ -1,13 +1,22 @@
 #pragma once
 
+#include <atomic>
+#include <map>
 #include <memory>
+#include <mutex>
 #include "common.hpp"
 
 #include "rendering/buffers.hpp"
 #include "rendering/command_buffer.hpp"
+#include "rendering/dynamic_resolution.hpp"
 #include "rendering/image.hpp"
+#include "rendering/parallel_recorder.hpp"
+#include "rendering/render_graph.hpp"
 #include "rendering/render_pass.hpp"
+#include "rendering/render_target_pool.hpp"
+#include "rendering/submit_thread.hpp"
 #include "rendering/uniform_buffer_allocator.hpp"
+#include "rendering/view_latch.hpp"
 
 namespace vre::rendering {
 
@@ -17,11 +26,23 @@ struct PhysicalDeviceContext {
 
   std::set<std::string> required_extensions;
 
+  // Optional features, enabled on the logical device when available.
+  struct Features {
+    bool draw_indirect_count = false;
+    bool mesh_shader = false;
+    bool pipeline_statistics_query = false;
+  } features;
+
   struct QueueFamilyIndices {
     uint32_t graphics_family;
     uint32_t present_family;
   } indices;
 
+  // Nanoseconds per timestamp tick, and the bits of the timestamps the graphics queue writes. Zero bits
+  // without timestamp support.
+  float timestamp_period = 0.0F;
+  uint32_t timestamp_valid_bits = 0;
+
   VkSurfaceCapabilitiesKHR surface_capabilities;
   std::vector<VkSurfaceFormatKHR> surface_formats;
   std::vector<VkPresentModeKHR> present_modes;
@@ -29,13 +50,24 @@ struct PhysicalDeviceContext {
 
 struct UniformBufferObject {
   glm::mat4 model;
-  glm::mat4 view;
-  glm::mat4 proj;
 };
 
 struct RenderData {
+  // Culling and LOD selection camera. With several views its frustum contains the frusta of all of them.
   glm::mat4 camera_view;
   glm::mat4 camera_projection;
+  glm::vec3 camera_position;
+  // Farthest any of the views sits from |camera_position|.
+  float eye_offset = 0.0F;
+
+  uint32_t view_count = 1;
+  // As of the snapshot, replaced by a newer pose from the view latch before the frame is submitted.
+  ViewUniforms views{};
+
+  VkExtent2D viewport_extent;
+
+  // Main passes start with a depth-only subpass, shading follows in the next subpass with an equal test.
+  bool depth_pre_pass = false;
 };
 
 struct RenderContext {
@@ -48,14 +80,65 @@ struct RenderContext {
   VkSemaphore image_available_semaphore;
   VkSemaphore render_finished_semaphore;
 
-  VkFence in_flight_fence;
-  VkFence images_in_flight;
-
   RenderData render_data;
+
+  // Passes of the frame, executed by RenderCore::Present(). The swapchain image is presented after the
+  // passes writing |backbuffer|, the depth buffer is cleared by its first pass.
+  RenderGraph *render_graph = nullptr;
+  RenderGraphImage backbuffer;
+  RenderGraphImage depth_buffer;
+  // The scene is drawn into it, at render_data.viewport_extent like |depth_buffer|, with a layer per view.
+  // The |backbuffer| itself unless dynamic resolution or stereo views are composited into the backbuffer at
+  // the end of the frame.
+  RenderGraphImage scene_color;
+
+  // Uniform buffer holding the views of the frame, bound at binding 1 of set 0 by the main passes. Shaders
+  // have to read the cameras from it to see late pose updates.
+  const Buffer *view_buffer = nullptr;
 };
 
 class RenderCore {
+ public:
+  static constexpr uint32_t kMaxFramesInFlight = 4;
+
+  enum class PresentMode {
+    // Waits for vertical blank, never tears.
+    kFifo,
+    // Newer frames replace queued ones, never tears. Falls back to kFifo.
+    kMailbox,
+    // Presents right away and may tear. Falls back to kMailbox, then kFifo.
+    kImmediate,
+  };
+
+  struct Config {
+    // Frames recorded ahead of the GPU, in [1, kMaxFramesInFlight]. More frames keep the GPU busy through
+    // CPU spikes, fewer cut latency.
+    uint32_t frames_in_flight = 2;
+    // Clamped to what the surface supports, zero for one more than its minimum.
+    uint32_t swapchain_images = 0;
+    PresentMode present_mode = PresentMode::kMailbox;
+    // Input is sampled only once the GPU finished every frame before, trading CPU/GPU overlap for about a
+    // frame less input-to-photon latency.
+    bool low_latency = false;
+    // Falls back to rendering at the swapchain extent without timestamp queries or blits to the swapchain.
+    DynamicResolution::Config dynamic_resolution;
+    // Renders a left and a right eye view in one multiview pass, shown side by side.
+    bool stereo = false;
+  };
+
  private:
+  // A replaced swapchain and the images that frames in flight may still render to and present. Only the depth
+  // buffer when the render extent changed on its own.
+  struct RetiredSwapChain {
+    VkSwapchainKHR swap_chain = VK_NULL_HANDLE;
+    std::vector<Image> backbuffers;
+    std::unique_ptr<Image> depth_buffer;
+    // Destroyed once the GPU finished the submission of this value.
+    uint64_t value = 0;
+  };
+
+  Config config_;
+
   VkInstance instance_ = VK_NULL_HANDLE;
   VkDebugUtilsMessengerEXT debug_messenger_ = VK_NULL_HANDLE;
   VkSurfaceKHR surface_ = VK_NULL_HANDLE;
@@ -68,6 +151,7 @@ class RenderCore {
 
   VkQueue graphics_queue_ = VK_NULL_HANDLE;
   VkQueue present_queue_ = VK_NULL_HANDLE;
+  std::unique_ptr<SubmitThread> submit_thread_;
 
   VkPipelineCache pipeline_cache_;
 
@@ -75,10 +159,38 @@ class RenderCore {
   std::vector<VkImage> swap_chain_images_;
   VkFormat swap_chain_image_format_ = VkFormat::VK_FORMAT_UNDEFINED;
   VkExtent2D swap_chain_extent_{};
+  // Recreated before the next acquire.
+  bool swap_chain_outdated_ = false;
+  std::vector<RetiredSwapChain> retired_swap_chains_;
+
+  // Written by the window thread.
+  std::mutex framebuffer_mutex_;
+  VkExtent2D framebuffer_extent_{};
+  bool framebuffer_resized_ = false;
 
   std::vector<Image> backbuffers_;
-  std::vector<std::shared_ptr<Framebuffer>> framebuffers_;
-  std::shared_ptr<RenderPass> render_pass_;
+
+  // One depth buffer serves every frame in flight, the render graph orders its clear after earlier uses.
+  VkFormat depth_format_ = VK_FORMAT_UNDEFINED;
+  std::unique_ptr<Image> depth_buffer_;
+
+  // The scene is rendered at |render_extent_|, the swapchain extent without dynamic resolution.
+  VkExtent2D render_extent_{};
+  std::unique_ptr<DynamicResolution> dynamic_resolution_;
+  // Persistently mapped, one per frame slot.
+  std::vector<std::shared_ptr<Buffer>> view_buffers_;
+  ViewLatch view_latch_;
+  // Start and end of the frames of every slot, and the scale they were rendered at, zero once read.
+  VkQueryPool timestamp_pool_ = VK_NULL_HANDLE;
+  std::vector<float> frame_scales_;
+
+  std::unique_ptr<RenderPassCache> render_pass_cache_;
+  std::unique_ptr<RenderTargetPool> render_target_pool_;
+  std::unique_ptr<ParallelRecorder> parallel_recorder_;
+  std::unique_ptr<RenderGraph> render_graph_;
+  // Shared by every mesh, so large scenes compile the default shaders once per vertex format.
+  std::map<VertexFormat, std::weak_ptr<Material>> default_materials_;
+  std::atomic<bool> depth_pre_pass_{false};
 
   VkCommandPool command_pool_ = VK_NULL_HANDLE;
 
@@ -86,10 +198,13 @@ class RenderCore {
 
   std::vector<VkSemaphore> image_available_semaphores_;
   std::vector<VkSemaphore> render_finished_semaphores_;
-  std::vector<VkFence> in_flight_fences_;
-  std::vector<VkFence> images_in_flight_;
+  // Timeline values of the last frame of every slot and of every swapchain image.
+  std::vector<uint64_t> frame_values_;
+  std::vector<uint64_t> image_values_;
+  uint64_t last_frame_value_ = 0;
 
-  size_t current_frame_ = 0;
+  uint64_t submitted_frames_ = 0;
+  uint64_t completed_frame_ = 0;
   uint32_t next_image_index_ = 0;
 
   std::unique_ptr<UniformBufferPoolAllocator> ubo_allocator_;
@@ -97,29 +212,97 @@ class RenderCore {
  public:
   RenderCore();
 
-  void InitVulkan(GLFWwindow *window);
+  void InitVulkan(GLFWwindow *window, const Config &config);
 
   VkDevice GetDevice() { return device_; }
   VmaAllocator GetVmaAllocator() { return vma_allocator_; }
+  VkCommandPool GetCommandPool() { return command_pool_; }
+  // Every submit to the graphics queue goes through it.
+  [[nodiscard]] SubmitThread &GetSubmitThread() { return *submit_thread_; }
+  VkPipelineCache GetPipelineCache() { return pipeline_cache_; }
+  [[nodiscard]] const PhysicalDeviceContext &GetPhysicalDevice() const { return physical_device_; }
+
+  [[nodiscard]] uint32_t GetFramesInFlight() const { return config_.frames_in_flight; }
+  // Views rendered by the main passes, each to a layer of the scene color and depth buffer.
+  [[nodiscard]] uint32_t GetViewCount() const { return config_.stereo ? kMaxViews : 1; }
+  // RenderContext::view_buffer of the frames of |slot|.
+  [[nodiscard]] const Buffer &GetViewBuffer(uint32_t slot) const { return *view_buffers_[slot]; }
+  // Camera poses published here, from any thread, still reach frames that were already recorded.
+  [[nodiscard]] ViewLatch &GetViewLatch() { return view_latch_; }
+  // Slot of the frame being recorded, in [0, GetFramesInFlight()).
+  [[nodiscard]] uint32_t GetFrameIndex() const {
+    return static_cast<uint32_t>(submitted_frames_ % config_.frames_in_flight);
+  }
+  // Frames are numbered from 1 on, resources last used by a frame up to GetCompletedFrame() are free again.
+  [[nodiscard]] uint64_t GetFrameNumber() const { return submitted_frames_ + 1; }
+  [[nodiscard]] uint64_t GetCompletedFrame() const { return completed_frame_; }
+
+  [[nodiscard]] RenderPassCache &GetRenderPassCache() { return *render_pass_cache_; }
+  // Offscreen images for the frame being recorded.
+  [[nodiscard]] RenderTargetPool &GetRenderTargetPool() { return *render_target_pool_; }
+  [[nodiscard]] ParallelRecorder &GetParallelRecorder() { return *parallel_recorder_; }
+  // Material of meshes without their own, kept while a mesh uses it.
+  [[nodiscard]] std::shared_ptr<Material> GetDefaultMaterial(VertexFormat vertex_format);
+
+  [[nodiscard]] VkFormat GetDepthFormat() const { return depth_format_; }
+  // Fraction of the swapchain extent of a view per axis the scene is rendered at.
+  [[nodiscard]] float GetRenderScale() const {
+    return dynamic_resolution_ ? dynamic_resolution_->GetScale() : 1.0F;
+  }
+  // Imported into the render graph of every frame as RenderContext::depth_buffer.
+  [[nodiscard]] Image &GetDepthBuffer() { return *depth_buffer_; }
+
+  // Read by the main passes declared for the next frame.
+  void SetDepthPrePass(bool enabled) { depth_pre_pass_ = enabled; }
+  [[nodiscard]] bool IsDepthPrePassEnabled() const { return depth_pre_pass_; }
 
   void Cleanup();
   void CleanupSwapChain();
+  // Called from the window thread, the swapchain is recreated before the next frame.
+  void SetFramebufferSize(uint32_t width, uint32_t height);
 
   UniformBufferPoolAllocator &GetUniformBufferPoolAllocator();
   std::shared_ptr<Buffer> CreateBuffer(const CreateBufferInfo &crate_info);
 
-  RenderContext BeginDraw();
+  // Waits for the frame slot, acquires the next image and starts recording. Commands recorded directly into
+  // the command buffer run ahead of the passes added to the render graph of |context|. Empty while the window
+  // has no area, the swapchain is recreated first when it went out of date.
+  std::optional<RenderContext> BeginFrame();
+  // Executes the render graph and queues the frame for submission and presentation, without waiting for
+  // either.
   void Present(RenderContext &context);
 
+  // Blocks until the GPU finished every frame submitted so far.
+  void WaitForSubmittedFrames();
+
   void WaitDeviceIdle();
 
  private:
   void InitPipelineCache();
   void SaveAndDestroyPipelineCache();
 
-  void CreateSwapChain(GLFWwindow *window);
+  void CreateSwapChain(VkExtent2D extent, VkSwapchainKHR old_swap_chain);
+  // False while the window has no area.
+  bool RecreateSwapChain();
+  void DestroyRetiredSwapChain(RetiredSwapChain &retired);
   void CreateImageViews();
+  // Sized after the swapchain extent at the current render scale.
+  void CreateDepthBuffer();
   void CreateSyncObjects();
+
+  // The part of the swapchain extent every view is shown in.
+  [[nodiscard]] VkExtent2D GetViewExtent() const;
+  // Rendering to an offscreen scene color, composited into the backbuffer by the last pass.
+  [[nodiscard]] bool IsSceneOffscreen() const { return dynamic_resolution_ || config_.stereo; }
+
+  void InitDynamicResolution();
+  // Feeds the GPU time of the last frame of |slot| to the controller, and resizes the depth buffer when the
+  // render extent changed.
+  void UpdateRenderScale(uint32_t slot);
+  [[nodiscard]] VkPipelineStageFlags GetAcquireWaitStage() const;
+  void AddTimestampPass(RenderContext &context);
+  // Blits every view of the scene color into its part of the backbuffer, scaling it up to the view extent.
+  void AddCompositePass(RenderContext &context);
 };
 
 }  // namespace vre::rendering
\ No newline at end of file
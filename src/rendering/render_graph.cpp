@@ -0,0 +1,806 @@
+#include "render_graph.hpp"
+
+#include <algorithm>
+
+#include "rendering/render_core.hpp"
+
+namespace vre::rendering {
+
+namespace {
+
+constexpr VkAccessFlags kWriteAccess = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+                                       VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT |
+                                       VK_ACCESS_MEMORY_WRITE_BIT;
+
+constexpr VkPipelineStageFlags kDepthStages =
+    VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+bool IsDepthFormat(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+VkImageAspectFlags GetAspects(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+      return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+      return IsDepthFormat(format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+  }
+}
+
+VkImageUsageFlags GetUsage(VkImageLayout layout) {
+  switch (layout) {
+    case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+      return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+      return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+    case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+      return VK_IMAGE_USAGE_SAMPLED_BIT;
+    case VK_IMAGE_LAYOUT_GENERAL:
+      return VK_IMAGE_USAGE_STORAGE_BIT;
+    case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+      return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+      return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    default:
+      return 0;
+  }
+}
+
+ImageCreateInfo GetCreateInfo(const RenderGraphImageInfo &info, VkImageUsageFlags usage) {
+  ImageCreateInfo create_info;
+  create_info.width = info.width;
+  create_info.height = info.height;
+  create_info.format = info.format;
+  create_info.samples = info.samples;
+  create_info.layers = info.layers;
+  create_info.usage = usage;
+  create_info.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+  return create_info;
+}
+
+void RecordBarriers(VkCommandBuffer command_buffer, VkPipelineStageFlags src_stages,
+                    VkPipelineStageFlags dst_stages, const std::vector<VkImageMemoryBarrier> &images,
+                    const std::vector<VkBufferMemoryBarrier> &buffers) {
+  if (images.empty() && buffers.empty()) {
+    return;
+  }
+
+  vkCmdPipelineBarrier(command_buffer, src_stages != 0 ? src_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       dst_stages != 0 ? dst_stages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr,
+                       static_cast<uint32_t>(buffers.size()), buffers.data(),
+                       static_cast<uint32_t>(images.size()), images.data());
+}
+
+}  // namespace
+
+void RenderGraphPass::AddColorOutput(RenderGraphImage image, AttachmentLoad load,
+                                     VkClearColorValue clear_color) {
+  VR_ASSERT(type_ == kGraphics && image.IsValid());
+
+  auto &attachment = color_attachments_.emplace_back();
+  attachment.resource = image.index;
+  attachment.load = load;
+  attachment.clear_value.color = clear_color;
+
+  const bool loads = load == AttachmentLoad::kLoad;
+  AddAccess({image.index, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+             VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | (loads ? VK_ACCESS_COLOR_ATTACHMENT_READ_BIT : 0U),
+             VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, loads, true});
+}
+
+void RenderGraphPass::SetDepthStencilOutput(RenderGraphImage image, AttachmentLoad load,
+                                            VkClearDepthStencilValue clear_value) {
+  VR_ASSERT(type_ == kGraphics && image.IsValid() && !depth_stencil_attachment_);
+
+  auto &attachment = depth_stencil_attachment_.emplace();
+  attachment.resource = image.index;
+  attachment.load = load;
+  attachment.clear_value.depthStencil = clear_value;
+
+  // The depth test reads the attachment even when it was cleared.
+  AddAccess({image.index, kDepthStages,
+             VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+             VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, load == AttachmentLoad::kLoad, true});
+}
+
+void RenderGraphPass::AddTextureInput(RenderGraphImage image, VkPipelineStageFlags stages) {
+  VR_ASSERT(image.IsValid());
+
+  const auto layout = IsDepthFormat(graph_.GetFormat(image.index))
+                          ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+                          : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  AddAccess({image.index, stages, VK_ACCESS_SHADER_READ_BIT, layout, true, false});
+}
+
+void RenderGraphPass::AddImageInput(RenderGraphImage image, VkPipelineStageFlags stages,
+                                    VkAccessFlags access, VkImageLayout layout) {
+  VR_ASSERT(image.IsValid());
+  AddAccess({image.index, stages, access, layout, true, false});
+}
+
+void RenderGraphPass::AddImageOutput(RenderGraphImage image, VkPipelineStageFlags stages,
+                                     VkAccessFlags access, VkImageLayout layout) {
+  VR_ASSERT(image.IsValid());
+  AddAccess({image.index, stages, access, layout, (access & ~kWriteAccess) != 0, true});
+}
+
+void RenderGraphPass::AddBufferInput(RenderGraphBuffer buffer, VkPipelineStageFlags stages,
+                                     VkAccessFlags access) {
+  VR_ASSERT(buffer.IsValid());
+  AddAccess({buffer.index, stages, access, VK_IMAGE_LAYOUT_UNDEFINED, true, false});
+}
+
+void RenderGraphPass::AddBufferOutput(RenderGraphBuffer buffer, VkPipelineStageFlags stages,
+                                      VkAccessFlags access) {
+  VR_ASSERT(buffer.IsValid());
+  AddAccess({buffer.index, stages, access, VK_IMAGE_LAYOUT_UNDEFINED, (access & ~kWriteAccess) != 0, true});
+}
+
+void RenderGraphPass::AddAccess(const Access &access) {
+  for (auto &existing : accesses_) {
+    if (existing.resource == access.resource) {
+      // A pass sees one layout per image.
+      VR_ASSERT(existing.layout == access.layout);
+      existing.stages |= access.stages;
+      existing.access |= access.access;
+      existing.read = existing.read || access.read;
+      existing.write = existing.write || access.write;
+      return;
+    }
+  }
+
+  accesses_.push_back(access);
+}
+
+RenderGraph::RenderGraph(RenderCore &core) : core_(core), device_(core.GetDevice()) {}
+
+RenderGraph::~RenderGraph() {
+  ClearCaches();
+}
+
+void RenderGraph::Reset() {
+  passes_.clear();
+  resources_.clear();
+  compiled_.clear();
+  final_barriers_ = {};
+
+  // Transients of an older graph layout may still be used by frames in flight.
+  const auto completed_frame = core_.GetCompletedFrame();
+  auto retired = retired_transients_.begin();
+  while (retired != retired_transients_.end()) {
+    if ((*retired)->retired_frame > completed_frame) {
+      ++retired;
+      continue;
+    }
+
+    DestroyTransients(**retired);
+    retired = retired_transients_.erase(retired);
+  }
+}
+
+RenderGraphImage RenderGraph::ImportImage(std::string name, Image &image,
+                                          const RenderGraphResourceState &initial_state,
+                                          VkImageLayout final_layout, bool output) {
+  auto &resource = resources_.emplace_back();
+  resource.name = std::move(name);
+  resource.image = &image;
+  resource.initial_state = initial_state;
+  resource.final_layout = final_layout;
+  resource.output = output;
+
+  return {static_cast<uint32_t>(resources_.size() - 1)};
+}
+
+RenderGraphBuffer RenderGraph::ImportBuffer(std::string name, const Buffer &buffer,
+                                            const RenderGraphResourceState &initial_state, bool output) {
+  auto &resource = resources_.emplace_back();
+  resource.name = std::move(name);
+  resource.buffer = &buffer;
+  resource.initial_state = initial_state;
+  resource.output = output;
+
+  return {static_cast<uint32_t>(resources_.size() - 1)};
+}
+
+RenderGraphImage RenderGraph::CreateImage(std::string name, const RenderGraphImageInfo &info) {
+  VR_ASSERT(info.width > 0 && info.height > 0 && info.format != VK_FORMAT_UNDEFINED);
+
+  auto &resource = resources_.emplace_back();
+  resource.name = std::move(name);
+  resource.transient_info = info;
+
+  return {static_cast<uint32_t>(resources_.size() - 1)};
+}
+
+RenderGraphPass &RenderGraph::AddPass(std::string name, RenderGraphPass::Type type) {
+  return *passes_.emplace_back(new RenderGraphPass(*this, std::move(name), type));
+}
+
+Image &RenderGraph::GetImage(RenderGraphImage image) const {
+  VR_ASSERT(image.index < resources_.size() && resources_[image.index].image != nullptr);
+  return *resources_[image.index].image;
+}
+
+VkFormat RenderGraph::GetFormat(uint32_t resource) const {
+  const auto &info = resources_[resource];
+  if (info.transient_info) {
+    return info.transient_info->format;
+  }
+
+  VR_ASSERT(info.image != nullptr);
+  return info.image->GetCreateInfo().format;
+}
+
+void RenderGraph::Compile() {
+  compiled_.clear();
+  final_barriers_ = {};
+
+  for (const auto pass : CullAndOrderPasses()) {
+    const auto position = static_cast<uint32_t>(compiled_.size());
+    compiled_.emplace_back().pass = pass;
+
+    for (const auto &access : passes_[pass]->accesses_) {
+      auto &resource = resources_[access.resource];
+      resource.first_use = std::min(resource.first_use, position);
+      resource.last_use = std::max(resource.last_use, position);
+      resource.transient_usage |= GetUsage(access.layout);
+    }
+  }
+
+  AllocateTransients();
+  BuildBarriers();
+
+  for (const auto &[position, compiled] : Enumerate(compiled_)) {
+    if (passes_[compiled.pass]->type_ == RenderGraphPass::kGraphics) {
+      BuildRenderPass(compiled, position);
+    }
+  }
+}
+
+std::vector<uint32_t> RenderGraph::CullAndOrderPasses() const {
+  const auto pass_count = passes_.size();
+
+  // Passes depend on the previous contents they read, and are ordered after earlier accesses they overwrite.
+  std::vector<std::vector<uint32_t>> data_dependencies(pass_count);
+  std::vector<std::vector<uint32_t>> dependencies(pass_count);
+  std::vector<uint32_t> last_writers(resources_.size(), UINT32_MAX);
+  std::vector<std::vector<uint32_t>> readers(resources_.size());
+  std::vector<bool> live(pass_count, false);
+
+  for (uint32_t pass = 0; pass < pass_count; pass++) {
+    live[pass] = passes_[pass]->side_effects_;
+
+    for (const auto &access : passes_[pass]->accesses_) {
+      const auto last_writer = last_writers[access.resource];
+      if (access.read && last_writer != UINT32_MAX) {
+        data_dependencies[pass].push_back(last_writer);
+      }
+
+      if (!access.write) {
+        readers[access.resource].push_back(pass);
+        continue;
+      }
+
+      if (last_writer != UINT32_MAX) {
+        dependencies[pass].push_back(last_writer);
+      }
+      auto &resource_readers = readers[access.resource];
+      dependencies[pass].insert(dependencies[pass].end(), resource_readers.begin(), resource_readers.end());
+      resource_readers.clear();
+      last_writers[access.resource] = pass;
+    }
+  }
+
+  for (const auto &[resource, last_writer] : Enumerate(last_writers)) {
+    if (last_writer != UINT32_MAX && resources_[resource].output) {
+      live[last_writer] = true;
+    }
+  }
+
+  std::vector<uint32_t> pending;
+  for (uint32_t pass = 0; pass < pass_count; pass++) {
+    if (live[pass]) {
+      pending.push_back(pass);
+    }
+  }
+  while (!pending.empty()) {
+    const auto pass = pending.back();
+    pending.pop_back();
+
+    for (const auto dependency : data_dependencies[pass]) {
+      if (!live[dependency]) {
+        live[dependency] = true;
+        pending.push_back(dependency);
+      }
+    }
+    dependencies[pass].insert(dependencies[pass].end(), data_dependencies[pass].begin(),
+                              data_dependencies[pass].end());
+  }
+
+  // Declaration order, except that a pass which does not wait for the previous one is moved in between, so
+  // the barrier in front of the waiting pass has work to overlap with.
+  const auto live_count = static_cast<size_t>(std::count(live.begin(), live.end(), true));
+  std::vector<uint32_t> order;
+  std::vector<bool> scheduled(pass_count, false);
+  while (order.size() < live_count) {
+    uint32_t next = UINT32_MAX;
+    for (uint32_t pass = 0; pass < pass_count; pass++) {
+      if (!live[pass] || scheduled[pass]) {
+        continue;
+      }
+
+      const auto &pass_dependencies = dependencies[pass];
+      const bool ready =
+          std::all_of(pass_dependencies.begin(), pass_dependencies.end(),
+                      [&](uint32_t dependency) { return !live[dependency] || scheduled[dependency]; });
+      if (!ready) {
+        continue;
+      }
+
+      if (next == UINT32_MAX) {
+        next = pass;
+      }
+      if (order.empty() || std::find(pass_dependencies.begin(), pass_dependencies.end(), order.back()) ==
+                               pass_dependencies.end()) {
+        next = pass;
+        break;
+      }
+    }
+
+    VR_ASSERT(next != UINT32_MAX);
+    scheduled[next] = true;
+    order.push_back(next);
+  }
+
+  return order;
+}
+
+void RenderGraph::AllocateTransients() {
+  constexpr VkImageUsageFlags kAttachmentUsage =
+      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+
+  std::vector<uint32_t> transients;
+  std::vector<uint32_t> key;
+  for (const auto &[index, resource] : Enumerate(resources_)) {
+    if (!resource.transient_info || resource.first_use == UINT32_MAX) {
+      continue;
+    }
+
+    const auto &info = *resource.transient_info;
+
+    // Attachments of a single render pass are never stored, they can live in lazily allocated memory.
+    if (resource.first_use == resource.last_use && (resource.transient_usage & ~kAttachmentUsage) == 0) {
+      const auto usage = resource.transient_usage | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+      resource.image = &core_.GetRenderTargetPool().Request(GetCreateInfo(info, usage));
+      continue;
+    }
+
+    transients.push_back(static_cast<uint32_t>(index));
+    key.insert(key.end(), {info.width, info.height, static_cast<uint32_t>(info.format),
+                           static_cast<uint32_t>(info.samples), info.layers, resource.transient_usage,
+                           resource.first_use, resource.last_use});
+  }
+
+  if (!transients_ || transients_->key != key) {
+    if (transients_) {
+      transients_->retired_frame = core_.GetFrameNumber() - 1;
+      retired_transients_.push_back(std::move(transients_));
+    }
+
+    transients_ = std::make_unique<TransientSet>();
+    transients_->key = std::move(key);
+
+    std::vector<VkImage> vk_images;
+    std::vector<VkMemoryRequirements> requirements(transients.size());
+    for (const auto &[i, resource_index] : Enumerate(transients)) {
+      const auto &resource = resources_[resource_index];
+
+      VkImageCreateInfo image_info{};
+      image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+      image_info.imageType = VK_IMAGE_TYPE_2D;
+      image_info.format = resource.transient_info->format;
+      image_info.extent = {resource.transient_info->width, resource.transient_info->height, 1};
+      image_info.mipLevels = 1;
+      image_info.arrayLayers = resource.transient_info->layers;
+      image_info.samples = resource.transient_info->samples;
+      image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+      image_info.usage = resource.transient_usage;
+      image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+      image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+      auto &image = vk_images.emplace_back();
+      CHECK_VK_SUCCESS(vkCreateImage(device_, &image_info, nullptr, &image));
+      vkGetImageMemoryRequirements(device_, image, &requirements[i]);
+    }
+
+    // Largest images first, each shares the first block it fits in whose other images are used at other
+    // times of the frame.
+    std::vector<uint32_t> by_size(transients.size());
+    for (uint32_t i = 0; i < by_size.size(); i++) {
+      by_size[i] = i;
+    }
+    std::stable_sort(by_size.begin(), by_size.end(),
+                     [&](uint32_t a, uint32_t b) { return requirements[a].size > requirements[b].size; });
+
+    std::vector<VkMemoryRequirements> blocks;
+    std::vector<std::vector<uint32_t>> block_images;
+    transients_->image_memory.resize(transients.size());
+    for (const auto i : by_size) {
+      const auto &resource = resources_[transients[i]];
+
+      uint32_t block = 0;
+      for (; block < blocks.size(); block++) {
+        const auto &images = block_images[block];
+        const bool overlaps = std::any_of(images.begin(), images.end(), [&](uint32_t other) {
+          const auto &other_resource = resources_[transients[other]];
+          return resource.first_use <= other_resource.last_use &&
+                 other_resource.first_use <= resource.last_use;
+        });
+        if (!overlaps && (blocks[block].memoryTypeBits & requirements[i].memoryTypeBits) != 0) {
+          break;
+        }
+      }
+
+      if (block == blocks.size()) {
+        blocks.push_back(requirements[i]);
+        block_images.emplace_back();
+      } else {
+        blocks[block].size = std::max(blocks[block].size, requirements[i].size);
+        blocks[block].alignment = std::max(blocks[block].alignment, requirements[i].alignment);
+        blocks[block].memoryTypeBits &= requirements[i].memoryTypeBits;
+      }
+      block_images[block].push_back(i);
+      transients_->image_memory[i] = block;
+    }
+
+    VmaAllocationCreateInfo alloc_info{};
+    alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    for (const auto &block : blocks) {
+      auto &allocation = transients_->memory.emplace_back();
+      CHECK_VK_SUCCESS(vmaAllocateMemory(core_.GetVmaAllocator(), &block, &alloc_info, &allocation, nullptr));
+    }
+    transients_->memory_states.resize(blocks.size());
+
+    for (const auto &[i, resource_index] : Enumerate(transients)) {
+      const auto &info = *resources_[resource_index].transient_info;
+      const auto image = vk_images[i];
+      const auto memory = transients_->memory[transients_->image_memory[i]];
+      CHECK_VK_SUCCESS(vmaBindImageMemory(core_.GetVmaAllocator(), memory, image));
+
+      VkImageViewCreateInfo view_info{};
+      view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+      view_info.image = image;
+      const auto view_type = info.layers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+      view_info.viewType = view_type;
+      view_info.format = info.format;
+      view_info.subresourceRange = {GetAspects(info.format), 0, 1, 0, info.layers};
+
+      VkImageView view;
+      CHECK_VK_SUCCESS(vkCreateImageView(device_, &view_info, nullptr, &view));
+
+      // The memory block is freed with the set.
+      transients_->targets.push_back(std::make_unique<Image>(
+          device_, core_.GetVmaAllocator(), image, VK_NULL_HANDLE, view,
+          GetCreateInfo(info, resources_[resource_index].transient_usage), view_type));
+    }
+  }
+
+  for (const auto &[i, resource_index] : Enumerate(transients)) {
+    resources_[resource_index].image = transients_->targets[i].get();
+    resources_[resource_index].memory = transients_->image_memory[i];
+  }
+}
+
+void RenderGraph::DestroyTransients(TransientSet &set) {
+  // Cached framebuffers keep the views of their attachments alive.
+  std::vector<VkImageView> views;
+  for (const auto &target : set.targets) {
+    views.push_back(target->GetView()->GetRenderTargetView());
+  }
+  core_.GetRenderPassCache().DestroyFramebuffers(views);
+
+  set.targets.clear();
+  for (const auto allocation : set.memory) {
+    vmaFreeMemory(core_.GetVmaAllocator(), allocation);
+  }
+  set.memory.clear();
+}
+
+bool RenderGraph::IsReadLater(uint32_t resource, size_t position) const {
+  for (size_t later = position + 1; later < compiled_.size(); later++) {
+    for (const auto &access : passes_[compiled_[later].pass]->accesses_) {
+      if (access.resource == resource && access.read) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+bool RenderGraph::TransitionsInRenderPass(uint32_t resource, size_t position) const {
+  const auto &info = resources_[resource];
+  if (info.final_layout == VK_IMAGE_LAYOUT_UNDEFINED || info.last_use != position) {
+    return false;
+  }
+
+  const auto &pass = *passes_[compiled_[position].pass];
+  const auto &colors = pass.color_attachments_;
+  const bool is_color = std::any_of(colors.begin(), colors.end(), [resource](const auto &attachment) {
+    return attachment.resource == resource;
+  });
+  return is_color || (pass.depth_stencil_attachment_ && pass.depth_stencil_attachment_->resource == resource);
+}
+
+void RenderGraph::BuildBarriers() {
+  // Writes not yet waited for, and which stages since have waited for them with which access.
+  struct State {
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    VkPipelineStageFlags write_stages = 0;
+    VkAccessFlags write_access = 0;
+    VkPipelineStageFlags read_stages = 0;
+    VkPipelineStageFlags visible_stages = 0;
+    VkAccessFlags visible_access = 0;
+  };
+
+  std::vector<State> states(resources_.size());
+  for (const auto &[i, resource] : Enumerate(resources_)) {
+    states[i].layout = resource.initial_state.layout;
+    states[i].write_stages = resource.initial_state.stages;
+    states[i].write_access = resource.initial_state.access;
+  }
+
+  for (const auto &[position, compiled] : Enumerate(compiled_)) {
+    auto &barriers = compiled.barriers;
+
+    for (const auto &access : passes_[compiled.pass]->accesses_) {
+      auto &resource = resources_[access.resource];
+      auto &state = states[access.resource];
+
+      // The first use of a transient waits for the image that used its memory before.
+      if (resource.memory != UINT32_MAX && resource.first_use == position) {
+        const auto &memory_state = transients_->memory_states[resource.memory];
+        state = {};
+        state.write_stages = memory_state.stages;
+        state.write_access = memory_state.access;
+      }
+
+      const bool is_image = resource.buffer == nullptr;
+      const bool layout_change = is_image && access.layout != state.layout;
+      const bool overwrites = access.write || layout_change;
+
+      bool needed = false;
+      if (overwrites) {
+        needed = layout_change || (state.write_stages | state.read_stages) != 0;
+      } else {
+        needed = state.write_stages != 0 && ((state.visible_stages & access.stages) != access.stages ||
+                                             (state.visible_access & access.access) != access.access);
+      }
+
+      if (needed) {
+        const auto src_stages = overwrites ? state.write_stages | state.read_stages : state.write_stages;
+        barriers.src_stages |= src_stages;
+        barriers.dst_stages |= access.stages;
+
+        if (is_image) {
+          auto &barrier = barriers.images.emplace_back();
+          barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+          barrier.srcAccessMask = state.write_access;
+          barrier.dstAccessMask = access.access;
+          // Contents the pass does not read are discarded.
+          barrier.oldLayout = access.read ? state.layout : VK_IMAGE_LAYOUT_UNDEFINED;
+          barrier.newLayout = access.layout;
+          barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+          barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+          barrier.image = resource.image->GetImage();
+          barrier.subresourceRange = {GetAspects(GetFormat(access.resource)), 0, VK_REMAINING_MIP_LEVELS, 0,
+                                      VK_REMAINING_ARRAY_LAYERS};
+        } else {
+          auto &barrier = barriers.buffers.emplace_back();
+          barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+          barrier.srcAccessMask = state.write_access;
+          barrier.dstAccessMask = access.access;
+          barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+          barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+          barrier.buffer = resource.buffer->GetBuffer();
+          barrier.offset = 0;
+          barrier.size = VK_WHOLE_SIZE;
+        }
+      }
+
+      if (access.write) {
+        state.write_stages = access.stages;
+        state.write_access = access.access & kWriteAccess;
+        state.read_stages = 0;
+        state.visible_stages = 0;
+        state.visible_access = 0;
+      } else if (needed) {
+        // Later accesses wait for the layout transition like for a write.
+        if (layout_change) {
+          state.write_stages = access.stages;
+          state.write_access = 0;
+          state.visible_stages = 0;
+          state.visible_access = 0;
+        }
+        state.read_stages |= access.stages;
+        state.visible_stages |= access.stages;
+        state.visible_access |= access.access;
+      } else {
+        state.read_stages |= access.stages;
+      }
+      if (is_image) {
+        state.layout = access.layout;
+      }
+
+      if (TransitionsInRenderPass(access.resource, position)) {
+        state.layout = resource.final_layout;
+      }
+
+      if (resource.memory != UINT32_MAX && resource.last_use == position) {
+        auto &memory_state = transients_->memory_states[resource.memory];
+        memory_state.stages = state.write_stages | state.read_stages;
+        memory_state.access = state.write_access;
+      }
+    }
+  }
+
+  for (const auto &[i, resource] : Enumerate(resources_)) {
+    const auto &state = states[i];
+    if (resource.final_layout == VK_IMAGE_LAYOUT_UNDEFINED || state.layout == resource.final_layout) {
+      continue;
+    }
+
+    const auto src_stages = state.write_stages | state.read_stages;
+    final_barriers_.src_stages |= src_stages;
+    final_barriers_.dst_stages |= src_stages;
+
+    auto &barrier = final_barriers_.images.emplace_back();
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.srcAccessMask = state.write_access;
+    barrier.dstAccessMask = 0;
+    barrier.oldLayout = state.layout;
+    barrier.newLayout = resource.final_layout;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = resource.image->GetImage();
+    barrier.subresourceRange = {GetAspects(GetFormat(static_cast<uint32_t>(i))), 0,
+                                VK_REMAINING_MIP_LEVELS, 0, VK_REMAINING_ARRAY_LAYERS};
+  }
+}
+
+void RenderGraph::BuildRenderPass(CompiledPass &compiled, size_t position) {
+  const auto &pass = *passes_[compiled.pass];
+  auto &info = compiled.render_pass_info;
+
+  const auto is_stored = [&](uint32_t resource) {
+    return resources_[resource].output || IsReadLater(resource, position);
+  };
+  const auto final_layout = [&](uint32_t resource, VkImageLayout layout) {
+    return TransitionsInRenderPass(resource, position) ? resources_[resource].final_layout : layout;
+  };
+
+  for (const auto &[i, attachment] : Enumerate(pass.color_attachments_)) {
+    auto &image = *resources_[attachment.resource].image;
+    info.color_attachments.push_back(image.GetView());
+    info.clear_color.push_back(attachment.clear_value.color);
+    if (attachment.load == AttachmentLoad::kClear) {
+      info.clear_attachments |= 1U << i;
+    } else if (attachment.load == AttachmentLoad::kLoad) {
+      info.load_attachments |= 1U << i;
+    }
+    if (is_stored(attachment.resource)) {
+      info.store_attachments |= 1U << i;
+    }
+    info.initial_layouts.push_back(VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    info.final_layouts.push_back(final_layout(attachment.resource, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL));
+  }
+
+  info.depth_stencil_ops = 0;
+  if (pass.depth_stencil_attachment_) {
+    const auto &attachment = *pass.depth_stencil_attachment_;
+    auto &image = *resources_[attachment.resource].image;
+    info.depth_stencil_attachment = image.GetView();
+    info.clear_depth_stencil = attachment.clear_value.depthStencil;
+    if (attachment.load == AttachmentLoad::kClear) {
+      info.depth_stencil_ops |= ToFlags(RenderPassOp::RENDER_PASS_OP_CLEAR_DEPTH_STENCIL_BIT);
+    } else if (attachment.load == AttachmentLoad::kLoad) {
+      info.depth_stencil_ops |= ToFlags(RenderPassOp::RENDER_PASS_OP_LOAD_DEPTH_STENCIL_BIT);
+    }
+    if (is_stored(attachment.resource)) {
+      info.depth_stencil_ops |= ToFlags(RenderPassOp::RENDER_PASS_OP_STORE_DEPTH_STENCIL_BIT);
+    }
+    info.initial_layouts.push_back(VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+    info.final_layouts.push_back(
+        final_layout(attachment.resource, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL));
+  }
+
+  info.subpasses = pass.subpasses_;
+  info.view_mask = pass.view_mask_;
+  if (info.subpasses.empty()) {
+    auto &subpass = info.subpasses.emplace_back();
+    for (uint32_t i = 0; i < pass.color_attachments_.size(); i++) {
+      subpass.color_attachments.push_back(i);
+    }
+    subpass.use_depth_stencil = pass.depth_stencil_attachment_.has_value();
+  }
+
+  auto &cache = core_.GetRenderPassCache();
+  compiled.render_pass = cache.GetRenderPass(info);
+  compiled.framebuffer = cache.GetFramebuffer(info, compiled.render_pass);
+}
+
+void RenderGraph::Execute(RenderContext &context) {
+  auto &command_buffer = *context.command_buffer;
+
+  for (const auto &compiled : compiled_) {
+    const auto &barriers = compiled.barriers;
+    RecordBarriers(command_buffer.GetBuffer(), barriers.src_stages, barriers.dst_stages, barriers.images,
+                   barriers.buffers);
+
+    const auto &pass = *passes_[compiled.pass];
+    const bool graphics = pass.type_ == RenderGraphPass::kGraphics;
+    if (graphics && pass.secondary_command_buffers_) {
+      command_buffer.BeginRenderPass({compiled.render_pass_info, compiled.render_pass, compiled.framebuffer,
+                                      VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS});
+    } else if (graphics) {
+      command_buffer.BeginRenderPass({compiled.render_pass_info, compiled.render_pass, compiled.framebuffer});
+
+      const VkExtent2D extent = {compiled.framebuffer->GetWidth(), compiled.framebuffer->GetHeight()};
+
+      VkViewport viewport{};
+      viewport.x = 0.0F;
+      viewport.y = 0.0F;
+      viewport.width = static_cast<float>(extent.width);
+      viewport.height = static_cast<float>(extent.height);
+      viewport.minDepth = 0.0F;
+      viewport.maxDepth = 1.0F;
+      command_buffer.SetViewport(viewport);
+
+      VkRect2D scissor{};
+      scissor.offset = {0, 0};
+      scissor.extent = extent;
+      command_buffer.SetScissors(scissor);
+    }
+
+    if (pass.callback_) {
+      pass.callback_(context);
+    }
+
+    if (graphics) {
+      command_buffer.EndRenderPass();
+    }
+  }
+
+  RecordBarriers(command_buffer.GetBuffer(), final_barriers_.src_stages, final_barriers_.dst_stages,
+                 final_barriers_.images, final_barriers_.buffers);
+}
+
+void RenderGraph::ClearCaches() {
+  compiled_.clear();
+
+  if (transients_) {
+    DestroyTransients(*transients_);
+    transients_.reset();
+  }
+  for (auto &retired : retired_transients_) {
+    DestroyTransients(*retired);
+  }
+  retired_transients_.clear();
+}
+
+}  // namespace vre::rendering
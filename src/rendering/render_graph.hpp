@@ -0,0 +1,251 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "common.hpp"
+#include "rendering/buffers.hpp"
+#include "rendering/image.hpp"
+#include "rendering/render_pass.hpp"
+
+namespace vre::rendering {
+
+class RenderCore;
+class RenderGraph;
+struct RenderContext;
+
+// Handles are only valid in the frame they were declared in.
+struct RenderGraphImage {
+  uint32_t index = UINT32_MAX;
+  [[nodiscard]] bool IsValid() const { return index != UINT32_MAX; }
+};
+
+struct RenderGraphBuffer {
+  uint32_t index = UINT32_MAX;
+  [[nodiscard]] bool IsValid() const { return index != UINT32_MAX; }
+};
+
+// Last use of an imported resource before the graph runs: the first pass using it waits for |stages| and
+// makes the |access| writes visible.
+struct RenderGraphResourceState {
+  VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+  VkPipelineStageFlags stages = 0;
+  VkAccessFlags access = 0;
+};
+
+// Image owned by the graph for the passes of one frame.
+struct RenderGraphImageInfo {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+  // Array images get a 2D array view, e.g. for multiview passes.
+  uint32_t layers = 1;
+};
+
+enum class AttachmentLoad {
+  kClear,
+  kLoad,
+  kDontCare,
+};
+
+class RenderGraphPass {
+ public:
+  enum Type {
+    kGraphics,
+    kCompute,
+    // Copies, blits and clears. Like compute passes they record outside of render passes.
+    kTransfer,
+  };
+
+  // Attachments of graphics passes. They are stored only when a later pass or frame reads them.
+  void AddColorOutput(RenderGraphImage image, AttachmentLoad load, VkClearColorValue clear_color = {});
+  void SetDepthStencilOutput(RenderGraphImage image, AttachmentLoad load,
+                             VkClearDepthStencilValue clear_value = {1.0F, 0});
+  // Without subpasses a single one uses every attachment.
+  void AddSubpass(RenderPassInfo::Subpass subpass) { subpasses_.push_back(std::move(subpass)); }
+  // Multiview: every subpass renders the views of the set bits into the layers of the attachments.
+  void SetViewMask(uint32_t view_mask) { view_mask_ = view_mask; }
+
+  // Sampled in SHADER_READ_ONLY_OPTIMAL, or DEPTH_STENCIL_READ_ONLY_OPTIMAL for depth formats.
+  void AddTextureInput(RenderGraphImage image, VkPipelineStageFlags stages);
+  void AddImageInput(RenderGraphImage image, VkPipelineStageFlags stages, VkAccessFlags access,
+                     VkImageLayout layout);
+  // Outputs keep the previous contents only when |access| reads them.
+  void AddImageOutput(RenderGraphImage image, VkPipelineStageFlags stages, VkAccessFlags access,
+                      VkImageLayout layout);
+  void AddBufferInput(RenderGraphBuffer buffer, VkPipelineStageFlags stages, VkAccessFlags access);
+  void AddBufferOutput(RenderGraphBuffer buffer, VkPipelineStageFlags stages, VkAccessFlags access);
+
+  // Kept even when nothing uses what it writes.
+  void SetSideEffects() { side_effects_ = true; }
+
+  // Subpasses of graphics passes are recorded into secondary command buffers, e.g. by the ParallelRecorder.
+  // The callback then sets neither viewport nor scissor in the primary command buffer, and begins the
+  // following subpasses with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+  void SetSecondaryCommandBuffers() { secondary_command_buffers_ = true; }
+
+  // Graphics passes record inside their render pass, with viewport and scissor covering the attachments
+  // unless they use secondary command buffers.
+  void SetCallback(std::function<void(RenderContext &)> callback) { callback_ = std::move(callback); }
+
+  [[nodiscard]] const std::string &GetName() const { return name_; }
+  [[nodiscard]] Type GetType() const { return type_; }
+
+ private:
+  friend class RenderGraph;
+
+  struct Access {
+    uint32_t resource = 0;
+    VkPipelineStageFlags stages = 0;
+    VkAccessFlags access = 0;
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    // Whether the pass depends on the previous contents, and whether it changes them.
+    bool read = false;
+    bool write = false;
+  };
+
+  struct Attachment {
+    uint32_t resource = 0;
+    AttachmentLoad load = AttachmentLoad::kClear;
+    VkClearValue clear_value{};
+  };
+
+  RenderGraphPass(RenderGraph &graph, std::string name, Type type)
+      : graph_(graph), name_(std::move(name)), type_(type) {}
+
+  void AddAccess(const Access &access);
+
+  RenderGraph &graph_;
+  std::string name_;
+  Type type_;
+
+  std::vector<Attachment> color_attachments_;
+  std::optional<Attachment> depth_stencil_attachment_;
+  std::vector<RenderPassInfo::Subpass> subpasses_;
+  uint32_t view_mask_ = 0;
+
+  // One entry per resource.
+  std::vector<Access> accesses_;
+  bool side_effects_ = false;
+  bool secondary_command_buffers_ = false;
+  std::function<void(RenderContext &)> callback_;
+};
+
+// Passes declare the images and buffers they read and write, the compiled graph orders them, culls the ones
+// whose results are never used, batches the barriers and layout transitions in between and gives transient
+// images whose lifetimes do not overlap the same memory. It is declared again every frame; render passes and
+// framebuffers come from the RenderPassCache of the core, transient images carry over while the declarations
+// stay the same.
+class RenderGraph {
+ public:
+  explicit RenderGraph(RenderCore &core);
+  ~RenderGraph();
+
+  RenderGraph(RenderGraph &) = delete;
+  RenderGraph(RenderGraph &&) = delete;
+
+  // Drops the passes and resources of the previous frame.
+  void Reset();
+
+  // Passes writing |output| resources are never culled, they are presented or read by later frames. Images
+  // are left in |final_layout| unless it is undefined.
+  RenderGraphImage ImportImage(std::string name, Image &image, const RenderGraphResourceState &initial_state,
+                               VkImageLayout final_layout = VK_IMAGE_LAYOUT_UNDEFINED, bool output = false);
+  RenderGraphBuffer ImportBuffer(std::string name, const Buffer &buffer,
+                                 const RenderGraphResourceState &initial_state, bool output = false);
+  // Contents are undefined at the first use in every frame. Images that are only attachments of one render
+  // pass come from the RenderTargetPool of the core, in lazily allocated memory where available.
+  RenderGraphImage CreateImage(std::string name, const RenderGraphImageInfo &info);
+
+  RenderGraphPass &AddPass(std::string name, RenderGraphPass::Type type);
+
+  // Available to pass callbacks, transient images once the graph is compiled.
+  [[nodiscard]] Image &GetImage(RenderGraphImage image) const;
+
+  void Compile();
+  // Records the compiled passes into the command buffer of |context|.
+  void Execute(RenderContext &context);
+
+  // Destroys the transient images, e.g. before the swapchain they are sized after is recreated.
+  void ClearCaches();
+
+ private:
+  friend class RenderGraphPass;
+
+  struct Resource {
+    std::string name;
+
+    Image *image = nullptr;
+    const Buffer *buffer = nullptr;
+    std::optional<RenderGraphImageInfo> transient_info;
+    VkImageUsageFlags transient_usage = 0;
+
+    RenderGraphResourceState initial_state;
+    VkImageLayout final_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    bool output = false;
+
+    // First and last position in the compiled order, and the memory it shares with other transients.
+    uint32_t first_use = UINT32_MAX;
+    uint32_t last_use = 0;
+    uint32_t memory = UINT32_MAX;
+  };
+
+  struct Barriers {
+    VkPipelineStageFlags src_stages = 0;
+    VkPipelineStageFlags dst_stages = 0;
+    std::vector<VkImageMemoryBarrier> images;
+    std::vector<VkBufferMemoryBarrier> buffers;
+  };
+
+  struct CompiledPass {
+    uint32_t pass = 0;
+    Barriers barriers;
+
+    RenderPassInfo render_pass_info;
+    std::shared_ptr<RenderPass> render_pass;
+    std::shared_ptr<Framebuffer> framebuffer;
+  };
+
+  // Images and memory of the transients of one graph layout, alive while the layout stays the same.
+  struct TransientSet {
+    std::vector<uint32_t> key;
+    std::vector<std::unique_ptr<Image>> targets;
+    // Index into |memory| per image.
+    std::vector<uint32_t> image_memory;
+    std::vector<VmaAllocation> memory;
+    // Last use of each memory block in the previous frame, the first use in the next frame waits for it.
+    std::vector<RenderGraphResourceState> memory_states;
+    // Last frame using the set, destroyed once the GPU finished it.
+    uint64_t retired_frame = 0;
+  };
+
+  RenderCore &core_;
+  VkDevice device_;
+
+  std::vector<std::unique_ptr<RenderGraphPass>> passes_;
+  std::vector<Resource> resources_;
+
+  std::vector<CompiledPass> compiled_;
+  Barriers final_barriers_;
+
+  std::unique_ptr<TransientSet> transients_;
+  std::vector<std::unique_ptr<TransientSet>> retired_transients_;
+
+ private:
+  [[nodiscard]] std::vector<uint32_t> CullAndOrderPasses() const;
+  void AllocateTransients();
+  void DestroyTransients(TransientSet &set);
+  void BuildBarriers();
+  void BuildRenderPass(CompiledPass &compiled, size_t position);
+
+  [[nodiscard]] VkFormat GetFormat(uint32_t resource) const;
+  [[nodiscard]] bool IsReadLater(uint32_t resource, size_t position) const;
+  // Whether the render pass at |position| leaves |resource| in its final layout.
+  [[nodiscard]] bool TransitionsInRenderPass(uint32_t resource, size_t position) const;
+};
+
+}  // namespace vre::rendering
@@ -1,6 +1,7 @@
 #include "render_pass.hpp"
 
 #include <vulkan/vulkan_core.h>
+#include <algorithm>
 #include <vector>
 
 namespace vre::rendering {
@@ -10,33 +11,53 @@ namespace {
 void ComputeDimensions(const RenderPassInfo &info, uint32_t &width, uint32_t &height) {
   width = UINT32_MAX;
   height = UINT32_MAX;
-  VR_ASSERT(!info.color_attachments.empty());
+  VR_ASSERT(!info.color_attachments.empty() || info.depth_stencil_attachment);
 
   for (const auto &attachment : info.color_attachments) {
     width = std::min(width, attachment->GetImage().GetWidth());
     height = std::min(height, attachment->GetImage().GetHeight());
   }
+
+  if (info.depth_stencil_attachment) {
+    width = std::min(width, info.depth_stencil_attachment->GetImage().GetWidth());
+    height = std::min(height, info.depth_stencil_attachment->GetImage().GetHeight());
+  }
 }
 
 std::vector<VkImageView> GetViews(const RenderPassInfo &info) {
   std::vector<VkImageView> views;
-  views.reserve(info.color_attachments.size());
+  views.reserve(info.color_attachments.size() + 1);
 
   for (const auto &attachment : info.color_attachments) {
     views.push_back(attachment->GetRenderTargetView());
   }
 
+  if (info.depth_stencil_attachment) {
+    views.push_back(info.depth_stencil_attachment->GetRenderTargetView());
+  }
+
   return views;
 }
 
+// Vulkan handles are pointers or 64 bit integers depending on the platform.
+template <typename T>
+uint64_t ToKey(T handle) {
+  return (uint64_t)(handle);  // NOLINT
+}
+
 }  // namespace
 
-RenderPass::RenderPass(VkDevice device, const RenderPassInfo &info) : device_(device) {
+RenderPass::RenderPass(VkDevice device, const RenderPassInfo &info, uint64_t compatibility_id)
+    : device_(device), compatibility_id_(compatibility_id) {
   const auto get_load_op = [&info](unsigned index) -> VkAttachmentLoadOp {
     if ((info.clear_attachments & (1u << index)) != 0) {
       return VK_ATTACHMENT_LOAD_OP_CLEAR;
     }
 
+    if ((info.load_attachments & (1u << index)) != 0) {
+      return VK_ATTACHMENT_LOAD_OP_LOAD;
+    }
+
     return VK_ATTACHMENT_LOAD_OP_DONT_CARE;
   };
 
@@ -75,16 +96,38 @@ RenderPass::RenderPass(VkDevice device, const RenderPassInfo &info) : device_(de
   }
 
   if (info.depth_stencil_attachment) {
+    const auto ops = info.depth_stencil_ops;
+
     auto &ds_attachment = vk_attachments.emplace_back();
     ds_attachment.flags = 0;
     ds_attachment.format = info.depth_stencil_attachment->GetFormat();
     ds_attachment.samples = info.depth_stencil_attachment->GetImage().GetCreateInfo().samples;
-    ds_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    ds_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     ds_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     ds_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     ds_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     ds_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     ds_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    if (HasRenderPassOp(ops, RenderPassOp::RENDER_PASS_OP_CLEAR_DEPTH_STENCIL_BIT)) {
+      ds_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    } else if (HasRenderPassOp(ops, RenderPassOp::RENDER_PASS_OP_LOAD_DEPTH_STENCIL_BIT)) {
+      ds_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+      ds_attachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    }
+
+    if (HasRenderPassOp(ops, RenderPassOp::RENDER_PASS_OP_STORE_DEPTH_STENCIL_BIT)) {
+      ds_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    }
+  }
+
+  for (const auto &[i, vk_attachment] : Enumerate(vk_attachments)) {
+    if (i < info.initial_layouts.size()) {
+      vk_attachment.initialLayout = info.initial_layouts[i];
+    }
+    if (i < info.final_layouts.size()) {
+      vk_attachment.finalLayout = info.final_layouts[i];
+    }
   }
 
   std::vector<VkSubpassDescription> vk_subpasses;
@@ -125,15 +168,50 @@ RenderPass::RenderPass(VkDevice device, const RenderPassInfo &info) : device_(de
     dependency.srcAccessMask = 0;
     dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 
+    if (info.load_attachments != 0) {
+      dependency.srcAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+      dependency.dstAccessMask |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+    }
+
+    constexpr VkPipelineStageFlags kDepthStages =
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+    constexpr VkAccessFlags kDepthAccess =
+        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
     if (subpass.use_depth_stencil) {
-      dependency.srcStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-      dependency.dstStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-      dependency.dstAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+      // The depth attachment is shared by frames in flight, so the clear waits for earlier depth writes.
+      dependency.srcStageMask |= kDepthStages;
+      dependency.dstStageMask |= kDepthStages;
+      dependency.srcAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+      dependency.dstAccessMask |= kDepthAccess;
+    }
+
+    // Depth written by the previous subpass, e.g. a depth pre-pass, is tested by this one.
+    if (i > 0 && subpass.use_depth_stencil && info.subpasses[i - 1].use_depth_stencil) {
+      auto &subpass_dependency = vk_dependencies.emplace_back();
+      subpass_dependency.srcSubpass = i - 1;
+      subpass_dependency.dstSubpass = i;
+      subpass_dependency.srcStageMask = kDepthStages;
+      subpass_dependency.dstStageMask = kDepthStages;
+      subpass_dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+      subpass_dependency.dstAccessMask = kDepthAccess;
+      subpass_dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
     }
   }
 
+  // The views are rendered from nearby cameras, so they are correlated for every subpass.
+  const std::vector<uint32_t> view_masks(vk_subpasses.size(), info.view_mask);
+  VkRenderPassMultiviewCreateInfo multiview_info{VK_STRUCTURE_TYPE_RENDER_PASS_MULTIVIEW_CREATE_INFO};
+  multiview_info.subpassCount = static_cast<uint32_t>(view_masks.size());
+  multiview_info.pViewMasks = view_masks.data();
+  multiview_info.correlationMaskCount = 1;
+  multiview_info.pCorrelationMasks = &info.view_mask;
+
   VkRenderPassCreateInfo render_pass_info{};
   render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  if (info.view_mask != 0) {
+    render_pass_info.pNext = &multiview_info;
+  }
   render_pass_info.attachmentCount = vk_attachments.size();
   render_pass_info.pAttachments = vk_attachments.data();
   render_pass_info.subpassCount = vk_subpasses.size();
@@ -170,4 +248,135 @@ Framebuffer::~Framebuffer() {
   vkDestroyFramebuffer(device_, framebuffer_, nullptr);
 }
 
+size_t RenderPassCache::KeyHash::operator()(const Key &key) const {
+  // FNV-1a over the 64 bit words.
+  uint64_t hash = 14695981039346656037ULL;
+  for (const auto value : key) {
+    hash = (hash ^ value) * 1099511628211ULL;
+  }
+  return static_cast<size_t>(hash);
+}
+
+RenderPassCache::~RenderPassCache() {
+  Clear();
+}
+
+void RenderPassCache::BeginFrame(uint64_t frame, uint64_t completed_frame) {
+  frame_ = frame;
+  const auto is_old = [this, completed_frame](uint64_t last_used) {
+    return frame_ - last_used >= kMaxUnusedFrames && last_used <= completed_frame;
+  };
+
+  // Entries still held elsewhere, e.g. render passes of cached framebuffers, are kept.
+  auto framebuffer = framebuffers_.begin();
+  while (framebuffer != framebuffers_.end()) {
+    const auto &entry = framebuffer->second;
+    if (is_old(entry.last_used) && entry.framebuffer.use_count() == 1) {
+      framebuffer = framebuffers_.erase(framebuffer);
+    } else {
+      ++framebuffer;
+    }
+  }
+
+  auto render_pass = render_passes_.begin();
+  while (render_pass != render_passes_.end()) {
+    const auto &entry = render_pass->second;
+    if (is_old(entry.last_used) && entry.render_pass.use_count() == 1) {
+      render_pass = render_passes_.erase(render_pass);
+    } else {
+      ++render_pass;
+    }
+  }
+}
+
+RenderPassCache::Key RenderPassCache::GetCompatibilityKey(const RenderPassInfo &info) {
+  const auto add_attachment = [](Key &key, const ImageViewPtr &view) {
+    key.push_back(view->GetFormat());
+    key.push_back(view->GetImage().GetCreateInfo().samples);
+  };
+
+  Key key;
+  key.push_back(info.color_attachments.size());
+  for (const auto &view : info.color_attachments) {
+    add_attachment(key, view);
+  }
+  if (info.depth_stencil_attachment) {
+    add_attachment(key, info.depth_stencil_attachment);
+  } else {
+    key.push_back(VK_FORMAT_UNDEFINED);
+  }
+
+  for (const auto &subpass : info.subpasses) {
+    key.push_back(subpass.color_attachments.size());
+    key.insert(key.end(), subpass.color_attachments.begin(), subpass.color_attachments.end());
+    key.push_back(subpass.use_depth_stencil);
+  }
+  key.push_back(info.view_mask);
+
+  return key;
+}
+
+std::shared_ptr<RenderPass> RenderPassCache::GetRenderPass(const RenderPassInfo &info) {
+  auto key = GetCompatibilityKey(info);
+  const auto compatibility_id = compatibility_ids_.emplace(key, compatibility_ids_.size() + 1).first->second;
+
+  key.insert(key.end(), {info.clear_attachments, info.load_attachments, info.store_attachments,
+                         info.depth_stencil_ops});
+  key.push_back(info.initial_layouts.size());
+  key.insert(key.end(), info.initial_layouts.begin(), info.initial_layouts.end());
+  key.insert(key.end(), info.final_layouts.begin(), info.final_layouts.end());
+
+  auto &entry = render_passes_[key];
+  if (entry.render_pass == nullptr) {
+    entry.render_pass = std::make_shared<RenderPass>(device_, info, compatibility_id);
+  }
+  entry.last_used = frame_;
+
+  return entry.render_pass;
+}
+
+std::shared_ptr<Framebuffer> RenderPassCache::GetFramebuffer(const RenderPassInfo &info,
+                                                             const std::shared_ptr<RenderPass> &render_pass) {
+  std::vector<VkImageView> views;
+  for (const auto &view : info.color_attachments) {
+    views.push_back(view->GetRenderTargetView());
+  }
+  if (info.depth_stencil_attachment) {
+    views.push_back(info.depth_stencil_attachment->GetRenderTargetView());
+  }
+
+  auto key = GetCompatibilityKey(info);
+  for (const auto view : views) {
+    key.push_back(ToKey(view));
+  }
+
+  auto &entry = framebuffers_[key];
+  if (entry.framebuffer == nullptr) {
+    entry.framebuffer = std::make_shared<Framebuffer>(device_, *render_pass, info);
+    entry.render_pass = render_pass;
+    entry.views = std::move(views);
+  }
+  entry.last_used = frame_;
+
+  return entry.framebuffer;
+}
+
+void RenderPassCache::DestroyFramebuffers(const std::vector<VkImageView> &views) {
+  auto framebuffer = framebuffers_.begin();
+  while (framebuffer != framebuffers_.end()) {
+    // Only the attachments are compared, other key fields may hold the same integer as a view handle.
+    const auto &attachments = framebuffer->second.views;
+    const bool uses_view = std::any_of(views.begin(), views.end(), [&attachments](VkImageView view) {
+      return std::find(attachments.begin(), attachments.end(), view) != attachments.end();
+    });
+    framebuffer = uses_view ? framebuffers_.erase(framebuffer) : std::next(framebuffer);
+  }
+}
+
+void RenderPassCache::Clear() {
+  // Framebuffers refer to their render pass.
+  framebuffers_.clear();
+  render_passes_.clear();
+}
+
 }  // namespace vre::rendering
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include <cstddef>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include <vulkan/vulkan_core.h>
@@ -23,13 +24,25 @@ enum class RenderPassOp : uint32_t {
   RENDER_PASS_OP_ENABLE_TRANSIENT_LOAD_BIT = 1 << 5
 };
 
+[[nodiscard]] constexpr uint32_t ToFlags(RenderPassOp op) {
+  return static_cast<uint32_t>(op);
+}
+
+[[nodiscard]] constexpr bool HasRenderPassOp(uint32_t ops, RenderPassOp op) {
+  return (ops & ToFlags(op)) != 0;
+}
+
 struct RenderPassInfo {
   std::vector<ImageViewPtr> color_attachments;
   ImageViewPtr depth_stencil_attachment;
 
   uint32_t clear_attachments = 0;
+  uint32_t load_attachments = 0;
   uint32_t store_attachments = 0;
 
+  // RenderPassOp bits of the depth stencil attachment.
+  uint32_t depth_stencil_ops = ToFlags(RenderPassOp::RENDER_PASS_OP_CLEAR_DEPTH_STENCIL_BIT);
+
   std::shared_ptr<Framebuffer> framebuffer;
 
   // Render area will be clipped to the actual framebuffer.
@@ -44,6 +57,15 @@ struct RenderPassInfo {
   };
 
   std::vector<Subpass> subpasses;
+
+  // Every subpass renders the views of the set bits into the matching layers of the attachments, zero
+  // without multiview.
+  uint32_t view_mask = 0;
+
+  // Layouts of the color attachments followed by the depth stencil attachment when the pass begins and ends.
+  // Left empty, attachments start undefined and swapchain images end in their swapchain layout.
+  std::vector<VkImageLayout> initial_layouts;
+  std::vector<VkImageLayout> final_layouts;
 };
 
 class RenderPass {
@@ -51,15 +73,20 @@ class RenderPass {
   RenderPass(RenderPass &) = delete;
   RenderPass(RenderPass &&) = delete;
 
-  RenderPass(VkDevice device, const RenderPassInfo &info);
+  RenderPass(VkDevice device, const RenderPassInfo &info, uint64_t compatibility_id = 0);
 
   ~RenderPass();
 
-  VkRenderPass GetRenderPass() { return render_pass_; }
+  VkRenderPass GetRenderPass() const { return render_pass_; }
+
+  // Equal for render passes created by the same RenderPassCache with matching attachment formats, sample
+  // counts and subpasses. Pipelines built for one of them can be used with the others.
+  uint64_t GetCompatibilityId() const { return compatibility_id_; }
 
  private:
   VkDevice device_;
   VkRenderPass render_pass_;
+  uint64_t compatibility_id_;
 
  private:
 };
@@ -87,4 +114,60 @@ class Framebuffer {
   uint32_t height_ = 0;
 };
 
+// Render passes keyed by the attachment formats, sample counts, subpasses, load/store ops and layouts of a
+// RenderPassInfo, framebuffers keyed by its attachment views. Entries nobody else holds are destroyed once
+// they were not requested for kMaxUnusedFrames frames and the GPU finished the frames that used them, so
+// passes can be described again every frame.
+class RenderPassCache {
+ public:
+  static constexpr uint64_t kMaxUnusedFrames = 8;
+
+  explicit RenderPassCache(VkDevice device) : device_(device) {}
+  ~RenderPassCache();
+
+  RenderPassCache(RenderPassCache &) = delete;
+  RenderPassCache(RenderPassCache &&) = delete;
+
+  // Evicts old entries. The GPU finished every frame up to |completed_frame|.
+  void BeginFrame(uint64_t frame, uint64_t completed_frame);
+
+  std::shared_ptr<RenderPass> GetRenderPass(const RenderPassInfo &info);
+  // |render_pass| has to be compatible with |info|, the framebuffer keeps it alive.
+  std::shared_ptr<Framebuffer> GetFramebuffer(const RenderPassInfo &info,
+                                              const std::shared_ptr<RenderPass> &render_pass);
+
+  // Called before the images of |views| are destroyed.
+  void DestroyFramebuffers(const std::vector<VkImageView> &views);
+  void Clear();
+
+ private:
+  using Key = std::vector<uint64_t>;
+
+  struct KeyHash {
+    size_t operator()(const Key &key) const;
+  };
+
+  struct RenderPassEntry {
+    std::shared_ptr<RenderPass> render_pass;
+    uint64_t last_used = 0;
+  };
+
+  struct FramebufferEntry {
+    std::shared_ptr<Framebuffer> framebuffer;
+    std::shared_ptr<RenderPass> render_pass;
+    std::vector<VkImageView> views;
+    uint64_t last_used = 0;
+  };
+
+  [[nodiscard]] static Key GetCompatibilityKey(const RenderPassInfo &info);
+
+  VkDevice device_;
+  uint64_t frame_ = 0;
+
+  // Never evicted, so an id is not reused for an incompatible render pass.
+  std::unordered_map<Key, uint64_t, KeyHash> compatibility_ids_;
+  std::unordered_map<Key, RenderPassEntry, KeyHash> render_passes_;
+  std::unordered_map<Key, FramebufferEntry, KeyHash> framebuffers_;
+};
+
 }  // namespace vre::rendering
\ No newline at end of file
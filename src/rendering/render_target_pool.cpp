@@ -0,0 +1,127 @@
+#include "render_target_pool.hpp"
+
+#include "rendering/render_pass.hpp"
+
+namespace vre::rendering {
+
+namespace {
+
+VkImageAspectFlags GetAspects(VkFormat format) {
+  switch (format) {
+    case VK_FORMAT_D16_UNORM:
+    case VK_FORMAT_X8_D24_UNORM_PACK32:
+    case VK_FORMAT_D32_SFLOAT:
+      return VK_IMAGE_ASPECT_DEPTH_BIT;
+    case VK_FORMAT_D16_UNORM_S8_UINT:
+    case VK_FORMAT_D24_UNORM_S8_UINT:
+    case VK_FORMAT_D32_SFLOAT_S8_UINT:
+      return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+    default:
+      return VK_IMAGE_ASPECT_COLOR_BIT;
+  }
+}
+
+std::vector<uint64_t> GetKey(const ImageCreateInfo &info) {
+  return {info.width, info.height, info.depth,  info.levels,  info.format,
+          info.type,  info.layers, info.usage,  info.samples, info.flags};
+}
+
+}  // namespace
+
+void RenderTargetPool::BeginFrame(uint64_t frame, uint64_t completed_frame) {
+  frame_ = frame;
+  completed_frame_ = completed_frame;
+
+  const auto is_old = [this](const Entry &entry) {
+    return frame_ - entry.last_used >= kMaxUnusedFrames && entry.last_used <= completed_frame_;
+  };
+  // Cached framebuffers keep the views of their attachments alive.
+  std::vector<VkImageView> views;
+  for (const auto &[key, entries] : entries_) {
+    for (const auto &entry : entries) {
+      if (is_old(entry)) {
+        views.push_back(entry.image->GetView()->GetRenderTargetView());
+      }
+    }
+  }
+  if (views.empty()) {
+    return;
+  }
+
+  render_pass_cache_.DestroyFramebuffers(views);
+  for (auto &[key, entries] : entries_) {
+    entries.erase(std::remove_if(entries.begin(), entries.end(), is_old), entries.end());
+  }
+}
+
+Image &RenderTargetPool::Request(const ImageCreateInfo &info) {
+  auto &entries = entries_[GetKey(info)];
+  for (auto &entry : entries) {
+    if (entry.last_used <= completed_frame_) {
+      entry.last_used = frame_;
+      return *entry.image;
+    }
+  }
+
+  auto &entry = entries.emplace_back();
+  entry.image = CreateImage(info);
+  entry.last_used = frame_;
+  return *entry.image;
+}
+
+void RenderTargetPool::Clear() {
+  entries_.clear();
+}
+
+std::unique_ptr<Image> RenderTargetPool::CreateImage(const ImageCreateInfo &info) const {
+  VkImageCreateInfo image_info{};
+  image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  image_info.flags = info.flags;
+  image_info.imageType = info.type;
+  image_info.format = info.format;
+  image_info.extent = {info.width, info.height, info.depth};
+  image_info.mipLevels = info.levels;
+  image_info.arrayLayers = info.layers;
+  image_info.samples = info.samples;
+  image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+  image_info.usage = info.usage;
+  image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  VmaAllocationCreateInfo alloc_info{};
+  alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+  VkImage image = VK_NULL_HANDLE;
+  VmaAllocation allocation = VK_NULL_HANDLE;
+  VkResult result = VK_ERROR_FEATURE_NOT_PRESENT;
+  if ((info.usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) != 0) {
+    // Desktop devices have no lazily allocated memory type.
+    VmaAllocationCreateInfo lazy_alloc_info{};
+    lazy_alloc_info.usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED;
+    result = vmaCreateImage(allocator_, &image_info, &lazy_alloc_info, &image, &allocation, nullptr);
+  }
+  if (result != VK_SUCCESS) {
+    CHECK_VK_SUCCESS(vmaCreateImage(allocator_, &image_info, &alloc_info, &image, &allocation, nullptr));
+  }
+
+  VkImageViewType view_type = info.layers > 1 ? VK_IMAGE_VIEW_TYPE_2D_ARRAY : VK_IMAGE_VIEW_TYPE_2D;
+  if (info.type == VK_IMAGE_TYPE_3D) {
+    view_type = VK_IMAGE_VIEW_TYPE_3D;
+  }
+
+  VkImageViewCreateInfo view_info{};
+  view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  view_info.image = image;
+  view_info.viewType = view_type;
+  view_info.format = info.format;
+  view_info.subresourceRange = {GetAspects(info.format), 0, info.levels, 0, info.layers};
+
+  VkImageView view;
+  CHECK_VK_SUCCESS(vkCreateImageView(device_, &view_info, nullptr, &view));
+
+  auto create_info = info;
+  create_info.initial_layout = VK_IMAGE_LAYOUT_UNDEFINED;
+  return std::make_unique<Image>(device_, allocator_, image, allocation, view, create_info, view_type);
+}
+
+}  // namespace vre::rendering
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "common.hpp"
+#include "rendering/image.hpp"
+
+namespace vre::rendering {
+
+class RenderPassCache;
+
+// Offscreen images for the passes of one frame, keyed by their ImageCreateInfo. An image is handed out again
+// once the GPU finished the frames that used it, images not requested for kMaxUnusedFrames frames are
+// destroyed. Usages with VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT get lazily allocated memory where the device
+// has it, so attachments that never leave tile memory take none.
+class RenderTargetPool {
+ public:
+  static constexpr uint64_t kMaxUnusedFrames = 8;
+
+  RenderTargetPool(VkDevice device, VmaAllocator allocator, RenderPassCache &render_pass_cache)
+      : device_(device), allocator_(allocator), render_pass_cache_(render_pass_cache) {}
+
+  RenderTargetPool(RenderTargetPool &) = delete;
+  RenderTargetPool(RenderTargetPool &&) = delete;
+
+  // Destroys old images. The GPU finished every frame up to |completed_frame|.
+  void BeginFrame(uint64_t frame, uint64_t completed_frame);
+
+  // Valid until the end of the frame, contents are undefined.
+  Image &Request(const ImageCreateInfo &info);
+
+  void Clear();
+
+ private:
+  struct Entry {
+    std::unique_ptr<Image> image;
+    uint64_t last_used = 0;
+  };
+
+  [[nodiscard]] std::unique_ptr<Image> CreateImage(const ImageCreateInfo &info) const;
+
+  VkDevice device_;
+  VmaAllocator allocator_;
+  // Framebuffers of evicted images are destroyed along with them.
+  RenderPassCache &render_pass_cache_;
+  uint64_t frame_ = 0;
+  uint64_t completed_frame_ = 0;
+
+  std::map<std::vector<uint64_t>, std::vector<Entry>> entries_;
+};
+
+}  // namespace vre::rendering
@@ -24,6 +24,12 @@ shaderc_shader_kind ToShadercType(Shader::Type type) {
       return shaderc_glsl_vertex_shader;
     case Shader::kFragment:
       return shaderc_glsl_fragment_shader;
+    case Shader::kCompute:
+      return shaderc_glsl_compute_shader;
+    case Shader::kTask:
+      return shaderc_glsl_task_shader;
+    case Shader::kMesh:
+      return shaderc_glsl_mesh_shader;
   }
 }
 
@@ -32,6 +38,10 @@ shaderc::SpvCompilationResult Compile(const std::string &data, const std::string
   shaderc::CompileOptions options;
 
   options.SetOptimizationLevel(shaderc_optimization_level_performance);
+  // GL_EXT_mesh_shader needs SPIR-V 1.4.
+  if (type == Shader::kTask || type == Shader::kMesh) {
+    options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
+  }
 
 #ifndef NDEBUG
   options.SetGenerateDebugInfo();
@@ -46,6 +56,30 @@ shaderc::SpvCompilationResult Compile(const std::string &data, const std::string
   return result;
 }
 
+VkFormat GetInputFormat(const spirv_cross::SPIRType &type) {
+  static constexpr VkFormat kFloatFormats[] = {VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT,
+                                               VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT};
+  static constexpr VkFormat kIntFormats[] = {VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT,
+                                             VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT};
+  static constexpr VkFormat kUintFormats[] = {VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT,
+                                              VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT};
+
+  if (type.width != 32 || type.columns != 1 || type.vecsize < 1 || type.vecsize > 4) {
+    return VK_FORMAT_UNDEFINED;
+  }
+
+  switch (type.basetype) {
+    case spirv_cross::SPIRType::Float:
+      return kFloatFormats[type.vecsize - 1];
+    case spirv_cross::SPIRType::Int:
+      return kIntFormats[type.vecsize - 1];
+    case spirv_cross::SPIRType::UInt:
+      return kUintFormats[type.vecsize - 1];
+    default:
+      return VK_FORMAT_UNDEFINED;
+  }
+}
+
 ResourceLayout GetResourceLayout(std::vector<uint32_t> &&spirv) {
   spirv_cross::Compiler compiler(std::move(spirv));
 
@@ -59,6 +93,7 @@ ResourceLayout GetResourceLayout(std::vector<uint32_t> &&spirv) {
 
     const auto &type = compiler.get_type(resource.base_type_id);
     input.width = type.width * type.vecsize * type.columns / 8;
+    input.format = GetInputFormat(type);
 
     result.inputs.push_back(input);
   }
@@ -77,14 +112,15 @@ ResourceLayout GetResourceLayout(std::vector<uint32_t> &&spirv) {
   return result;
 }
 
-std::vector<VkVertexInputBindingDescription> GetBindingDescription(const Shader &vertex) {
+std::vector<VkVertexInputBindingDescription> GetBindingDescription(const Shader &vertex,
+                                                                  VertexFormat vertex_format) {
   std::vector<VkVertexInputBindingDescription> result;
 
   for (const auto &input : vertex.GetResourceLayout().inputs) {
     VkVertexInputBindingDescription binding_description{};
 
     binding_description.binding = 0;
-    binding_description.stride = input.width;
+    binding_description.stride = input.location == 0 ? GetPositionStride(vertex_format) : input.width;
     binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
     result.push_back(binding_description);
@@ -93,7 +129,8 @@ std::vector<VkVertexInputBindingDescription> GetBindingDescription(const Shader
   return result;
 }
 
-std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions(const Shader &vertex) {
+std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions(const Shader &vertex,
+                                                                       VertexFormat vertex_format) {
   std::vector<VkVertexInputAttributeDescription> result;
 
   for (const auto &input : vertex.GetResourceLayout().inputs) {
@@ -101,8 +138,7 @@ std::vector<VkVertexInputAttributeDescription> GetAttributeDescriptions(const Sh
 
     attribute_description.binding = 0;
     attribute_description.location = input.location;
-    // TODO: Choose it dynamicly
-    attribute_description.format = VK_FORMAT_R32G32B32_SFLOAT;
+    attribute_description.format = input.location == 0 ? GetPositionFormat(vertex_format) : input.format;
     attribute_description.offset = input.offset;
 
     result.push_back(attribute_description);
@@ -151,6 +187,23 @@ CombinedResourceLayout BuildCombinedResourceLayout(const Shader &fragment, const
 
 }  // namespace
 
+VkFormat GetPositionFormat(VertexFormat format) {
+  switch (format) {
+    case VertexFormat::kFloat32:
+      return VK_FORMAT_R32G32B32_SFLOAT;
+    case VertexFormat::kFloat16:
+      return VK_FORMAT_R16G16B16A16_SFLOAT;
+    case VertexFormat::kSnorm16:
+      return VK_FORMAT_R16G16B16A16_SNORM;
+  }
+  return VK_FORMAT_UNDEFINED;
+}
+
+uint32_t GetPositionStride(VertexFormat format) {
+  // 16-bit formats are padded to four components, three component formats are rarely supported.
+  return format == VertexFormat::kFloat32 ? 3 * sizeof(float) : 4 * sizeof(uint16_t);
+}
+
 Shader::Shader(VkDevice device, Type type, const std::string &path)
     : device_(device), type_(type), path_(path) {
   const auto data = platform::Platform::ReadFile(path_);
@@ -220,25 +273,52 @@ PipelineLayout::~PipelineLayout() {
   vkDestroyPipelineLayout(device_, pipeline_layout_, nullptr);
 }
 
-Material::Material(VkDevice device, std::shared_ptr<Shader> fragment, std::shared_ptr<Shader> vertex)
-    : device_(device), fragment_(fragment), vertex_(vertex) {
+Material::Material(VkDevice device, std::shared_ptr<Shader> fragment, std::shared_ptr<Shader> vertex,
+                   VertexFormat vertex_format, std::shared_ptr<Shader> depth_vertex)
+    : device_(device),
+      fragment_(fragment),
+      vertex_(vertex),
+      vertex_format_(vertex_format),
+      depth_vertex_(depth_vertex) {
   combined_resource_layout_ = BuildCombinedResourceLayout(*fragment_, *vertex_);
   pipeline_layout_ = std::make_shared<PipelineLayout>(device_, combined_resource_layout_);
 }
 
 Material::~Material() {
-  if (pipeline_ != VK_NULL_HANDLE) {
-    vkDestroyPipeline(device_, pipeline_, nullptr);
+  for (const auto &[key, pipeline] : pipelines_) {
+    vkDestroyPipeline(device_, pipeline, nullptr);
+  }
+}
+
+VkPipeline Material::GetPipeline(const PipelineKey &key) const {
+  std::lock_guard lock(pipelines_mutex_);
+  const auto it = pipelines_.find(key);
+  return it != pipelines_.end() ? it->second : VK_NULL_HANDLE;
+}
+
+VkPipeline Material::SetPipeline(const PipelineKey &key, VkPipeline pipeline) {
+  std::lock_guard lock(pipelines_mutex_);
+  const auto [it, inserted] = pipelines_.emplace(key, pipeline);
+  if (!inserted) {
+    vkDestroyPipeline(device_, pipeline, nullptr);
   }
+  return it->second;
 }
 
-std::vector<VkPipelineShaderStageCreateInfo> Material::GetShaderStages() const {
+std::vector<VkPipelineShaderStageCreateInfo> Material::GetShaderStages(DepthMode depth_mode) const {
   VkPipelineShaderStageCreateInfo vert_shader_stage_info{};
   vert_shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
   vert_shader_stage_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
   vert_shader_stage_info.module = vertex_->GetShaderModule();
   vert_shader_stage_info.pName = "main";
 
+  if (depth_mode == DepthMode::kPrePass) {
+    if (depth_vertex_) {
+      vert_shader_stage_info.module = depth_vertex_->GetShaderModule();
+    }
+    return {vert_shader_stage_info};
+  }
+
   VkPipelineShaderStageCreateInfo frag_shader_stage_info{};
   frag_shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
   frag_shader_stage_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
@@ -250,7 +330,8 @@ std::vector<VkPipelineShaderStageCreateInfo> Material::GetShaderStages() const {
 
 std::tuple<std::vector<VkVertexInputBindingDescription>, std::vector<VkVertexInputAttributeDescription>>
 Material::GetInputBindings() const {
-  return std::make_tuple(GetBindingDescription(*vertex_), GetAttributeDescriptions(*vertex_));
+  return std::make_tuple(GetBindingDescription(*vertex_, vertex_format_),
+                         GetAttributeDescriptions(*vertex_, vertex_format_));
 }
 
 PipelineLayout &Material::GetPipelineLayout() {
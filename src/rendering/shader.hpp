@@ -1,7 +1,10 @@
 #pragma once
 
 #include <vulkan/vulkan_core.h>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <tuple>
 #include <vector>
 #include "common.hpp"
 
@@ -9,6 +12,28 @@
 
 namespace vre::rendering {
 
+// Storage of the position attribute (location 0). Quantized formats hold positions normalized to the mesh
+// bounds; the matching dequantization transform is folded into the model matrix.
+enum class VertexFormat : uint8_t {
+  kFloat32,
+  kFloat16,
+  kSnorm16,
+};
+
+// How a graphics pipeline uses the depth attachment of its subpass.
+enum class DepthMode : uint8_t {
+  kDisabled,
+  // Less test with depth writes.
+  kTestAndWrite,
+  // Depth-only pre-pass: position-only vertex stage, no fragment stage and no color writes.
+  kPrePass,
+  // Shading after a pre-pass: equal test without writes, so every pixel is shaded once.
+  kEqual,
+};
+
+[[nodiscard]] VkFormat GetPositionFormat(VertexFormat format);
+[[nodiscard]] uint32_t GetPositionStride(VertexFormat format);
+
 struct DescriptorSetLayout {
   struct UniformBuffer {
     uint32_t binding;
@@ -21,6 +46,8 @@ struct ResourceLayout {
     uint32_t location;
     uint32_t offset;
     uint32_t width;
+    // Attribute format of 32-bit scalar and vector inputs, VK_FORMAT_UNDEFINED for the rest.
+    VkFormat format;
     std::string name;
   };
 
@@ -41,6 +68,9 @@ class Shader {
   enum Type {
     kVertex,
     kFragment,
+    kCompute,
+    kTask,
+    kMesh,
   };
 
   Shader(VkDevice device, Type type, const std::string &path);
@@ -96,36 +126,46 @@ class PipelineLayout {
   CombinedResourceLayout resource_layout_;
 };
 
+// Pipelines of a material differ by render pass compatibility id, subpass, depth mode and polygon mode.
+using PipelineKey = std::tuple<uint64_t, uint32_t, DepthMode, bool>;
+
 class Material {
  public:
-  Material(VkDevice device, std::shared_ptr<Shader> fragment, std::shared_ptr<Shader> vertex);
+  // |depth_vertex| is the position-only vertex shader of depth pre-passes. It has to compute gl_Position
+  // exactly like |vertex| (see `invariant` in assets/shaders/depth.vert) and must not add resources.
+  Material(VkDevice device, std::shared_ptr<Shader> fragment, std::shared_ptr<Shader> vertex,
+           VertexFormat vertex_format = VertexFormat::kFloat32,
+           std::shared_ptr<Shader> depth_vertex = nullptr);
   ~Material();
 
   Material(Material &) = delete;
   Material(Material &&) = delete;
 
-  [[nodiscard]] std::vector<VkPipelineShaderStageCreateInfo> GetShaderStages() const;
+  [[nodiscard]] std::vector<VkPipelineShaderStageCreateInfo> GetShaderStages(DepthMode depth_mode) const;
   [[nodiscard]] std::tuple<std::vector<VkVertexInputBindingDescription>,
                            std::vector<VkVertexInputAttributeDescription>>
   GetInputBindings() const;
 
   [[nodiscard]] PipelineLayout &GetPipelineLayout();
+  [[nodiscard]] VertexFormat GetVertexFormat() const { return vertex_format_; }
 
-  [[nodiscard]] VkPipeline GetPipeline() { return pipeline_; }
-  void SetPipeline(VkPipeline pipeline) {
-    VR_ASSERT(pipeline_ == VK_NULL_HANDLE);
-    pipeline_ = pipeline;
-  }
+  // Pipelines are looked up and added by every recording thread.
+  [[nodiscard]] VkPipeline GetPipeline(const PipelineKey &key) const;
+  // Returns the pipeline stored for |key|, |pipeline| is destroyed when another thread stored one first.
+  VkPipeline SetPipeline(const PipelineKey &key, VkPipeline pipeline);
 
  private:
   VkDevice device_;
 
   std::shared_ptr<Shader> fragment_;
   std::shared_ptr<Shader> vertex_;
+  VertexFormat vertex_format_;
+  std::shared_ptr<Shader> depth_vertex_;
 
   CombinedResourceLayout combined_resource_layout_;
   std::shared_ptr<PipelineLayout> pipeline_layout_;
-  VkPipeline pipeline_ = VK_NULL_HANDLE;
+  mutable std::mutex pipelines_mutex_;
+  std::map<PipelineKey, VkPipeline> pipelines_;
 };
 
 }  // namespace vre::rendering
\ No newline at end of file
@@ -0,0 +1,191 @@
+#include "submit_thread.hpp"
+
+namespace vre::rendering {
+
+SubmitThread::SubmitThread(VkDevice device, VkQueue graphics_queue, VkQueue present_queue)
+    : device_(device), graphics_queue_(graphics_queue), present_queue_(present_queue) {
+  VkSemaphoreTypeCreateInfo type_info{};
+  type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  type_info.initialValue = 0;
+
+  VkSemaphoreCreateInfo semaphore_info{};
+  semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphore_info.pNext = &type_info;
+  CHECK_VK_SUCCESS(vkCreateSemaphore(device_, &semaphore_info, nullptr, &timeline_));
+
+  thread_ = std::thread([this] { ThreadLoop(); });
+}
+
+SubmitThread::~SubmitThread() {
+  {
+    std::lock_guard lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_one();
+  thread_.join();
+
+  vkDestroySemaphore(device_, timeline_, nullptr);
+}
+
+uint64_t SubmitThread::Submit(const Submission &submission) {
+  CheckError();
+
+  while (!queue_.TryPush(submission)) {
+    std::this_thread::yield();
+  }
+  ++submitted_;
+
+  // Pairs with the fence of a submit thread going to sleep, one of the two sees the other.
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (sleeping_.load(std::memory_order_relaxed)) {
+    { std::lock_guard lock(mutex_); }
+    wake_.notify_one();
+  }
+
+  return submitted_;
+}
+
+uint64_t SubmitThread::GetCompletedValue() const {
+  uint64_t value = 0;
+  CHECK_VK_SUCCESS(vkGetSemaphoreCounterValue(device_, timeline_, &value));
+  return value;
+}
+
+void SubmitThread::Wait(uint64_t value) {
+  // A failed submission never signals its value.
+  WaitProcessed(value);
+
+  VkSemaphoreWaitInfo wait_info{};
+  wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+  wait_info.semaphoreCount = 1;
+  wait_info.pSemaphores = &timeline_;
+  wait_info.pValues = &value;
+  CHECK_VK_SUCCESS(vkWaitSemaphores(device_, &wait_info, UINT64_MAX));
+}
+
+void SubmitThread::WaitProcessed(uint64_t value) {
+  {
+    std::unique_lock lock(mutex_);
+    processed_changed_.wait(lock, [this, value] { return processed_ >= value; });
+  }
+  CheckError();
+}
+
+VkResult SubmitThread::AcquireNextImage(VkDevice device, VkSwapchainKHR swapchain, VkSemaphore semaphore,
+                                        uint32_t &image_index) {
+  {
+    std::lock_guard lock(swapchain_mutex_);
+    const auto result = vkAcquireNextImageKHR(device, swapchain, 0, semaphore, VK_NULL_HANDLE, &image_index);
+    if (result != VK_NOT_READY && result != VK_TIMEOUT) {
+      return result;
+    }
+  }
+
+  // An image may only be released by the presents still queued. Once they went out nothing presents until
+  // the next Submit() of this thread, so blocking under the lock cannot hold them up.
+  WaitIdle();
+  std::lock_guard lock(swapchain_mutex_);
+  return vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, semaphore, VK_NULL_HANDLE, &image_index);
+}
+
+VkResult SubmitThread::CreateSwapchain(VkDevice device, const VkSwapchainCreateInfoKHR &create_info,
+                                       VkSwapchainKHR &swapchain) {
+  std::lock_guard lock(swapchain_mutex_);
+  return vkCreateSwapchainKHR(device, &create_info, nullptr, &swapchain);
+}
+
+void SubmitThread::Process(const Submission &submission, uint64_t value) {
+  // The value of a binary semaphore is ignored.
+  const VkSemaphore signal_semaphores[] = {timeline_, submission.signal_semaphore};
+  const uint64_t signal_values[] = {value, 0};
+  const uint32_t signal_count = submission.signal_semaphore != VK_NULL_HANDLE ? 2 : 1;
+
+  VkTimelineSemaphoreSubmitInfo timeline_info{};
+  timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+  timeline_info.signalSemaphoreValueCount = signal_count;
+  timeline_info.pSignalSemaphoreValues = signal_values;
+
+  VkSubmitInfo submit_info{};
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.pNext = &timeline_info;
+  if (submission.wait_semaphore != VK_NULL_HANDLE) {
+    submit_info.waitSemaphoreCount = 1;
+    submit_info.pWaitSemaphores = &submission.wait_semaphore;
+    submit_info.pWaitDstStageMask = &submission.wait_stage;
+  }
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &submission.command_buffer;
+  submit_info.signalSemaphoreCount = signal_count;
+  submit_info.pSignalSemaphores = signal_semaphores;
+
+  if (submission.before_submit) {
+    submission.before_submit();
+  }
+  const auto result = vkQueueSubmit(graphics_queue_, 1, &submit_info, VK_NULL_HANDLE);
+  if (result != VK_SUCCESS) {
+    auto expected = VK_SUCCESS;
+    error_.compare_exchange_strong(expected, result);
+    return;
+  }
+
+  if (submission.swapchain == VK_NULL_HANDLE) {
+    return;
+  }
+
+  VkPresentInfoKHR present_info{};
+  present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+  present_info.waitSemaphoreCount = 1;
+  present_info.pWaitSemaphores = &submission.signal_semaphore;
+  present_info.swapchainCount = 1;
+  present_info.pSwapchains = &submission.swapchain;
+  present_info.pImageIndices = &submission.image_index;
+
+  VkResult present_result;
+  {
+    std::lock_guard lock(swapchain_mutex_);
+    present_result = vkQueuePresentKHR(present_queue_, &present_info);
+  }
+
+  // The semaphore wait happens even when the image was not presented.
+  if (present_result == VK_ERROR_OUT_OF_DATE_KHR || present_result == VK_SUBOPTIMAL_KHR) {
+    swapchain_outdated_ = true;
+  } else if (present_result != VK_SUCCESS) {
+    auto expected = VK_SUCCESS;
+    error_.compare_exchange_strong(expected, present_result);
+  }
+}
+
+void SubmitThread::ThreadLoop() {
+  while (true) {
+    Submission submission;
+    if (queue_.TryPop(submission)) {
+      // Only this thread writes |processed_|.
+      Process(submission, processed_ + 1);
+      {
+        std::lock_guard lock(mutex_);
+        processed_++;
+      }
+      processed_changed_.notify_all();
+      continue;
+    }
+
+    std::unique_lock lock(mutex_);
+    if (stopping_) {
+      return;
+    }
+
+    sleeping_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    wake_.wait(lock, [this] { return stopping_ || !queue_.IsEmpty(); });
+    sleeping_.store(false, std::memory_order_relaxed);
+  }
+}
+
+void SubmitThread::CheckError() const {
+  if (error_.load() != VK_SUCCESS) {
+    throw std::runtime_error("failed to submit or present a frame!");
+  }
+}
+
+}  // namespace vre::rendering
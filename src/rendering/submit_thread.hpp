@@ -0,0 +1,94 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "common.hpp"
+#include "platform/spsc_queue.hpp"
+
+namespace vre::rendering {
+
+struct Submission {
+  VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+  VkSemaphore wait_semaphore = VK_NULL_HANDLE;
+  VkPipelineStageFlags wait_stage = 0;
+  VkSemaphore signal_semaphore = VK_NULL_HANDLE;
+
+  // Runs on the submit thread right before vkQueueSubmit, to write the newest data into mapped buffers the
+  // command buffer reads.
+  std::function<void()> before_submit;
+
+  // Presented right after the submit when set, once |signal_semaphore| is signalled.
+  VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+  uint32_t image_index = 0;
+};
+
+// Owns the graphics and present queues: vkQueueSubmit and vkQueuePresentKHR run on a thread of their own, so
+// the recording thread does not block in them. Submissions are handed over through a lock-free queue and
+// processed in order. Only one thread may submit at a time, the one recording frames.
+//
+// The n-th submission signals n on a timeline semaphore once its commands, and every command submitted
+// before them, finished. Resources are retired by these values instead of per-submission fences.
+class SubmitThread {
+ public:
+  static constexpr size_t kCapacity = 16;
+
+  SubmitThread(VkDevice device, VkQueue graphics_queue, VkQueue present_queue);
+  ~SubmitThread();
+
+  SubmitThread(SubmitThread &) = delete;
+  SubmitThread(SubmitThread &&) = delete;
+
+  // Returns at once with the timeline value the submission signals. Throws if an earlier submission failed.
+  uint64_t Submit(const Submission &submission);
+
+  // A host query of the timeline, the GPU finished every submission up to this value.
+  [[nodiscard]] uint64_t GetCompletedValue() const;
+  [[nodiscard]] bool IsComplete(uint64_t value) const { return GetCompletedValue() >= value; }
+  // Blocks until the GPU finished the submission of |value|.
+  void Wait(uint64_t value);
+  // Waits until every submission was passed to the queue.
+  void WaitIdle() { WaitProcessed(submitted_); }
+
+  // vkAcquireNextImageKHR has to be synchronized with presents of the same swapchain.
+  VkResult AcquireNextImage(VkDevice device, VkSwapchainKHR swapchain, VkSemaphore semaphore,
+                            uint32_t &image_index);
+  // Creating a swapchain retires its oldSwapchain, which may still be presented to.
+  VkResult CreateSwapchain(VkDevice device, const VkSwapchainCreateInfoKHR &create_info,
+                           VkSwapchainKHR &swapchain);
+  // True once after a present reported the swapchain out of date or suboptimal.
+  bool TakeSwapchainOutdated() { return swapchain_outdated_.exchange(false); }
+
+ private:
+  void WaitProcessed(uint64_t value);
+  void Process(const Submission &submission, uint64_t value);
+  void ThreadLoop();
+  void CheckError() const;
+
+  VkDevice device_;
+  VkQueue graphics_queue_;
+  VkQueue present_queue_;
+  VkSemaphore timeline_ = VK_NULL_HANDLE;
+
+  platform::SpscQueue<Submission, kCapacity> queue_;
+  // Only touched by the submitting thread.
+  uint64_t submitted_ = 0;
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable processed_changed_;
+  uint64_t processed_ = 0;
+  std::atomic<bool> sleeping_{false};
+  bool stopping_ = false;
+  std::atomic<VkResult> error_{VK_SUCCESS};
+
+  std::mutex swapchain_mutex_;
+  std::atomic<bool> swapchain_outdated_{false};
+
+  std::thread thread_;
+};
+
+}  // namespace vre::rendering
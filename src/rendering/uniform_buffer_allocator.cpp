@@ -60,6 +60,8 @@ UniformBufferPoolAllocator::~UniformBufferPoolAllocator() {
 std::shared_ptr<UniformBufferAllocation> UniformBufferPoolAllocator::Allocate(VkDeviceSize minimum_size) {
   VR_ASSERT(minimum_size <= block_size_);
 
+  std::lock_guard lock(mutex_);
+
   for (auto it = free_blocks_.begin(); it != free_blocks_.end(); ++it) {
     auto allocation = *it;
     if (allocation->GetSize() >= minimum_size) {
@@ -80,6 +82,7 @@ std::shared_ptr<UniformBufferAllocation> UniformBufferPoolAllocator::Allocate(Vk
 }
 
 void UniformBufferPoolAllocator::Deallocate(std::shared_ptr<UniformBufferAllocation> allocation) {
+  std::lock_guard lock(mutex_);
   free_blocks_.push_back(allocation);
 }
 
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <mutex>
+
 #include "common.hpp"
 
 #include "rendering/buffers.hpp"
@@ -43,6 +45,7 @@ class UniformBufferPoolAllocator {
                              VkBufferUsageFlags usage);
   ~UniformBufferPoolAllocator();
 
+  // Blocks are taken and returned by the command buffers of every recording thread.
   std::shared_ptr<UniformBufferAllocation> Allocate(VkDeviceSize minimum_size);
   void Deallocate(std::shared_ptr<UniformBufferAllocation> allocation);
 
@@ -55,6 +58,7 @@ class UniformBufferPoolAllocator {
   VkDeviceSize alignment_;
   VkBufferUsageFlags usage_;
 
+  std::mutex mutex_;
   std::list<std::shared_ptr<UniformBufferAllocation>> free_blocks_;
 };
 
@@ -0,0 +1,159 @@
+#include "upload_batch.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include "helpers.hpp"
+#include "rendering/render_core.hpp"
+
+namespace vre::rendering {
+
+namespace {
+
+constexpr VkDeviceSize kStagingBlockSize = 16 * 1024 * 1024;
+constexpr VkDeviceSize kStagingAlignment = 16;
+
+}  // namespace
+
+UploadBatch::UploadBatch(RenderCore &core) : core_(core) {}
+
+UploadBatch::~UploadBatch() {
+  VR_ASSERT(copies_.empty());
+  if (submission_ != 0) {
+    core_.GetSubmitThread().Wait(submission_);
+    Release();
+  }
+}
+
+std::shared_ptr<Buffer> UploadBatch::CreateBuffer(const CreateBufferInfo &create_info) {
+  auto info = create_info;
+  info.initial_data = nullptr;
+  auto buffer = core_.CreateBuffer(info);
+
+  if (create_info.initial_data == nullptr) {
+    return buffer;
+  }
+
+  const auto size = static_cast<size_t>(create_info.buffer_size);
+  if (buffer->IsMapped()) {
+    memcpy(buffer->GetMappedData(), create_info.initial_data, size);
+    return buffer;
+  }
+
+  VkDeviceSize offset = 0;
+  auto &block = AllocateStaging(create_info.buffer_size, offset);
+  memcpy(reinterpret_cast<uint8_t *>(block.buffer->GetMappedData()) + offset, create_info.initial_data, size);
+
+  PendingCopy copy{};
+  copy.src = block.buffer->GetBuffer();
+  copy.dst = buffer->GetBuffer();
+  copy.region.srcOffset = offset;
+  copy.region.dstOffset = 0;
+  copy.region.size = create_info.buffer_size;
+  copies_.push_back(copy);
+  destinations_.push_back(buffer);
+
+  pending_bytes_ += create_info.buffer_size;
+
+  return buffer;
+}
+
+UploadBatch::StagingBlock &UploadBatch::AllocateStaging(VkDeviceSize size, VkDeviceSize &offset) {
+  if (!staging_blocks_.empty()) {
+    auto &block = staging_blocks_.back();
+    const auto aligned = (block.used + kStagingAlignment - 1) & ~(kStagingAlignment - 1);
+    if (aligned + size <= block.buffer->GetSize()) {
+      block.used = aligned + size;
+      offset = aligned;
+      return block;
+    }
+  }
+
+  CreateBufferInfo staging_info{};
+  staging_info.buffer_size = std::max(size, kStagingBlockSize);
+  staging_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+  staging_info.memory_usage = VMA_MEMORY_USAGE_CPU_ONLY;
+
+  auto &block = staging_blocks_.emplace_back();
+  block.buffer = core_.CreateBuffer(staging_info);
+  block.used = size;
+  offset = 0;
+  return block;
+}
+
+void UploadBatch::Flush() {
+  VR_ASSERT(submission_ == 0);
+  if (copies_.empty()) {
+    staging_blocks_.clear();
+    return;
+  }
+
+  const auto device = core_.GetDevice();
+
+  VkCommandBufferAllocateInfo alloc_info{};
+  alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  alloc_info.commandPool = core_.GetCommandPool();
+  alloc_info.commandBufferCount = 1;
+  CHECK_VK_SUCCESS(vkAllocateCommandBuffers(device, &alloc_info, &command_buffer_));
+
+  VkCommandBufferBeginInfo begin_info{};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  CHECK_VK_SUCCESS(vkBeginCommandBuffer(command_buffer_, &begin_info));
+
+  for (const auto &copy : copies_) {
+    vkCmdCopyBuffer(command_buffer_, copy.src, copy.dst, 1, &copy.region);
+  }
+
+  VkMemoryBarrier barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+  vkCmdPipelineBarrier(command_buffer_, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+                       1, &barrier, 0, nullptr, 0, nullptr);
+
+  CHECK_VK_SUCCESS(vkEndCommandBuffer(command_buffer_));
+
+  Submission submission;
+  submission.command_buffer = command_buffer_;
+  submission_ = core_.GetSubmitThread().Submit(submission);
+
+  submitted_bytes_ = pending_bytes_;
+  copies_.clear();
+  pending_bytes_ = 0;
+}
+
+bool UploadBatch::IsComplete() {
+  if (submission_ == 0) {
+    return copies_.empty();
+  }
+
+  if (!core_.GetSubmitThread().IsComplete(submission_)) {
+    return false;
+  }
+
+  Release();
+  return true;
+}
+
+void UploadBatch::Submit() {
+  Flush();
+  if (submission_ != 0) {
+    core_.GetSubmitThread().Wait(submission_);
+    Release();
+  }
+}
+
+void UploadBatch::Release() {
+  vkFreeCommandBuffers(core_.GetDevice(), core_.GetCommandPool(), 1, &command_buffer_);
+  submission_ = 0;
+  command_buffer_ = VK_NULL_HANDLE;
+
+  SPDLOG_DEBUG("Uploaded {} buffers, {} bytes", destinations_.size(), submitted_bytes_);
+
+  destinations_.clear();
+  staging_blocks_.clear();
+  submitted_bytes_ = 0;
+}
+
+}  // namespace vre::rendering
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "common.hpp"
+#include "rendering/buffers.hpp"
+
+namespace vre::rendering {
+
+class RenderCore;
+
+// Collects buffer uploads so that any number of them share staging blocks, a single command buffer and
+// a single wait, instead of one vkQueueWaitIdle per buffer.
+class UploadBatch {
+ public:
+  explicit UploadBatch(RenderCore &core);
+  ~UploadBatch();
+
+  UploadBatch(UploadBatch &) = delete;
+  UploadBatch(UploadBatch &&) = delete;
+
+  // Creates the buffer right away; |initial_data| is copied to staging now and reaches the buffer when
+  // the batch is submitted.
+  std::shared_ptr<Buffer> CreateBuffer(const CreateBufferInfo &create_info);
+
+  [[nodiscard]] VkDeviceSize GetPendingBytes() const { return pending_bytes_; }
+  [[nodiscard]] bool IsEmpty() const { return copies_.empty(); }
+
+  // Submits the copies without waiting. Work submitted afterwards to the graphics queue is ordered after
+  // them, so the buffers can be drawn right away; staging memory is kept until IsComplete() returns true.
+  void Flush();
+  bool IsComplete();
+
+  // Flushes and blocks until the copies are done.
+  void Submit();
+
+ private:
+  struct StagingBlock {
+    std::shared_ptr<Buffer> buffer;
+    VkDeviceSize used = 0;
+  };
+
+  struct PendingCopy {
+    VkBuffer src;
+    VkBuffer dst;
+    VkBufferCopy region;
+  };
+
+  RenderCore &core_;
+
+  std::vector<StagingBlock> staging_blocks_;
+  std::vector<PendingCopy> copies_;
+  std::vector<std::shared_ptr<Buffer>> destinations_;
+
+  VkDeviceSize pending_bytes_ = 0;
+
+  VkCommandBuffer command_buffer_ = VK_NULL_HANDLE;
+  // Timeline value of the submitted copies, zero while none are in flight.
+  uint64_t submission_ = 0;
+  VkDeviceSize submitted_bytes_ = 0;
+
+ private:
+  StagingBlock &AllocateStaging(VkDeviceSize size, VkDeviceSize &offset);
+  void Release();
+};
+
+}  // namespace vre::rendering
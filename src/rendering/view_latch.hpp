@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cmath>
+#include <mutex>
+
+#include "common.hpp"
+
+namespace vre::rendering {
+
+// Left and right eye with stereo rendering.
+constexpr uint32_t kMaxViews = 2;
+
+// Largest change of a camera the latch applies over the snapshot the frame was culled with, in radians and
+// scene units. Culling widens its bounds by it, frames keep the snapshot pose when the camera moved further.
+constexpr float kMaxLatchRotation = 0.05F;
+constexpr float kMaxLatchTranslation = 0.05F;
+
+// Cameras of the views rendered by the main passes, indexed by gl_ViewIndex (see assets/shaders/shader.vert).
+struct ViewUniforms {
+  glm::mat4 view[kMaxViews];
+  glm::mat4 proj[kMaxViews];
+};
+
+// Whether every camera of |latched| is within the latch bounds of the same camera in |snapshot|.
+inline bool IsWithinLatchBounds(const ViewUniforms &snapshot, const ViewUniforms &latched) {
+  for (uint32_t view = 0; view < kMaxViews; view++) {
+    if (latched.proj[view] != snapshot.proj[view]) {
+      return false;
+    }
+
+    // Views are rigid, the trace of the relative rotation gives its angle.
+    const auto delta = glm::mat3(latched.view[view] * glm::inverse(snapshot.view[view]));
+    const auto cos_angle = (delta[0][0] + delta[1][1] + delta[2][2] - 1.0F) * 0.5F;
+    const auto eye_distance = glm::distance(glm::vec3(glm::inverse(latched.view[view])[3]),
+                                            glm::vec3(glm::inverse(snapshot.view[view])[3]));
+    if (cos_angle < std::cos(kMaxLatchRotation) || eye_distance > kMaxLatchTranslation) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Holds the newest camera pose. The simulation publishes it as soon as input moved the camera, the submit
+// thread copies it into the view buffer of a frame right before vkQueueSubmit. Draws only reference the view
+// buffer, so the recorded commands stay valid.
+class ViewLatch {
+ public:
+  void Publish(const ViewUniforms &views) {
+    std::lock_guard lock(mutex_);
+    views_ = views;
+    published_ = true;
+  }
+
+  // False until the first Publish(), or when the newest pose is outside the latch bounds of |snapshot|.
+  bool Read(const ViewUniforms &snapshot, ViewUniforms &views) const {
+    std::lock_guard lock(mutex_);
+    if (!published_ || !IsWithinLatchBounds(snapshot, views_)) {
+      return false;
+    }
+    views = views_;
+    return true;
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  ViewUniforms views_{};
+  bool published_ = false;
+};
+
+}  // namespace vre::rendering
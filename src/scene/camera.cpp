@@ -26,10 +26,30 @@ glm::mat4 Camera::GetView() const {
 }
 
 glm::mat4 Camera::GetProjection() const {
+  return GetProjection(0.0F);
+}
+
+glm::mat4 Camera::GetProjection(float depth_offset) const {
   const glm::mat4 clip(1.0f, 0.0f, 0.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.5f, 0.0f, 0.0f, 0.0f,
                        0.5f, 1.0f);
 
-  return clip * glm::perspective(glm::radians(fow_), 1.0F, 0.01F, 100.0F);
+  return clip * glm::perspective(glm::radians(fow_), 1.0F, 0.01F + depth_offset, 100.0F + depth_offset);
+}
+
+StereoViews Camera::GetStereoViews(float ipd) const {
+  const auto view = GetView();
+
+  StereoViews views{};
+  views.eye_views[0] = glm::translate(glm::mat4(1.0F), glm::vec3(0.5F * ipd, 0.0F, 0.0F)) * view;
+  views.eye_views[1] = glm::translate(glm::mat4(1.0F), glm::vec3(-0.5F * ipd, 0.0F, 0.0F)) * view;
+  views.projection = GetProjection();
+
+  // Far enough back for the side planes of its frustum to pass through the eyes, the square projection has
+  // the same field of view horizontally.
+  const auto distance = 0.5F * ipd / std::tan(0.5F * glm::radians(fow_));
+  views.culling_view = glm::translate(glm::mat4(1.0F), glm::vec3(0.0F, 0.0F, -distance)) * view;
+  views.culling_projection = GetProjection(distance);
+  return views;
 }
 
 [[nodiscard]] glm::vec3 Camera::GetRelativeForward() const {
@@ -6,6 +6,15 @@
 
 namespace vre::scene {
 
+// Parallel left and right eye cameras sharing one projection. The culling camera sits behind both, its
+// frustum contains theirs.
+struct StereoViews {
+  glm::mat4 eye_views[2];
+  glm::mat4 projection;
+  glm::mat4 culling_view;
+  glm::mat4 culling_projection;
+};
+
 class Camera : public Attachable {
  public:
   Camera();
@@ -16,6 +25,8 @@ class Camera : public Attachable {
 
   [[nodiscard]] glm::mat4 GetView() const;
   [[nodiscard]] glm::mat4 GetProjection() const;
+  // Eyes |ipd| apart, centered on the camera.
+  [[nodiscard]] StereoViews GetStereoViews(float ipd) const;
 
   [[nodiscard]] glm::vec3 GetRelativeForward() const;
   [[nodiscard]] glm::vec3 GetRelativeLeft() const;
@@ -28,6 +39,9 @@ class Camera : public Attachable {
   float fow_ = 45.0F;
   float yaw_ = .0F;
   float pitch_ = .0F;
+
+  // The near and far planes are |depth_offset| further away from the eye.
+  [[nodiscard]] glm::mat4 GetProjection(float depth_offset) const;
 };
 
 }  // namespace vre::scene
\ No newline at end of file
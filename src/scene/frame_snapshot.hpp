@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vector>
+
+#include "common.hpp"
+
+#include "rendering/view_latch.hpp"
+
+namespace vre::scene {
+
+struct Node;
+
+// Node with a mesh, placed in the world as of the snapshot.
+struct SnapshotItem {
+  Node *node;
+  glm::mat4 transform;
+};
+
+// Everything the render thread reads of a simulated frame. The simulation fills the next snapshot while the
+// previous one is rendered, so the render thread never reads transforms or the camera while they change.
+// Nodes are never destroyed while frames are in flight, only their pointers are shared.
+struct FrameSnapshot {
+  glm::mat4 camera_view;
+  glm::mat4 camera_projection;
+  glm::vec3 camera_position;
+  // Cameras of the rendered views. With stereo rendering the camera above is a culling camera containing
+  // both eyes.
+  rendering::ViewUniforms views;
+
+  std::vector<SnapshotItem> items;
+};
+
+}  // namespace vre::scene
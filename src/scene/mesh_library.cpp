@@ -0,0 +1,42 @@
+#include "mesh_library.hpp"
+
+#include "helpers.hpp"
+#include "rendering/render_core.hpp"
+#include "rendering/upload_batch.hpp"
+
+namespace vre::scene {
+
+rendering::MeshPtr MeshLibrary::Find(const std::string &source, int mesh_index) const {
+  std::lock_guard lock(mutex_);
+  if (const auto it = meshes_.find({source, mesh_index}); it != meshes_.end()) {
+    return it->second;
+  }
+  return nullptr;
+}
+
+rendering::MeshPtr MeshLibrary::Add(const std::string &source, int mesh_index, rendering::MeshPtr mesh) {
+  VR_ASSERT(mesh);
+  std::lock_guard lock(mutex_);
+  return meshes_.emplace(Key{source, mesh_index}, std::move(mesh)).first->second;
+}
+
+void MeshLibrary::InitializeVulkan(rendering::RenderCore &renderer) {
+  std::lock_guard lock(mutex_);
+  rendering::UploadBatch batch(renderer);
+  for (auto &[key, mesh] : meshes_) {
+    mesh->InitializeVulkan(renderer, batch);
+  }
+  batch.Submit();
+}
+
+void MeshLibrary::Clear() {
+  std::lock_guard lock(mutex_);
+  meshes_.clear();
+}
+
+size_t MeshLibrary::GetSize() const {
+  std::lock_guard lock(mutex_);
+  return meshes_.size();
+}
+
+}  // namespace vre::scene
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include "common.hpp"
+#include "rendering/mesh.hpp"
+
+namespace vre {
+
+namespace rendering {
+class RenderCore;
+}
+
+namespace scene {
+
+// Interns meshes per (source file, mesh index), so every node referencing the same source mesh shares
+// one CPU copy and one set of GPU buffers. Safe to use from loader threads.
+class MeshLibrary {
+ public:
+  using Key = std::pair<std::string, int>;
+
+  [[nodiscard]] rendering::MeshPtr Find(const std::string &source, int mesh_index) const;
+  // Returns the mesh already stored under the key if another loader added it first.
+  rendering::MeshPtr Add(const std::string &source, int mesh_index, rendering::MeshPtr mesh);
+
+  void InitializeVulkan(rendering::RenderCore &renderer);
+
+  void Clear();
+
+  [[nodiscard]] size_t GetSize() const;
+
+ private:
+  mutable std::mutex mutex_;
+  std::map<Key, rendering::MeshPtr> meshes_;
+};
+
+}  // namespace scene
+}  // namespace vre
@@ -35,7 +35,11 @@ struct Node {
   std::vector<std::unique_ptr<Node>> childrens_;
 
   std::vector<std::unique_ptr<Attachable>> attachables_;
-  std::unique_ptr<rendering::Mesh> mesh_;
+  rendering::MeshPtr mesh_;
+  // The mesh hides what is behind it well enough to be rasterized for CPU occlusion culling.
+  bool occluder_ = false;
+  // LOD drawn last frame, kept for hysteresis. Only the render thread uses it.
+  uint32_t lod_ = 0;
 };
 
 }  // namespace vre::scene
\ No newline at end of file
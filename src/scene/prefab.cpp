@@ -0,0 +1,43 @@
+#include "prefab.hpp"
+
+#include "helpers.hpp"
+
+namespace vre::scene {
+
+namespace {
+
+void CloneInto(const Node &source, Node &target) {
+  // Attachables own per-instance state and have no way to copy it, so prefabs must not carry any.
+  VR_ASSERT(source.attachables_.empty());
+
+  target.transform_ = source.transform_;
+  target.mesh_ = source.mesh_;
+  target.occluder_ = source.occluder_;
+
+  for (const auto &child : source.childrens_) {
+    CloneInto(*child, target.CreateChildNode(child->name_));
+  }
+}
+
+}  // namespace
+
+Prefab::Prefab(std::string source, std::unique_ptr<Node> root)
+    : source_(std::move(source)), root_(std::move(root)) {
+  VR_ASSERT(root_);
+}
+
+std::unique_ptr<Node> Prefab::Instantiate() const {
+  auto node = std::make_unique<Node>();
+  node->parent = nullptr;
+  node->name_ = root_->name_;
+  CloneInto(*root_, *node);
+  return node;
+}
+
+Node &Prefab::Instantiate(Node &parent, std::string name) const {
+  auto &node = parent.CreateChildNode(std::move(name));
+  CloneInto(*root_, node);
+  return node;
+}
+
+}  // namespace vre::scene
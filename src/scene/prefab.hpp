@@ -0,0 +1,32 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "common.hpp"
+#include "scene/node.hpp"
+
+namespace vre::scene {
+
+// Node hierarchy loaded once from a source file. Instances clone the hierarchy but share mesh handles,
+// so geometry and GPU memory exist once no matter how many times the prefab is placed.
+class Prefab {
+ public:
+  Prefab(std::string source, std::unique_ptr<Node> root);
+
+  Prefab(const Prefab &) = delete;
+  Prefab(Prefab &&) = delete;
+
+  [[nodiscard]] std::unique_ptr<Node> Instantiate() const;
+  Node &Instantiate(Node &parent, std::string name) const;
+
+  [[nodiscard]] const std::string &GetSource() const { return source_; }
+  [[nodiscard]] const Node &GetRoot() const { return *root_; }
+
+ private:
+  const std::string source_;
+  std::unique_ptr<Node> root_;
+};
+using PrefabPtr = std::shared_ptr<Prefab>;
+
+}  // namespace vre::scene
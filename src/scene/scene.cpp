@@ -1,18 +1,131 @@
 #include "scene.hpp"
 
 #include <glm/gtx/matrix_decompose.hpp>
+#include <algorithm>
+#include <filesystem>
 #include <memory>
 
 #include "helpers.hpp"
 #include "node.hpp"
+#include "platform/job_system.hpp"
 #include "rendering/mesh.hpp"
 #include "rendering/render_core.hpp"
+#include "serialization/cooked_scene_loader.hpp"
 #include "serialization/gltf_loader.hpp"
 
 namespace vre::scene {
 
+namespace {
+
+// A coarser LOD is only picked once its error is this fraction of the budget, so a node near the switch
+// distance does not alternate between two LODs.
+constexpr float kLodHysteresis = 0.75F;
+
+// A box test is cheap, fewer per job are not worth scheduling.
+constexpr size_t kMinOcclusionTestsPerJob = 256;
+
+// Eye separation of stereo rendering, in scene units taken as meters.
+constexpr float kInterpupillaryDistance = 0.064F;
+
+struct LodParameters {
+  glm::vec3 camera_position;
+  // Pixels covered by one unit at distance one.
+  float pixels_per_unit;
+  float pixel_error;
+};
+
+uint32_t SelectLod(const rendering::Mesh &mesh, const glm::mat4 &transform, uint32_t current,
+                   const LodParameters &parameters) {
+  const auto lod_count = mesh.GetLodCount();
+  const auto &bounds = mesh.GetBounds();
+  if (lod_count == 1 || !bounds.IsValid()) {
+    return 0;
+  }
+
+  const auto scale = std::max({glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])),
+                               glm::length(glm::vec3(transform[2]))});
+  const auto center = glm::vec3(transform * glm::vec4(bounds.GetCenter(), 1.0F));
+  const auto radius = glm::length(bounds.GetExtent()) * scale;
+
+  // Errors are measured at the closest point of the bounding sphere.
+  const auto distance = glm::distance(parameters.camera_position, center) - radius;
+  if (distance <= 0.0F) {
+    return 0;
+  }
+  const auto pixels_per_error = parameters.pixels_per_unit * scale / distance;
+
+  const auto coarsest_within = [&](float budget) {
+    for (auto lod = lod_count - 1; lod > 0; lod--) {
+      if (mesh.GetLodError(lod) * pixels_per_error <= budget) {
+        return lod;
+      }
+    }
+    return 0U;
+  };
+
+  const auto coarser = coarsest_within(parameters.pixel_error * kLodHysteresis);
+  if (coarser > current) {
+    return coarser;
+  }
+  return std::min(current, coarsest_within(parameters.pixel_error));
+}
+
+void CollectNodes(Node &node, const glm::mat4 &parent_transform, std::vector<SnapshotItem> &items) {
+  const auto transform = parent_transform * node.GetTransform();
+  if (node.mesh_) {
+    items.push_back({&node, transform});
+  }
+
+  for (auto &child : node.childrens_) {
+    CollectNodes(*child, transform, items);
+  }
+}
+
+std::unique_ptr<Node> LoadHierarchy(const std::string &filename, MeshLibrary &library) {
+  if (std::filesystem::path(filename).extension() == ".vrscene") {
+    return serialization::CookedSceneLoader::LoadFromFile(filename, library);
+  }
+  return serialization::GLTFLoader::LoadFromFile(filename, library);
+}
+
+}  // namespace
+
 void Scene::LoadFromFile() {
-  root_node_ = serialization::GLTFLoader::LoadFromFile("assets/scenes/basic.gltf");
+  root_node_ = std::make_unique<Node>();
+  root_node_->parent = nullptr;
+
+  // Cooked scenes are produced with `vrengine --cook <scene.gltf> <scene.vrscene>`.
+  const std::string cooked_scene = "assets/scenes/basic.vrscene";
+  const auto filename = std::filesystem::exists(cooked_scene) ? cooked_scene : "assets/scenes/basic.gltf";
+  scene_node_ = &root_node_->CreateChildNode("scene");
+  StreamPrefab(filename, *scene_node_, "basic");
+}
+
+PrefabPtr Scene::LoadPrefab(const std::string &filename) {
+  if (const auto it = prefabs_.find(filename); it != prefabs_.end()) {
+    return it->second;
+  }
+
+  auto prefab = std::make_shared<Prefab>(filename, LoadHierarchy(filename, mesh_library_));
+  prefabs_.emplace(filename, prefab);
+  return prefab;
+}
+
+Node &Scene::Instantiate(const Prefab &prefab, Node &parent, std::string name) {
+  auto &node = prefab.Instantiate(parent, std::move(name));
+  streamer_.QueueUploads(node);
+  return node;
+}
+
+void Scene::StreamPrefab(const std::string &filename, Node &parent, std::string name) {
+  if (const auto it = prefabs_.find(filename); it != prefabs_.end()) {
+    Instantiate(*it->second, parent, std::move(name));
+    return;
+  }
+
+  streamer_.Load(
+      [this, filename] { return std::make_shared<Prefab>(filename, LoadHierarchy(filename, mesh_library_)); },
+      parent, std::move(name));
 }
 
 void Scene::CreateCamera() {
@@ -24,32 +137,283 @@ void Scene::CreateCamera() {
 }
 
 void Scene::InitializeVulkan(rendering::RenderCore &renderer) {
-  for (auto &child : root_node_->childrens_) {
-    if (child->mesh_) {
-      child->mesh_->InitializeVulkan(renderer);
+  renderer_ = &renderer;
+  meshlet_renderer_ = std::make_unique<rendering::MeshletRenderer>(renderer);
+  occlusion_culler_ = std::make_unique<rendering::OcclusionCuller>(renderer);
+}
+
+void Scene::Update(FrameSnapshot &snapshot) {
+  for (auto &loaded : streamer_.TakeLoadedPrefabs()) {
+    if (!loaded.prefab) {
+      spdlog::error("Failed to stream {}: {}", loaded.name, loaded.error);
+      continue;
     }
+    const auto &prefab = *prefabs_.emplace(loaded.prefab->GetSource(), loaded.prefab).first->second;
+    Instantiate(prefab, *loaded.parent, std::move(loaded.name));
   }
 
-  if (root_node_->mesh_) {
-    root_node_->mesh_->InitializeVulkan(renderer);
+  if (IsStereo()) {
+    const auto stereo_views = main_camera_->GetStereoViews(kInterpupillaryDistance);
+    snapshot.camera_view = stereo_views.culling_view;
+    snapshot.camera_projection = stereo_views.culling_projection;
+  } else {
+    snapshot.camera_view = main_camera_->GetView();
+    snapshot.camera_projection = main_camera_->GetProjection();
   }
+  snapshot.views = GetCameraViews();
+  snapshot.camera_position = GetMainCameraPosition();
+  snapshot.items.clear();
+  CollectNodes(*root_node_, glm::mat4(1.0F), snapshot.items);
 }
 
-void Scene::Update() {
+void Scene::PublishCameraPose() {
+  if (renderer_ != nullptr) {
+    renderer_->GetViewLatch().Publish(GetCameraViews());
+  }
+}
+
+bool Scene::IsStereo() const {
+  return renderer_ != nullptr && renderer_->GetViewCount() > 1;
+}
+
+rendering::ViewUniforms Scene::GetCameraViews() const {
+  rendering::ViewUniforms views{};
+  if (IsStereo()) {
+    const auto stereo_views = main_camera_->GetStereoViews(kInterpupillaryDistance);
+    for (uint32_t view = 0; view < rendering::kMaxViews; view++) {
+      views.view[view] = stereo_views.eye_views[view];
+      views.proj[view] = stereo_views.projection;
+    }
+    return views;
+  }
+
+  for (uint32_t view = 0; view < rendering::kMaxViews; view++) {
+    views.view[view] = main_camera_->GetView();
+    views.proj[view] = main_camera_->GetProjection();
+  }
+  return views;
+}
+
+void Scene::UploadMeshes(const FrameSnapshot &snapshot) {
+  if (renderer_ != nullptr) {
+    streamer_.Update(*renderer_, snapshot);
+  }
+}
+
+void Scene::PrepareFrame(rendering::RenderContext &context, const FrameSnapshot &snapshot) {
+  context.render_data.camera_view = snapshot.camera_view;
+  context.render_data.camera_projection = snapshot.camera_projection;
+  context.render_data.camera_position = snapshot.camera_position;
+  context.render_data.eye_offset = context.render_data.view_count > 1 ? 0.5F * kInterpupillaryDistance : 0.0F;
+  context.render_data.views = snapshot.views;
+
+  LodParameters lod_parameters{};
+  lod_parameters.camera_position = context.render_data.camera_position;
+  lod_parameters.pixels_per_unit = std::abs(context.render_data.camera_projection[1][1]) * 0.5F *
+                                   float(context.render_data.viewport_extent.height);
+  lod_parameters.pixel_error = lod_pixel_error_;
+
+  draw_list_.clear();
+  for (const auto &item : snapshot.items) {
+    auto &node = *item.node;
+    if (node.mesh_->IsUploaded()) {
+      node.lod_ = SelectLod(*node.mesh_, item.transform, node.lod_, lod_parameters);
+      draw_list_.push_back({&node, item.transform, std::nullopt});
+    }
+  }
+  // The occluders are rasterized from a single view, which does not see everything the eyes see.
+  if (software_occlusion_culling_ && context.render_data.view_count == 1) {
+    CullOccludedItems(context.render_data.camera_projection * context.render_data.camera_view);
+  }
+
+  // Meshlets only cover the full resolution mesh, coarser LODs are drawn whole.
+  if (UsesMeshlets()) {
+    meshlet_renderer_->BeginCulling(context);
+    if (!meshlet_renderer_->UsesMeshShaders()) {
+      for (auto &item : draw_list_) {
+        if (item.node->lod_ == 0 && item.node->mesh_->HasMeshlets()) {
+          item.meshlet_draws = meshlet_renderer_->Cull(context, *item.node->mesh_, item.transform);
+        }
+      }
+    }
+    meshlet_renderer_->EndCulling(context);
+  }
+
+  // Meshes culled per meshlet are always drawn in the first phase, where they only serve as occluders. The
+  // depth pyramid is built from a single view.
+  occlusion_culled_ = occlusion_culler_ && occlusion_culling_ && context.render_data.view_count == 1;
+  if (occlusion_culled_) {
+    occlusion_culler_->BeginFrame(context);
+    for (auto &item : draw_list_) {
+      if (!item.meshlet_draws && !DrawsMeshTasks(item)) {
+        item.occlusion_draws =
+            occlusion_culler_->AddInstance(item.node, *item.node->mesh_, item.transform, item.node->lod_);
+      }
+    }
+  }
+}
+
+bool Scene::UsesMeshlets() const {
+  return meshlet_renderer_ && meshlet_renderer_->IsSupported();
+}
+
+bool Scene::DrawsMeshTasks(const DrawItem &item) const {
+  return UsesMeshlets() && meshlet_renderer_->UsesMeshShaders() && item.node->lod_ == 0 &&
+         item.node->mesh_->HasMeshlets();
+}
+
+void Scene::CullOccludedItems(const glm::mat4 &view_projection) {
+  occlusion_rasterizer_.Begin(view_projection);
+
+  // The coarsest LOD is plenty at the resolution of the occlusion buffer.
+  for (const auto &item : draw_list_) {
+    if (!item.node->occluder_) {
+      continue;
+    }
+
+    const auto &mesh = *item.node->mesh_;
+    const auto lod = mesh.GetLodCount() - 1;
+    for (size_t i = 0; i < mesh.GetPrimitives().size(); i++) {
+      const auto [first_index, index_count] = mesh.GetLodIndexRange(i, lod);
+      occlusion_rasterizer_.RasterizeTriangles(item.transform, mesh.GetPositions(),
+                                               mesh.GetIndices() + first_index, index_count);
+    }
+  }
+
+  // Occluders are tested as well, their own triangles are never nearer than their bounds. The occlusion
+  // buffer is only read from here on.
+  std::vector<uint8_t> visible(draw_list_.size());
+  platform::JobSystem::Default().ParallelForRanges(
+      draw_list_.size(), kMinOcclusionTestsPerJob, [this, &visible](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+          const auto &item = draw_list_[i];
+          const auto &bounds = item.node->mesh_->GetBounds();
+          visible[i] = !bounds.IsValid() ||
+                       occlusion_rasterizer_.IsVisible(item.transform, bounds.min, bounds.max);
+        }
+      });
+
+  size_t kept = 0;
+  for (size_t i = 0; i < draw_list_.size(); i++) {
+    if (!visible[i]) {
+      continue;
+    }
+    if (kept != i) {
+      draw_list_[kept] = std::move(draw_list_[i]);
+    }
+    kept++;
+  }
+  draw_list_.erase(draw_list_.begin() + kept, draw_list_.end());
 }
 
 void Scene::Render(rendering::RenderContext &context) {
-  context.render_data.camera_view = main_camera_->GetView();
-  context.render_data.camera_projection = main_camera_->GetProjection();
+  if (!occlusion_culled_) {
+    AddMainPass(context, 0);
+    return;
+  }
+
+  occlusion_culler_->AddCullPass(context, 0);
+  AddMainPass(context, 0);
+  occlusion_culler_->AddDepthPyramidPass(context);
+  occlusion_culler_->AddCullPass(context, 1);
+  AddMainPass(context, 1);
+}
+
+void Scene::AddMainPass(rendering::RenderContext &context, uint32_t phase) {
+  auto &pass = context.render_graph->AddPass(phase == 0 ? "main" : "main late",
+                                             rendering::RenderGraphPass::kGraphics);
 
-  for (auto &child : root_node_->childrens_) {
-    if (child->mesh_) {
-      child->mesh_->Render(context, child->GetTransform());
+  // The second phase draws on top of the first one.
+  const auto load = phase == 0 ? rendering::AttachmentLoad::kClear : rendering::AttachmentLoad::kLoad;
+  pass.AddColorOutput(context.scene_color, load);
+  pass.SetDepthStencilOutput(context.depth_buffer, load);
+  if (context.render_data.view_count > 1) {
+    pass.SetViewMask((1U << context.render_data.view_count) - 1);
+  }
+  if (context.render_data.depth_pre_pass) {
+    pass.AddSubpass({{}, true});
+    pass.AddSubpass({{0}, true});
+  }
+
+  if (occlusion_culled_) {
+    pass.AddBufferInput(occlusion_culler_->GetCommands(), VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                        VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+  }
+
+  // The pipeline statistics query and the mesh shader draws of the first phase stay in the primary buffer.
+  const bool parallel = (phase != 0 || !UsesMeshlets()) &&
+                        draw_list_.size() >= 2 * rendering::ParallelRecorder::kMinItemsPerRange &&
+                        renderer_->GetParallelRecorder().GetMaxRanges() > 1;
+  if (parallel) {
+    pass.SetSecondaryCommandBuffers();
+  }
+
+  pass.SetCallback([this, phase, parallel](rendering::RenderContext &pass_context) {
+    RenderDrawList(pass_context, phase, parallel);
+  });
+}
+
+void Scene::RenderItem(rendering::RenderContext &context, const DrawItem &item, uint32_t phase) {
+  auto &mesh = *item.node->mesh_;
+  if (item.occlusion_draws) {
+    mesh.RenderIndirect(context, item.transform, item.node->lod_, *item.occlusion_draws->commands,
+                        item.occlusion_draws->offsets[phase]);
+  } else if (item.meshlet_draws) {
+    mesh.RenderMeshlets(context, item.transform, *item.meshlet_draws);
+  } else {
+    mesh.Render(context, item.transform, item.node->lod_);
+  }
+}
+
+void Scene::RenderDrawList(rendering::RenderContext &context, uint32_t phase, bool parallel) {
+  context.command_buffer->SetDepthMode(context.render_data.depth_pre_pass
+                                           ? rendering::DepthMode::kPrePass
+                                           : rendering::DepthMode::kTestAndWrite);
+
+  const auto record_items = [this, phase](rendering::RenderContext &items_context, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      const auto &item = draw_list_[i];
+      if (phase == 0 ? !DrawsMeshTasks(item) : item.occlusion_draws.has_value()) {
+        RenderItem(items_context, item, phase);
+      }
+    }
+  };
+  const auto record_draw_list = [&] {
+    if (parallel) {
+      renderer_->GetParallelRecorder().Record(context, draw_list_.size(), record_items);
+    } else {
+      record_items(context, 0, draw_list_.size());
     }
+  };
+
+  // Mesh shader draws stay out of the pre-pass, they test and write depth in the shading subpass instead.
+  if (context.render_data.depth_pre_pass) {
+    record_draw_list();
+
+    context.command_buffer->NextSubpass(parallel ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                                                 : VK_SUBPASS_CONTENTS_INLINE);
+    context.command_buffer->SetDepthMode(rendering::DepthMode::kEqual);
   }
 
-  if (root_node_->mesh_) {
-    root_node_->mesh_->Render(context, root_node_->GetTransform());
+  const bool record_statistics = phase == 0 && UsesMeshlets();
+  if (record_statistics) {
+    meshlet_renderer_->BeginStatistics(context);
+  }
+
+  record_draw_list();
+
+  if (phase == 0) {
+    for (auto &item : draw_list_) {
+      if (DrawsMeshTasks(item)) {
+        item.meshlet_draws = meshlet_renderer_->DrawMeshTasks(context, *item.node->mesh_, item.transform);
+        context.command_buffer->SetDepthMode(rendering::DepthMode::kTestAndWrite);
+        RenderItem(context, item, phase);
+      }
+    }
+  }
+
+  if (record_statistics) {
+    meshlet_renderer_->EndStatistics(context);
   }
 }
 
@@ -58,6 +422,15 @@ Node &Scene::GetRootNode() {
   return *root_node_;
 }
 
+Node *Scene::GetSceneModel() {
+  if (scene_node_ == nullptr || scene_node_->childrens_.empty()) {
+    return nullptr;
+  }
+  // The instance of the prefab holds the nodes of the source file.
+  const auto &instance = *scene_node_->childrens_.front();
+  return instance.childrens_.empty() ? nullptr : instance.childrens_.front().get();
+}
+
 Camera &Scene::GetMainCamera() {
   VR_ASSERT(main_camera_);
   return *main_camera_;
@@ -68,8 +441,19 @@ Node &Scene::GetMainCameraNode() {
   return *main_camera_node_;
 }
 
+glm::vec3 Scene::GetMainCameraPosition() {
+  // The camera node position is applied to the view as is, the eye sits at its inverse.
+  return glm::vec3(glm::inverse(GetMainCamera().GetView())[3]);
+}
+
 void Scene::Cleanup() {
+  streamer_.Cleanup();
+  draw_list_.clear();
+  occlusion_culler_.reset();
+  meshlet_renderer_.reset();
   root_node_.reset();
+  prefabs_.clear();
+  mesh_library_.Clear();
 }
 
 }  // namespace vre::scene
\ No newline at end of file
@@ -1,10 +1,19 @@
 #pragma once
 
+#include <atomic>
+#include <map>
 #include <memory>
 #include "common.hpp"
 
+#include "geometry/occlusion_rasterizer.hpp"
+#include "rendering/meshlet_renderer.hpp"
+#include "rendering/occlusion_culler.hpp"
 #include "scene/camera.hpp"
+#include "scene/frame_snapshot.hpp"
+#include "scene/mesh_library.hpp"
 #include "scene/node.hpp"
+#include "scene/prefab.hpp"
+#include "scene/scene_streamer.hpp"
 
 namespace vre {
 
@@ -15,26 +24,99 @@ class RenderCore;
 
 namespace scene {
 
+// Node with a mesh to draw this frame.
+struct DrawItem {
+  Node *node;
+  glm::mat4 transform;
+  std::optional<rendering::MeshletDraws> meshlet_draws;
+  std::optional<rendering::OcclusionDraws> occlusion_draws;
+};
+
+// Update() runs on the simulation thread and owns the nodes, the rest of the frame runs on the render thread
+// and only sees them through the FrameSnapshot it is given. Settings can be changed from either.
 class Scene {
  public:
   void LoadFromFile();
   void CreateCamera();
   void InitializeVulkan(rendering::RenderCore &renderer);
 
-  void Update();
+  // Places streamed prefabs and writes the camera and node transforms of the next frame to |snapshot|.
+  void Update(FrameSnapshot &snapshot);
+  // Hands the current camera to the view latch of the renderer, frames recorded before still show it.
+  void PublishCameraPose();
+  // Uploads streamed meshes, nearest to the camera of |snapshot| first.
+  void UploadMeshes(const FrameSnapshot &snapshot);
+  // Picks LODs, records meshlet culling and fills the occlusion culling buffers.
+  void PrepareFrame(rendering::RenderContext &context, const FrameSnapshot &snapshot);
+  // Adds the main passes to the render graph of |context|, with occlusion culling passes around them.
   void Render(rendering::RenderContext &context);
 
   void Cleanup();
 
+  // Loads |filename| once; every instance of the returned prefab shares its meshes.
+  PrefabPtr LoadPrefab(const std::string &filename);
+  Node &Instantiate(const Prefab &prefab, Node &parent, std::string name);
+
+  // Loads |filename| in the background and places an instance under |parent| once it is decoded. Meshes
+  // are uploaded over the following frames, nearest to the camera first.
+  void StreamPrefab(const std::string &filename, Node &parent, std::string name);
+
+  // Largest screen space error, in pixels, allowed when picking mesh LODs.
+  void SetLodPixelError(float pixels) { lod_pixel_error_ = pixels; }
+
+  // Hierarchical-Z culling of whole instances against the depth of the previous frame's visible ones.
+  void SetOcclusionCulling(bool enabled) { occlusion_culling_ = enabled; }
+  [[nodiscard]] bool IsOcclusionCullingEnabled() const { return occlusion_culling_; }
+
+  // Drops instances hidden behind occluder nodes rasterized on the CPU, before any command is recorded.
+  void SetSoftwareOcclusionCulling(bool enabled) { software_occlusion_culling_ = enabled; }
+  [[nodiscard]] bool IsSoftwareOcclusionCullingEnabled() const { return software_occlusion_culling_; }
+
+  // Position storage used for meshes uploaded from now on.
+  void SetVertexFormat(rendering::VertexFormat format) { streamer_.SetVertexFormat(format); }
+
   Node &GetRootNode();
+  // First model of the scene loaded by LoadFromFile(), nullptr until it has streamed in.
+  Node *GetSceneModel();
   Camera &GetMainCamera();
   Node &GetMainCameraNode();
+  [[nodiscard]] glm::vec3 GetMainCameraPosition();
 
  private:
   Node *main_camera_node_ = nullptr;
   Camera *main_camera_ = nullptr;
 
   std::unique_ptr<Node> root_node_;
+  Node *scene_node_ = nullptr;
+
+  MeshLibrary mesh_library_;
+  std::map<std::string, PrefabPtr> prefabs_;
+
+  SceneStreamer streamer_;
+  std::atomic<float> lod_pixel_error_{1.0F};
+  rendering::RenderCore *renderer_ = nullptr;
+
+  std::unique_ptr<rendering::MeshletRenderer> meshlet_renderer_;
+  std::unique_ptr<rendering::OcclusionCuller> occlusion_culler_;
+  std::atomic<bool> occlusion_culling_{true};
+  bool occlusion_culled_ = false;
+  geometry::OcclusionRasterizer occlusion_rasterizer_;
+  std::atomic<bool> software_occlusion_culling_{false};
+  std::vector<DrawItem> draw_list_;
+
+ private:
+  [[nodiscard]] bool IsStereo() const;
+  // The camera for every view without stereo rendering.
+  [[nodiscard]] rendering::ViewUniforms GetCameraViews() const;
+  [[nodiscard]] bool UsesMeshlets() const;
+  [[nodiscard]] bool DrawsMeshTasks(const DrawItem &item) const;
+  void CullOccludedItems(const glm::mat4 &view_projection);
+  // Phase 1 is the main pass after the second occlusion culling phase, it loads what phase 0 drew.
+  void AddMainPass(rendering::RenderContext &context, uint32_t phase);
+  // |phase| 0 draws everything but the instances the second occlusion culling phase may add. With |parallel|
+  // the draw list is recorded into secondary command buffers on the job system.
+  void RenderDrawList(rendering::RenderContext &context, uint32_t phase, bool parallel);
+  static void RenderItem(rendering::RenderContext &context, const DrawItem &item, uint32_t phase);
 };
 
 }  // namespace scene
@@ -0,0 +1,150 @@
+#include "scene_streamer.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <limits>
+#include <map>
+#include <utility>
+
+#include "helpers.hpp"
+#include "platform/job_system.hpp"
+#include "rendering/render_core.hpp"
+#include "rendering/upload_batch.hpp"
+
+namespace vre::scene {
+
+namespace {
+
+glm::vec3 GetCenter(const rendering::Mesh &mesh, const glm::mat4 &transform) {
+  const auto &bounds = mesh.GetBounds();
+  return glm::vec3(transform * glm::vec4(bounds.IsValid() ? bounds.GetCenter() : glm::vec3(0.0F), 1.0F));
+}
+
+}  // namespace
+
+SceneStreamer::~SceneStreamer() {
+  Cleanup();
+}
+
+void SceneStreamer::Load(std::function<PrefabPtr()> load, Node &parent, std::string name) {
+  {
+    std::lock_guard lock(mutex_);
+    loads_in_flight_++;
+  }
+
+  platform::JobSystem::Default().Run(
+      [this, load = std::move(load), parent = &parent, name = std::move(name)]() mutable {
+        // The load has to be accounted for even when it fails, Cleanup() waits for it.
+        LoadedPrefab result{nullptr, parent, std::move(name), {}};
+        try {
+          result.prefab = load();
+          if (!result.prefab) {
+            result.error = "no prefab";
+          }
+        } catch (const std::exception &error) {
+          result.error = error.what();
+        } catch (...) {
+          result.error = "unknown error";
+        }
+
+        std::lock_guard lock(mutex_);
+        loaded_.push_back(std::move(result));
+        loads_in_flight_--;
+        loads_finished_.notify_all();
+      });
+}
+
+std::vector<SceneStreamer::LoadedPrefab> SceneStreamer::TakeLoadedPrefabs() {
+  std::lock_guard lock(mutex_);
+  return std::exchange(loaded_, {});
+}
+
+void SceneStreamer::QueueUploads(Node &node) {
+  if (node.mesh_) {
+    std::lock_guard lock(mutex_);
+    pending_uploads_.insert(node.mesh_.get());
+  }
+
+  for (auto &child : node.childrens_) {
+    QueueUploads(*child);
+  }
+}
+
+void SceneStreamer::Update(rendering::RenderCore &renderer, const FrameSnapshot &snapshot) {
+  while (!uploads_in_flight_.empty() && uploads_in_flight_.front()->IsComplete()) {
+    uploads_in_flight_.pop_front();
+  }
+
+  // Meshes shared with earlier instances are uploaded already.
+  std::map<rendering::Mesh *, float> distances;
+  {
+    std::lock_guard lock(mutex_);
+    for (auto it = pending_uploads_.begin(); it != pending_uploads_.end();) {
+      if ((*it)->IsUploaded()) {
+        it = pending_uploads_.erase(it);
+      } else {
+        distances.emplace(*it, std::numeric_limits<float>::max());
+        ++it;
+      }
+    }
+  }
+
+  if (distances.empty()) {
+    return;
+  }
+
+  // Meshes of nodes that did not make it into the snapshot yet come last.
+  for (const auto &item : snapshot.items) {
+    if (const auto it = distances.find(item.node->mesh_.get()); it != distances.end()) {
+      it->second = std::min(it->second, glm::distance(snapshot.camera_position,
+                                                      GetCenter(*item.node->mesh_, item.transform)));
+    }
+  }
+
+  std::vector<std::pair<float, rendering::Mesh *>> order;
+  order.reserve(distances.size());
+  for (const auto &[mesh, distance] : distances) {
+    order.emplace_back(distance, mesh);
+  }
+  std::sort(order.begin(), order.end());
+
+  auto batch = std::make_unique<rendering::UploadBatch>(renderer);
+  VkDeviceSize used = 0;
+  for (const auto &[distance, mesh] : order) {
+    // Cooked meshes keep the format they were cooked with.
+    if (!mesh->HasExternalGpuGeometry()) {
+      mesh->SetVertexFormat(vertex_format_);
+    }
+
+    const auto size = mesh->GetGeometrySize();
+    if (used != 0 && used + size > upload_budget_) {
+      break;
+    }
+    mesh->InitializeVulkan(renderer, *batch);
+    used += size;
+
+    std::lock_guard lock(mutex_);
+    pending_uploads_.erase(mesh);
+  }
+
+  batch->Flush();
+  uploads_in_flight_.push_back(std::move(batch));
+}
+
+bool SceneStreamer::IsIdle() const {
+  std::lock_guard lock(mutex_);
+  return loads_in_flight_ == 0 && loaded_.empty() && pending_uploads_.empty() && uploads_in_flight_.empty();
+}
+
+void SceneStreamer::Cleanup() {
+  {
+    std::unique_lock lock(mutex_);
+    loads_finished_.wait(lock, [this] { return loads_in_flight_ == 0; });
+    loaded_.clear();
+    pending_uploads_.clear();
+  }
+
+  uploads_in_flight_.clear();
+}
+
+}  // namespace vre::scene
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "common.hpp"
+#include "rendering/mesh.hpp"
+#include "scene/frame_snapshot.hpp"
+#include "scene/node.hpp"
+#include "scene/prefab.hpp"
+
+namespace vre {
+
+namespace rendering {
+class RenderCore;
+class UploadBatch;
+}  // namespace rendering
+
+namespace scene {
+
+// Loads prefabs on the job system and uploads meshes a few per frame, nearest to the camera first, so
+// the main loop keeps rendering while a scene streams in. Nodes are added once their prefab is decoded
+// and are drawn as soon as their meshes are uploaded.
+class SceneStreamer {
+ public:
+  static constexpr VkDeviceSize kDefaultUploadBudget = 8 * 1024 * 1024;
+
+  struct LoadedPrefab {
+    PrefabPtr prefab;
+    Node *parent = nullptr;
+    std::string name;
+    // Why the load failed, |prefab| is null then.
+    std::string error;
+  };
+
+  SceneStreamer() = default;
+  ~SceneStreamer();
+
+  SceneStreamer(SceneStreamer &) = delete;
+  SceneStreamer(SceneStreamer &&) = delete;
+
+  // Runs |load| on a worker thread; the result, or the failure, is returned by TakeLoadedPrefabs() to be
+  // placed under |parent| as |name|.
+  void Load(std::function<PrefabPtr()> load, Node &parent, std::string name);
+  std::vector<LoadedPrefab> TakeLoadedPrefabs();
+
+  // Queues every mesh of |node| and its children, meshes uploaded already are skipped by Update(). Called by
+  // the simulation, which owns the nodes.
+  void QueueUploads(Node &node);
+
+  // Releases finished uploads and submits queued meshes, nearest to the camera of |snapshot| first, until
+  // the per-frame byte budget is used. At least one mesh is submitted per call so large meshes still
+  // progress. Called by the render thread.
+  void Update(rendering::RenderCore &renderer, const FrameSnapshot &snapshot);
+
+  void SetUploadBudget(VkDeviceSize bytes) { upload_budget_ = bytes; }
+  void SetVertexFormat(rendering::VertexFormat format) { vertex_format_ = format; }
+  [[nodiscard]] bool IsIdle() const;
+
+  // Waits for outstanding loads and uploads.
+  void Cleanup();
+
+ private:
+  // Guards the loads and |pending_uploads_|, uploads in flight only belong to the render thread.
+  mutable std::mutex mutex_;
+  std::condition_variable loads_finished_;
+  uint32_t loads_in_flight_ = 0;
+  std::vector<LoadedPrefab> loaded_;
+
+  std::set<rendering::Mesh *> pending_uploads_;
+  std::deque<std::unique_ptr<rendering::UploadBatch>> uploads_in_flight_;
+
+  VkDeviceSize upload_budget_ = kDefaultUploadBudget;
+  rendering::VertexFormat vertex_format_ = rendering::VertexFormat::kFloat32;
+};
+
+}  // namespace scene
+}  // namespace vre
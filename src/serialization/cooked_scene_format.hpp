@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstdint>
+
+namespace vre::serialization::cooked {
+
+// Engine native scene container. Every section and geometry blob starts on a kAlignment boundary, so
+// records can be read in place from a memory mapping and blobs uploaded without repacking. All offsets
+// are relative to the start of the file.
+//
+// Meshes carry their geometry twice: float positions and 32-bit indices for CPU work (bounds, occlusion
+// rasterization) and the GPU layout of rendering::Mesh::PackGeometry(), uploaded as is.
+constexpr uint32_t kMagic = 0x43535256;  // "VRSC"
+constexpr uint32_t kVersion = 3;
+constexpr uint64_t kAlignment = 16;
+
+struct alignas(16) Header {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t node_count;
+  uint32_t mesh_count;
+
+  uint32_t primitive_count;
+  uint32_t strings_size;
+  uint64_t nodes_offset;
+
+  uint64_t meshes_offset;
+  uint64_t primitives_offset;
+
+  uint64_t strings_offset;
+  uint64_t geometry_offset;
+
+  uint64_t geometry_size;
+  uint64_t lods_offset;
+
+  uint32_t lod_count;
+  uint32_t index_section_count;
+  uint64_t index_sections_offset;
+};
+
+// Flattened depth first, a parent always precedes its children. Node 0 is the root.
+enum NodeFlags : uint32_t {
+  kNodeOccluder = 1,
+};
+
+struct alignas(16) NodeRecord {
+  float translation[3];
+  int32_t parent;
+
+  float rotation[4];  // x, y, z, w
+
+  float scale[3];
+  int32_t mesh;
+
+  uint32_t name_offset;
+  uint32_t name_size;
+  uint32_t flags;  // NodeFlags
+  uint32_t reserved;
+};
+
+struct alignas(16) MeshRecord {
+  float bounds_min[3];
+  uint32_t first_primitive;
+
+  float bounds_max[3];
+  uint32_t primitive_count;
+
+  uint64_t vertex_offset;
+  uint64_t index_offset;
+
+  uint32_t vertex_count;
+  uint32_t index_count;
+  uint32_t vertex_stride;
+  uint32_t index_size;
+
+  float dequantize_transform[16];  // Column major.
+
+  uint64_t gpu_vertex_offset;
+  uint64_t gpu_vertex_size;
+
+  uint64_t gpu_index_offset;
+  uint64_t gpu_index_size;
+
+  uint32_t vertex_format;        // rendering::VertexFormat
+  uint32_t first_index_section;  // Primitives first, then their LODs in primitive order.
+  uint32_t index_section_count;
+  uint32_t meshlet_count;
+
+  uint64_t meshlet_offset;  // rendering::GpuMeshlet records.
+  uint64_t meshlet_vertex_offset;
+
+  uint64_t meshlet_triangle_offset;
+  uint32_t meshlet_vertex_count;
+  uint32_t meshlet_triangle_size;
+};
+
+struct alignas(16) PrimitiveRecord {
+  uint32_t index_start;
+  uint32_t index_count;
+  uint32_t vertex_start;
+  uint32_t vertex_count;
+
+  int32_t material;
+  uint32_t lod_start;  // Index into the LOD section.
+  uint32_t lod_count;
+  uint32_t meshlet_start;  // Relative to the meshlets of the owning mesh.
+
+  uint32_t meshlet_count;
+  uint32_t reserved[3];
+};
+
+// Index ranges refer to the index blob of the owning mesh.
+struct alignas(16) LodRecord {
+  uint32_t index_start;
+  uint32_t index_count;
+  float error;
+  uint32_t reserved;
+};
+
+// Section of the GPU index blob of the owning mesh, with indices relative to the first primitive vertex.
+struct alignas(16) IndexSectionRecord {
+  uint64_t offset;
+  uint32_t index_size;  // 2 or 4 bytes.
+  uint32_t reserved;
+};
+
+static_assert(sizeof(Header) % kAlignment == 0);
+static_assert(sizeof(NodeRecord) % kAlignment == 0);
+static_assert(sizeof(MeshRecord) % kAlignment == 0);
+static_assert(sizeof(PrimitiveRecord) % kAlignment == 0);
+static_assert(sizeof(LodRecord) % kAlignment == 0);
+static_assert(sizeof(IndexSectionRecord) % kAlignment == 0);
+
+}  // namespace vre::serialization::cooked
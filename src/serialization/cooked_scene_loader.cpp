@@ -0,0 +1,248 @@
+#include "cooked_scene_loader.hpp"
+
+#include <vector>
+
+#include "helpers.hpp"
+#include "platform/mapped_file.hpp"
+#include "rendering/mesh.hpp"
+#include "scene/mesh_library.hpp"
+#include "scene/node.hpp"
+#include "serialization/cooked_scene_format.hpp"
+
+namespace vre::serialization {
+
+namespace {
+
+bool IsInRange(const platform::MappedFile &file, uint64_t offset, uint64_t size) {
+  return offset % cooked::kAlignment == 0 && offset <= file.GetSize() && size <= file.GetSize() - offset;
+}
+
+const cooked::Header *GetHeader(const platform::MappedFile &file) {
+  if (file.GetSize() < sizeof(cooked::Header)) {
+    return nullptr;
+  }
+
+  const auto *header = reinterpret_cast<const cooked::Header *>(file.GetData());
+  if (header->magic != cooked::kMagic || header->version != cooked::kVersion) {
+    return nullptr;
+  }
+
+  const bool valid =
+      IsInRange(file, header->nodes_offset, uint64_t(header->node_count) * sizeof(cooked::NodeRecord)) &&
+      IsInRange(file, header->meshes_offset, uint64_t(header->mesh_count) * sizeof(cooked::MeshRecord)) &&
+      IsInRange(file, header->primitives_offset,
+                uint64_t(header->primitive_count) * sizeof(cooked::PrimitiveRecord)) &&
+      IsInRange(file, header->lods_offset, uint64_t(header->lod_count) * sizeof(cooked::LodRecord)) &&
+      IsInRange(file, header->index_sections_offset,
+                uint64_t(header->index_section_count) * sizeof(cooked::IndexSectionRecord)) &&
+      IsInRange(file, header->strings_offset, header->strings_size) &&
+      IsInRange(file, header->geometry_offset, header->geometry_size) && header->node_count > 0;
+
+  return valid ? header : nullptr;
+}
+
+bool IsValidMeshlet(const cooked::MeshRecord &record, const rendering::GpuMeshlet &meshlet) {
+  return uint64_t(meshlet.vertex_offset) + meshlet.vertex_count <= record.meshlet_vertex_count &&
+         uint64_t(meshlet.triangle_offset) + uint64_t(meshlet.triangle_count) * 3 <=
+             record.meshlet_triangle_size;
+}
+
+// The GPU layout of the mesh, see rendering::Mesh::PackGeometry().
+bool LoadGpuGeometry(const platform::MappedFile &file, const cooked::Header &header,
+                     const cooked::MeshRecord &record, rendering::Mesh &mesh) {
+  if (record.vertex_format > static_cast<uint32_t>(rendering::VertexFormat::kSnorm16)) {
+    return false;
+  }
+  const auto vertex_format = static_cast<rendering::VertexFormat>(record.vertex_format);
+
+  const auto expected_section_count =
+      record.index_count != 0 ? mesh.GetPrimitives().size() + mesh.GetLods().size() : 0;
+  if (record.gpu_vertex_size != uint64_t(record.vertex_count) * rendering::GetPositionStride(vertex_format) ||
+      record.index_section_count != expected_section_count ||
+      uint64_t(record.first_index_section) + record.index_section_count > header.index_section_count ||
+      !IsInRange(file, record.gpu_vertex_offset, record.gpu_vertex_size) ||
+      !IsInRange(file, record.gpu_index_offset, record.gpu_index_size) ||
+      !IsInRange(file, record.meshlet_offset,
+                 uint64_t(record.meshlet_count) * sizeof(rendering::GpuMeshlet)) ||
+      !IsInRange(file, record.meshlet_vertex_offset,
+                 uint64_t(record.meshlet_vertex_count) * sizeof(uint32_t)) ||
+      !IsInRange(file, record.meshlet_triangle_offset, record.meshlet_triangle_size)) {
+    return false;
+  }
+
+  const auto *data = file.GetData();
+  const auto *section_records = reinterpret_cast<const cooked::IndexSectionRecord *>(
+      data + header.index_sections_offset + record.first_index_section * sizeof(cooked::IndexSectionRecord));
+  std::vector<rendering::Mesh::IndexSection> sections(record.index_section_count);
+  for (size_t i = 0; i < sections.size(); i++) {
+    const auto &section_record = section_records[i];
+    const auto &primitives = mesh.GetPrimitives();
+    const auto index_count = i < primitives.size() ? primitives[i].index_count
+                                                   : mesh.GetLods()[i - primitives.size()].index_count;
+    if ((section_record.index_size != sizeof(uint16_t) && section_record.index_size != sizeof(uint32_t)) ||
+        section_record.offset % section_record.index_size != 0 ||
+        section_record.offset > record.gpu_index_size ||
+        uint64_t(index_count) * section_record.index_size > record.gpu_index_size - section_record.offset) {
+      return false;
+    }
+
+    sections[i].offset = section_record.offset;
+    sections[i].type =
+        section_record.index_size == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+  }
+
+  rendering::GpuGeometry geometry{};
+  geometry.vertices = data + record.gpu_vertex_offset;
+  geometry.vertex_size = record.gpu_vertex_size;
+  geometry.indices = data + record.gpu_index_offset;
+  geometry.index_size = record.gpu_index_size;
+  geometry.meshlets = reinterpret_cast<const rendering::GpuMeshlet *>(data + record.meshlet_offset);
+  geometry.meshlet_count = record.meshlet_count;
+  geometry.meshlet_vertices = reinterpret_cast<const uint32_t *>(data + record.meshlet_vertex_offset);
+  geometry.meshlet_vertex_count = record.meshlet_vertex_count;
+  geometry.meshlet_triangles = data + record.meshlet_triangle_offset;
+  geometry.meshlet_triangle_size = record.meshlet_triangle_size;
+
+  for (uint32_t i = 0; i < geometry.meshlet_count; i++) {
+    if (!IsValidMeshlet(record, geometry.meshlets[i])) {
+      return false;
+    }
+  }
+
+  glm::mat4 dequantize_transform;
+  memcpy(&dequantize_transform[0][0], record.dequantize_transform, sizeof(record.dequantize_transform));
+  mesh.SetExternalGpuGeometry(vertex_format, dequantize_transform, std::move(sections), geometry);
+  return true;
+}
+
+rendering::MeshPtr LoadMesh(const std::shared_ptr<platform::MappedFile> &file, const cooked::Header &header,
+                            const cooked::MeshRecord &record) {
+  if (record.vertex_stride != sizeof(glm::vec3) || record.index_size != sizeof(uint32_t) ||
+      !IsInRange(*file, record.vertex_offset, uint64_t(record.vertex_count) * record.vertex_stride) ||
+      !IsInRange(*file, record.index_offset, uint64_t(record.index_count) * record.index_size) ||
+      uint64_t(record.first_primitive) + record.primitive_count > header.primitive_count) {
+    return nullptr;
+  }
+
+  const auto *primitive_records =
+      reinterpret_cast<const cooked::PrimitiveRecord *>(file->GetData() + header.primitives_offset);
+  const auto *lod_records = reinterpret_cast<const cooked::LodRecord *>(file->GetData() + header.lods_offset);
+
+  std::vector<rendering::Primitive> primitives;
+  std::vector<rendering::PrimitiveLod> lods;
+  primitives.reserve(record.primitive_count);
+  for (uint32_t i = 0; i < record.primitive_count; i++) {
+    const auto &primitive_record = primitive_records[record.first_primitive + i];
+    if (uint64_t(primitive_record.index_start) + primitive_record.index_count > record.index_count ||
+        uint64_t(primitive_record.vertex_start) + primitive_record.vertex_count > record.vertex_count ||
+        uint64_t(primitive_record.lod_start) + primitive_record.lod_count > header.lod_count ||
+        uint64_t(primitive_record.meshlet_start) + primitive_record.meshlet_count > record.meshlet_count) {
+      return nullptr;
+    }
+
+    auto &primitive = primitives.emplace_back();
+    primitive.index_start = primitive_record.index_start;
+    primitive.index_count = primitive_record.index_count;
+    primitive.vertex_start = primitive_record.vertex_start;
+    primitive.vertex_count = primitive_record.vertex_count;
+    primitive.material = primitive_record.material;
+    primitive.lod_start = static_cast<uint32_t>(lods.size());
+    primitive.lod_count = primitive_record.lod_count;
+    primitive.meshlet_start = primitive_record.meshlet_start;
+    primitive.meshlet_count = primitive_record.meshlet_count;
+
+    for (uint32_t lod = 0; lod < primitive_record.lod_count; lod++) {
+      const auto &lod_record = lod_records[primitive_record.lod_start + lod];
+      if (uint64_t(lod_record.index_start) + lod_record.index_count > record.index_count) {
+        return nullptr;
+      }
+      auto &primitive_lod = lods.emplace_back();
+      primitive_lod.index_start = lod_record.index_start;
+      primitive_lod.index_count = lod_record.index_count;
+      primitive_lod.error = lod_record.error;
+    }
+  }
+
+  rendering::Bounds bounds;
+  bounds.min = glm::vec3(record.bounds_min[0], record.bounds_min[1], record.bounds_min[2]);
+  bounds.max = glm::vec3(record.bounds_max[0], record.bounds_max[1], record.bounds_max[2]);
+
+  auto mesh = std::make_shared<rendering::Mesh>();
+  mesh->SetExternalGeometry(file, reinterpret_cast<const glm::vec3 *>(file->GetData() + record.vertex_offset),
+                            record.vertex_count,
+                            reinterpret_cast<const uint32_t *>(file->GetData() + record.index_offset),
+                            record.index_count, std::move(primitives), std::move(lods), bounds);
+  return LoadGpuGeometry(*file, header, record, *mesh) ? mesh : nullptr;
+}
+
+}  // namespace
+
+std::unique_ptr<scene::Node> CookedSceneLoader::LoadFromFile(const std::string &filename,
+                                                             scene::MeshLibrary &library) {
+  auto root_node = std::make_unique<scene::Node>();
+  root_node->parent = nullptr;
+
+  const auto file = platform::MappedFile::Open(filename);
+  const auto *header = file ? GetHeader(*file) : nullptr;
+  if (header == nullptr) {
+    SPDLOG_ERROR("Could not load cooked scene: {}", filename);
+    return root_node;
+  }
+
+  const auto *data = file->GetData();
+  const auto *mesh_records = reinterpret_cast<const cooked::MeshRecord *>(data + header->meshes_offset);
+  std::vector<rendering::MeshPtr> meshes(header->mesh_count);
+  for (uint32_t i = 0; i < header->mesh_count; i++) {
+    meshes[i] = library.Find(filename, static_cast<int>(i));
+    if (!meshes[i]) {
+      auto mesh = LoadMesh(file, *header, mesh_records[i]);
+      if (!mesh) {
+        SPDLOG_ERROR("Corrupted mesh {} in cooked scene: {}", i, filename);
+        continue;
+      }
+      meshes[i] = library.Add(filename, static_cast<int>(i), std::move(mesh));
+    }
+  }
+
+  const auto *node_records = reinterpret_cast<const cooked::NodeRecord *>(data + header->nodes_offset);
+  const auto *strings = reinterpret_cast<const char *>(data + header->strings_offset);
+
+  std::vector<scene::Node *> nodes(header->node_count, nullptr);
+  nodes[0] = root_node.get();
+  for (uint32_t i = 0; i < header->node_count; i++) {
+    const auto &record = node_records[i];
+
+    std::string name;
+    if (uint64_t(record.name_offset) + record.name_size <= header->strings_size) {
+      name.assign(strings + record.name_offset, record.name_size);
+    }
+
+    if (i != 0) {
+      if (record.parent < 0 || static_cast<uint32_t>(record.parent) >= i) {
+        SPDLOG_ERROR("Corrupted node {} in cooked scene: {}", i, filename);
+        break;
+      }
+      nodes[i] = &nodes[record.parent]->CreateChildNode(std::move(name));
+    } else {
+      root_node->name_ = std::move(name);
+    }
+
+    auto &node = *nodes[i];
+    node.transform_.position = glm::vec3(record.translation[0], record.translation[1], record.translation[2]);
+    node.transform_.rotation = glm::quat(record.rotation[3], record.rotation[0], record.rotation[1],
+                                         record.rotation[2]);
+    node.transform_.scale = glm::vec3(record.scale[0], record.scale[1], record.scale[2]);
+
+    if (record.mesh >= 0 && static_cast<uint32_t>(record.mesh) < header->mesh_count) {
+      node.mesh_ = meshes[record.mesh];
+      node.occluder_ = (record.flags & cooked::kNodeOccluder) != 0;
+    }
+  }
+
+  SPDLOG_INFO("Mapped cooked scene {}: {} nodes, {} meshes", filename, header->node_count,
+              header->mesh_count);
+
+  return root_node;
+}
+
+}  // namespace vre::serialization
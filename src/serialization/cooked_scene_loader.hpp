@@ -0,0 +1,22 @@
+#pragma once
+
+#include "common.hpp"
+
+namespace vre {
+
+namespace scene {
+struct Node;
+class MeshLibrary;
+}  // namespace scene
+
+namespace serialization {
+
+class CookedSceneLoader {
+ public:
+  // Maps |filename| into memory; meshes reference their geometry inside the mapping and are uploaded
+  // straight from it.
+  static std::unique_ptr<scene::Node> LoadFromFile(const std::string &filename, scene::MeshLibrary &library);
+};
+
+}  // namespace serialization
+}  // namespace vre
@@ -1,4 +1,5 @@
 #include <memory>
+#include <set>
 #include <vector>
 #include "helpers.hpp"
 #define TINYGLTF_IMPLEMENTATION
@@ -8,83 +9,302 @@
 
 #include <glm/gtc/type_ptr.hpp>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VR_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define VR_NEON
+#endif
+
 #include "gltf_loader.hpp"
+#include "platform/job_system.hpp"
 #include "rendering/mesh.hpp"
+#include "scene/mesh_library.hpp"
 #include "scene/node.hpp"
 
 namespace vre::serialization {
 
 namespace {
 
-void LoadMesh(const tinygltf::Model &model, const tinygltf::Mesh &mesh, scene::Node &node) {
-  auto new_mesh = std::make_unique<rendering::Mesh>();
+struct LoadContext {
+  const std::string &filename;
+  const tinygltf::Model &model;
+  scene::MeshLibrary &library;
+};
+
+const uint8_t *GetAccessorData(const tinygltf::Model &model, const tinygltf::Accessor &accessor,
+                               size_t &byte_stride) {
+  if (accessor.bufferView < 0) {
+    return nullptr;
+  }
+
+  const tinygltf::BufferView &view = model.bufferViews[accessor.bufferView];
+  const int stride = accessor.ByteStride(view);
+  if (stride <= 0) {
+    return nullptr;
+  }
+
+  byte_stride = static_cast<size_t>(stride);
+  return &model.buffers[view.buffer].data[accessor.byteOffset + view.byteOffset];
+}
+
+void ReadPositions(const uint8_t *data, size_t byte_stride, size_t count, glm::vec3 *out) {
+  if (byte_stride == sizeof(glm::vec3)) {
+    memcpy(out, data, count * sizeof(glm::vec3));
+    return;
+  }
+
+  for (size_t v = 0; v < count; v++) {
+    memcpy(&out[v], data + v * byte_stride, sizeof(glm::vec3));
+  }
+}
+
+void WidenIndices(const uint32_t *in, size_t count, uint32_t base, uint32_t *out) {
+  if (base == 0) {
+    memcpy(out, in, count * sizeof(uint32_t));
+    return;
+  }
+
+  size_t i = 0;
+#if defined(VR_SSE2)
+  const __m128i offset = _mm_set1_epi32(static_cast<int>(base));
+  for (; i + 4 <= count; i += 4) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_add_epi32(v, offset));
+  }
+#elif defined(VR_NEON)
+  const uint32x4_t offset = vdupq_n_u32(base);
+  for (; i + 4 <= count; i += 4) {
+    vst1q_u32(out + i, vaddq_u32(vld1q_u32(in + i), offset));
+  }
+#endif
+  for (; i < count; i++) {
+    out[i] = in[i] + base;
+  }
+}
+
+void WidenIndices(const uint16_t *in, size_t count, uint32_t base, uint32_t *out) {
+  size_t i = 0;
+#if defined(VR_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i offset = _mm_set1_epi32(static_cast<int>(base));
+  for (; i + 8 <= count; i += 8) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i),
+                     _mm_add_epi32(_mm_unpacklo_epi16(v, zero), offset));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + 4),
+                     _mm_add_epi32(_mm_unpackhi_epi16(v, zero), offset));
+  }
+#elif defined(VR_NEON)
+  const uint32x4_t offset = vdupq_n_u32(base);
+  for (; i + 8 <= count; i += 8) {
+    const uint16x8_t v = vld1q_u16(in + i);
+    vst1q_u32(out + i, vaddq_u32(vmovl_u16(vget_low_u16(v)), offset));
+    vst1q_u32(out + i + 4, vaddq_u32(vmovl_u16(vget_high_u16(v)), offset));
+  }
+#endif
+  for (; i < count; i++) {
+    out[i] = in[i] + base;
+  }
+}
+
+void WidenIndices(const uint8_t *in, size_t count, uint32_t base, uint32_t *out) {
+  size_t i = 0;
+#if defined(VR_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i offset = _mm_set1_epi32(static_cast<int>(base));
+  for (; i + 16 <= count; i += 16) {
+    const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+    const __m128i lo = _mm_unpacklo_epi8(v, zero);
+    const __m128i hi = _mm_unpackhi_epi8(v, zero);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i),
+                     _mm_add_epi32(_mm_unpacklo_epi16(lo, zero), offset));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + 4),
+                     _mm_add_epi32(_mm_unpackhi_epi16(lo, zero), offset));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + 8),
+                     _mm_add_epi32(_mm_unpacklo_epi16(hi, zero), offset));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + 12),
+                     _mm_add_epi32(_mm_unpackhi_epi16(hi, zero), offset));
+  }
+#elif defined(VR_NEON)
+  const uint32x4_t offset = vdupq_n_u32(base);
+  for (; i + 16 <= count; i += 16) {
+    const uint8x16_t v = vld1q_u8(in + i);
+    const uint16x8_t lo = vmovl_u8(vget_low_u8(v));
+    const uint16x8_t hi = vmovl_u8(vget_high_u8(v));
+    vst1q_u32(out + i, vaddq_u32(vmovl_u16(vget_low_u16(lo)), offset));
+    vst1q_u32(out + i + 4, vaddq_u32(vmovl_u16(vget_high_u16(lo)), offset));
+    vst1q_u32(out + i + 8, vaddq_u32(vmovl_u16(vget_low_u16(hi)), offset));
+    vst1q_u32(out + i + 12, vaddq_u32(vmovl_u16(vget_high_u16(hi)), offset));
+  }
+#endif
+  for (; i < count; i++) {
+    out[i] = in[i] + base;
+  }
+}
+
+struct PrimitiveAccessors {
+  const tinygltf::Accessor *positions = nullptr;
+  const tinygltf::Accessor *indices = nullptr;
+  int32_t material = -1;
+};
+
+std::optional<PrimitiveAccessors> GetPrimitiveAccessors(const tinygltf::Model &model,
+                                                        const tinygltf::Primitive &primitive) {
+  // Pipelines draw triangle lists, and welding, cache optimization and LOD generation expect them too.
+  if (primitive.mode != TINYGLTF_MODE_TRIANGLES) {
+    SPDLOG_ERROR("Primitive mode {} not supported!", primitive.mode);
+    return std::nullopt;
+  }
+
+  PrimitiveAccessors result;
+  result.material = primitive.material;
+
+  const auto position = primitive.attributes.find("POSITION");
+  VR_ASSERT(position != primitive.attributes.end());
+  result.positions = &model.accessors[position->second];
 
+  if (result.positions->componentType != TINYGLTF_PARAMETER_TYPE_FLOAT ||
+      result.positions->type != TINYGLTF_TYPE_VEC3) {
+    SPDLOG_ERROR("Position accessor {}/{} not supported!", result.positions->componentType,
+                 result.positions->type);
+    return std::nullopt;
+  }
+
+  if (primitive.indices > -1) {
+    result.indices = &model.accessors[primitive.indices];
+
+    switch (result.indices->componentType) {
+      case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT:
+      case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT:
+      case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE:
+        break;
+      default:
+        SPDLOG_ERROR("Index component type {} not supported!", result.indices->componentType);
+        return std::nullopt;
+    }
+  }
+
+  return result;
+}
+
+void ReadIndices(const tinygltf::Model &model, const tinygltf::Accessor &accessor, uint32_t base,
+                 uint32_t *out) {
+  size_t byte_stride = 0;
+  const uint8_t *data = GetAccessorData(model, accessor, byte_stride);
+  VR_CHECK(data);
+
+  switch (accessor.componentType) {
+    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT:
+      WidenIndices(reinterpret_cast<const uint32_t *>(data), accessor.count, base, out);
+      break;
+    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT:
+      WidenIndices(reinterpret_cast<const uint16_t *>(data), accessor.count, base, out);
+      break;
+    case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE:
+      WidenIndices(data, accessor.count, base, out);
+      break;
+  }
+}
+
+rendering::MeshPtr LoadMesh(const tinygltf::Model &model, const tinygltf::Mesh &mesh) {
+  auto new_mesh = std::make_shared<rendering::Mesh>();
+
+  std::vector<PrimitiveAccessors> primitives;
+  primitives.reserve(mesh.primitives.size());
+  size_t vertex_count = 0;
+  size_t index_count = 0;
   for (const auto &primitive : mesh.primitives) {
-    std::vector<glm::vec3> vertex_buffer;
-    {
-      const float *buffer_pos = nullptr;
+    if (auto accessors = GetPrimitiveAccessors(model, primitive)) {
+      vertex_count += accessors->positions->count;
+      index_count += accessors->indices ? accessors->indices->count : 0;
+      primitives.push_back(*accessors);
+    }
+  }
 
-      int pos_byte_stride;
+  new_mesh->Reserve(vertex_count, index_count);
 
-      VR_ASSERT(primitive.attributes.find("POSITION") != primitive.attributes.end());
+  for (const auto &accessors : primitives) {
+    size_t pos_byte_stride = 0;
+    const uint8_t *pos_data = GetAccessorData(model, *accessors.positions, pos_byte_stride);
+    VR_CHECK(pos_data);
 
-      const tinygltf::Accessor &pos_accessor = model.accessors[primitive.attributes.find("POSITION")->second];
-      const tinygltf::BufferView &pos_view = model.bufferViews[pos_accessor.bufferView];
-      buffer_pos = reinterpret_cast<const float *>(
-          &(model.buffers[pos_view.buffer].data[pos_accessor.byteOffset + pos_view.byteOffset]));
-      pos_byte_stride = pos_accessor.ByteStride(pos_view) != 0
-                            ? (pos_accessor.ByteStride(pos_view) / sizeof(float))
-                            : tinygltf::GetNumComponentsInType(TINYGLTF_TYPE_VEC3);
+    const auto primitive_vertex_count = static_cast<uint32_t>(accessors.positions->count);
+    const auto primitive_index_count =
+        accessors.indices ? static_cast<uint32_t>(accessors.indices->count) : 0U;
+    auto storage =
+        new_mesh->AllocatePrimitive(primitive_vertex_count, primitive_index_count, accessors.material);
 
-      for (size_t v = 0; v < pos_accessor.count; v++) {
-        vertex_buffer.push_back(glm::make_vec3(&buffer_pos[v * pos_byte_stride]));
-      }
+    ReadPositions(pos_data, pos_byte_stride, primitive_vertex_count, storage.positions);
+    if (accessors.indices) {
+      ReadIndices(model, *accessors.indices, storage.vertex_start, storage.indices);
     }
+  }
+
+  new_mesh->ComputeBounds();
 
-    std::vector<uint32_t> index_buffer;
-    if (primitive.indices > -1) {
-      const tinygltf::Accessor &accessor = model.accessors[primitive.indices > -1 ? primitive.indices : 0];
-      const tinygltf::BufferView &buffer_view = model.bufferViews[accessor.bufferView];
-      const tinygltf::Buffer &buffer = model.buffers[buffer_view.buffer];
-
-      const auto index_count = static_cast<uint32_t>(accessor.count);
-      const void *data_ptr = &(buffer.data[accessor.byteOffset + buffer_view.byteOffset]);
-
-      switch (accessor.componentType) {
-        case TINYGLTF_PARAMETER_TYPE_UNSIGNED_INT: {
-          const auto *buf = static_cast<const uint32_t *>(data_ptr);
-          for (size_t index = 0; index < index_count; index++) {
-            index_buffer.push_back(buf[index]);
-          }
-          break;
-        }
-        case TINYGLTF_PARAMETER_TYPE_UNSIGNED_SHORT: {
-          const auto *buf = static_cast<const uint16_t *>(data_ptr);
-          for (size_t index = 0; index < index_count; index++) {
-            index_buffer.push_back(buf[index]);
-          }
-          break;
-        }
-        case TINYGLTF_PARAMETER_TYPE_UNSIGNED_BYTE: {
-          const auto *buf = static_cast<const uint8_t *>(data_ptr);
-          for (size_t index = 0; index < index_count; index++) {
-            index_buffer.push_back(buf[index]);
-          }
-          break;
-        }
-        default:
-          SPDLOG_ERROR("Index component type {} not supported!", accessor.componentType);
-          return;
-      }
+  return new_mesh;
+}
+
+rendering::MeshPtr GetOrLoadMesh(const LoadContext &context, int mesh_index) {
+  if (auto mesh = context.library.Find(context.filename, mesh_index)) {
+    return mesh;
+  }
+
+  return context.library.Add(context.filename, mesh_index,
+                             LoadMesh(context.model, context.model.meshes[mesh_index]));
+}
+
+void CollectMeshes(const tinygltf::Model &model, const tinygltf::Node &node, std::set<int> &meshes) {
+  if (node.mesh > -1) {
+    meshes.insert(node.mesh);
+  }
+
+  for (const auto &child : node.children) {
+    CollectMeshes(model, model.nodes[child], meshes);
+  }
+}
+
+// Decodes every mesh of |scene| that is not interned yet across the job system, so the node pass below
+// only has to look the handles up.
+void DecodeMeshes(const LoadContext &context, const tinygltf::Scene &scene) {
+  std::set<int> referenced;
+  for (const auto &node : scene.nodes) {
+    CollectMeshes(context.model, context.model.nodes[node], referenced);
+  }
+
+  std::vector<int> missing;
+  missing.reserve(referenced.size());
+  for (const auto mesh_index : referenced) {
+    if (!context.library.Find(context.filename, mesh_index)) {
+      missing.push_back(mesh_index);
     }
+  }
+
+  std::vector<rendering::MeshPtr> decoded(missing.size());
+  std::vector<geometry::OptimizationReport> reports(missing.size());
+  platform::JobSystem::Default().ParallelFor(missing.size(), [&](size_t i) {
+    decoded[i] = LoadMesh(context.model, context.model.meshes[missing[i]]);
+    reports[i] = decoded[i]->Optimize();
+    decoded[i]->GenerateLods();
+    decoded[i]->GenerateMeshlets();
+  });
 
-    new_mesh->AddPrimitive(std::move(vertex_buffer), std::move(index_buffer));
+  geometry::OptimizationReport total{};
+  for (size_t i = 0; i < missing.size(); i++) {
+    context.library.Add(context.filename, missing[i], std::move(decoded[i]));
+    total.Add(reports[i]);
   }
 
-  node.mesh_ = std::move(new_mesh);
+  SPDLOG_INFO("Decoded {} meshes of {}", missing.size(), context.filename);
+  SPDLOG_INFO("Optimized {}: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}, {} vertices welded, {} degenerate "
+              "triangles removed",
+              context.filename, total.before.acmr, total.after.acmr, total.before.atvr, total.after.atvr,
+              total.welded_vertices, total.removed_triangles);
 }
 
-void LoadNode(scene::Node &parent, const tinygltf::Node &node, const tinygltf::Model &model) {
+void LoadNode(scene::Node &parent, const tinygltf::Node &node, const LoadContext &context) {
   auto &new_node = parent.CreateChildNode(node.name);
 
   if (node.translation.size() == 3) {
@@ -100,19 +320,22 @@ void LoadNode(scene::Node &parent, const tinygltf::Node &node, const tinygltf::M
   }
 
   for (const auto &child : node.children) {
-    LoadNode(new_node, model.nodes[child], model);
+    LoadNode(new_node, context.model.nodes[child], context);
   }
 
   // Node contains mesh data
   if (node.mesh > -1) {
-    const tinygltf::Mesh &mesh = model.meshes[node.mesh];
-    LoadMesh(model, mesh, new_node);
+    new_node.mesh_ = GetOrLoadMesh(context, node.mesh);
+    // Occluders are picked by hand with {"extras": {"occluder": true}} on the node.
+    const auto &occluder = node.extras.Get("occluder");
+    new_node.occluder_ = occluder.IsBool() && occluder.Get<bool>();
   }
 }
 
 }  // namespace
 
-std::unique_ptr<scene::Node> GLTFLoader::LoadFromFile(const std::string &filename) {
+std::unique_ptr<scene::Node> GLTFLoader::LoadFromFile(const std::string &filename,
+                                                      scene::MeshLibrary &library) {
   tinygltf::Model gltf_model;
   tinygltf::TinyGLTF gltf_context;
   std::string error;
@@ -128,10 +351,12 @@ std::unique_ptr<scene::Node> GLTFLoader::LoadFromFile(const std::string &filenam
                                   : gltf_context.LoadASCIIFromFile(&gltf_model, &error, &warning, filename);
   auto root_node = std::make_unique<scene::Node>();
   if (file_loaded) {
+    const LoadContext context{filename, gltf_model, library};
     const tinygltf::Scene &scene =
         gltf_model.scenes[gltf_model.defaultScene > -1 ? gltf_model.defaultScene : 0];
+    DecodeMeshes(context, scene);
     for (const auto &node : scene.nodes) {
-      LoadNode(*root_node, gltf_model.nodes[node], gltf_model);
+      LoadNode(*root_node, gltf_model.nodes[node], context);
     }
   } else {
     SPDLOG_ERROR("Could not load gltf file: {}", error);
@@ -6,12 +6,14 @@ namespace vre {
 
 namespace scene {
 struct Node;
-}
+class MeshLibrary;
+}  // namespace scene
 
 namespace serialization {
 class GLTFLoader {
  public:
-  static std::unique_ptr<scene::Node> LoadFromFile(const std::string &filename);
+  // Meshes are interned in |library| per (filename, mesh index), nodes reference them by handle.
+  static std::unique_ptr<scene::Node> LoadFromFile(const std::string &filename, scene::MeshLibrary &library);
 };
 
 }  // namespace serialization
@@ -0,0 +1,246 @@
+#include "scene_cooker.hpp"
+
+#include <map>
+#include <vector>
+
+#include "helpers.hpp"
+#include "platform/platform.hpp"
+#include "rendering/mesh.hpp"
+#include "scene/mesh_library.hpp"
+#include "scene/node.hpp"
+#include "serialization/cooked_scene_format.hpp"
+#include "serialization/gltf_loader.hpp"
+
+namespace vre::serialization {
+
+namespace {
+
+class BlobWriter {
+ public:
+  uint64_t Append(const void *data, size_t size) {
+    const auto offset = Align();
+    data_.resize(offset + size);
+    if (data != nullptr && size != 0) {
+      memcpy(data_.data() + offset, data, size);
+    }
+    return offset;
+  }
+
+  template <typename T>
+  uint64_t Append(const std::vector<T> &records) {
+    return Append(records.data(), records.size() * sizeof(T));
+  }
+
+  uint64_t Align() {
+    data_.resize((data_.size() + cooked::kAlignment - 1) & ~(cooked::kAlignment - 1));
+    return data_.size();
+  }
+
+  template <typename T>
+  T &At(uint64_t offset) {
+    return *reinterpret_cast<T *>(data_.data() + offset);
+  }
+
+  [[nodiscard]] const std::vector<uint8_t> &GetData() const { return data_; }
+
+ private:
+  std::vector<uint8_t> data_;
+};
+
+void Flatten(const scene::Node &node, int32_t parent, std::vector<const scene::Node *> &nodes,
+             std::vector<int32_t> &parents) {
+  const auto index = static_cast<int32_t>(nodes.size());
+  nodes.push_back(&node);
+  parents.push_back(parent);
+
+  for (const auto &child : node.childrens_) {
+    Flatten(*child, index, nodes, parents);
+  }
+}
+
+}  // namespace
+
+bool SceneCooker::Cook(const std::string &source, const std::string &output,
+                       rendering::VertexFormat vertex_format) {
+  scene::MeshLibrary library;
+  const auto root = GLTFLoader::LoadFromFile(source, library);
+  if (root->childrens_.empty()) {
+    SPDLOG_ERROR("Nothing to cook in {}", source);
+    return false;
+  }
+
+  std::vector<const scene::Node *> nodes;
+  std::vector<int32_t> parents;
+  Flatten(*root, -1, nodes, parents);
+
+  std::map<const rendering::Mesh *, int32_t> mesh_indices;
+  std::vector<rendering::Mesh *> meshes;
+  for (const auto *node : nodes) {
+    if (node->mesh_ && mesh_indices.emplace(node->mesh_.get(), static_cast<int32_t>(meshes.size())).second) {
+      meshes.push_back(node->mesh_.get());
+    }
+  }
+
+  BlobWriter writer;
+  const auto header_offset = writer.Append(nullptr, sizeof(cooked::Header));
+
+  std::string strings;
+  std::vector<cooked::NodeRecord> node_records(nodes.size());
+  for (size_t i = 0; i < nodes.size(); i++) {
+    const auto &node = *nodes[i];
+    auto &record = node_records[i];
+    record = {};
+
+    record.parent = parents[i];
+    record.mesh = node.mesh_ ? mesh_indices.at(node.mesh_.get()) : -1;
+    record.flags = node.occluder_ ? cooked::kNodeOccluder : 0;
+    for (int c = 0; c < 3; c++) {
+      record.translation[c] = node.transform_.position[c];
+      record.scale[c] = node.transform_.scale[c];
+    }
+    record.rotation[0] = node.transform_.rotation.x;
+    record.rotation[1] = node.transform_.rotation.y;
+    record.rotation[2] = node.transform_.rotation.z;
+    record.rotation[3] = node.transform_.rotation.w;
+
+    record.name_offset = static_cast<uint32_t>(strings.size());
+    record.name_size = static_cast<uint32_t>(node.name_.size());
+    strings += node.name_;
+  }
+
+  std::vector<cooked::MeshRecord> mesh_records(meshes.size());
+  std::vector<cooked::PrimitiveRecord> primitive_records;
+  std::vector<cooked::LodRecord> lod_records;
+  std::vector<cooked::IndexSectionRecord> index_section_records;
+  std::vector<rendering::GpuGeometry> gpu_geometries(meshes.size());
+  for (size_t i = 0; i < meshes.size(); i++) {
+    auto &mesh = *meshes[i];
+    auto &record = mesh_records[i];
+    record = {};
+
+    mesh.SetVertexFormat(vertex_format);
+    const auto &geometry = gpu_geometries[i] = mesh.PackGeometry();
+
+    const auto &bounds = mesh.GetBounds();
+    for (int c = 0; c < 3; c++) {
+      record.bounds_min[c] = bounds.min[c];
+      record.bounds_max[c] = bounds.max[c];
+    }
+
+    record.first_primitive = static_cast<uint32_t>(primitive_records.size());
+    record.primitive_count = static_cast<uint32_t>(mesh.GetPrimitives().size());
+    for (const auto &primitive : mesh.GetPrimitives()) {
+      auto &primitive_record = primitive_records.emplace_back();
+      primitive_record = {};
+      primitive_record.index_start = primitive.index_start;
+      primitive_record.index_count = primitive.index_count;
+      primitive_record.vertex_start = primitive.vertex_start;
+      primitive_record.vertex_count = primitive.vertex_count;
+      primitive_record.material = primitive.material;
+      primitive_record.lod_start = static_cast<uint32_t>(lod_records.size());
+      primitive_record.lod_count = primitive.lod_count;
+      primitive_record.meshlet_start = primitive.meshlet_start;
+      primitive_record.meshlet_count = primitive.meshlet_count;
+
+      for (uint32_t lod = 0; lod < primitive.lod_count; lod++) {
+        const auto &primitive_lod = mesh.GetLods()[primitive.lod_start + lod];
+        auto &lod_record = lod_records.emplace_back();
+        lod_record = {};
+        lod_record.index_start = primitive_lod.index_start;
+        lod_record.index_count = primitive_lod.index_count;
+        lod_record.error = primitive_lod.error;
+      }
+    }
+
+    record.vertex_count = mesh.GetVertexCount();
+    record.vertex_stride = sizeof(glm::vec3);
+    record.index_count = mesh.GetIndexCount();
+    record.index_size = sizeof(uint32_t);
+
+    memcpy(record.dequantize_transform, &mesh.GetDequantizeTransform()[0][0],
+           sizeof(record.dequantize_transform));
+    record.gpu_vertex_size = geometry.vertex_size;
+    record.gpu_index_size = geometry.index_size;
+    record.vertex_format = static_cast<uint32_t>(vertex_format);
+    record.meshlet_count = geometry.meshlet_count;
+    record.meshlet_vertex_count = geometry.meshlet_vertex_count;
+    record.meshlet_triangle_size = geometry.meshlet_triangle_size;
+
+    // The loader lays LODs out in primitive order, the sections have to follow it.
+    const auto &sections = mesh.GetIndexSections();
+    const auto primitive_count = mesh.GetPrimitives().size();
+    const auto add_section = [&](const rendering::Mesh::IndexSection &section) {
+      auto &section_record = index_section_records.emplace_back();
+      section_record = {};
+      section_record.offset = section.offset;
+      section_record.index_size = section.type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+    };
+
+    record.first_index_section = static_cast<uint32_t>(index_section_records.size());
+    if (!sections.empty()) {
+      for (size_t p = 0; p < primitive_count; p++) {
+        add_section(sections[p]);
+      }
+      for (const auto &primitive : mesh.GetPrimitives()) {
+        for (uint32_t lod = 0; lod < primitive.lod_count; lod++) {
+          add_section(sections[primitive_count + primitive.lod_start + lod]);
+        }
+      }
+    }
+    record.index_section_count =
+        static_cast<uint32_t>(index_section_records.size()) - record.first_index_section;
+  }
+
+  cooked::Header header{};
+  header.magic = cooked::kMagic;
+  header.version = cooked::kVersion;
+  header.node_count = static_cast<uint32_t>(node_records.size());
+  header.mesh_count = static_cast<uint32_t>(mesh_records.size());
+  header.primitive_count = static_cast<uint32_t>(primitive_records.size());
+  header.strings_size = static_cast<uint32_t>(strings.size());
+  header.lod_count = static_cast<uint32_t>(lod_records.size());
+  header.index_section_count = static_cast<uint32_t>(index_section_records.size());
+
+  header.nodes_offset = writer.Append(node_records);
+  header.meshes_offset = writer.Append(mesh_records);
+  header.primitives_offset = writer.Append(primitive_records);
+  header.lods_offset = writer.Append(lod_records);
+  header.index_sections_offset = writer.Append(index_section_records);
+  header.strings_offset = writer.Append(strings.data(), strings.size());
+
+  header.geometry_offset = writer.Align();
+  for (size_t i = 0; i < meshes.size(); i++) {
+    const auto &mesh = *meshes[i];
+    const auto &geometry = gpu_geometries[i];
+    const auto vertex_offset = writer.Append(mesh.GetPositions(), mesh.GetVertexCount() * sizeof(glm::vec3));
+    const auto index_offset = writer.Append(mesh.GetIndices(), mesh.GetIndexCount() * sizeof(uint32_t));
+    const auto gpu_vertex_offset = writer.Append(geometry.vertices, geometry.vertex_size);
+    const auto gpu_index_offset = writer.Append(geometry.indices, geometry.index_size);
+    const auto meshlet_offset =
+        writer.Append(geometry.meshlets, geometry.meshlet_count * sizeof(rendering::GpuMeshlet));
+    const auto meshlet_vertex_offset =
+        writer.Append(geometry.meshlet_vertices, geometry.meshlet_vertex_count * sizeof(uint32_t));
+    const auto meshlet_triangle_offset =
+        writer.Append(geometry.meshlet_triangles, geometry.meshlet_triangle_size);
+
+    auto &record = writer.At<cooked::MeshRecord>(header.meshes_offset + i * sizeof(cooked::MeshRecord));
+    record.vertex_offset = vertex_offset;
+    record.index_offset = index_offset;
+    record.gpu_vertex_offset = gpu_vertex_offset;
+    record.gpu_index_offset = gpu_index_offset;
+    record.meshlet_offset = meshlet_offset;
+    record.meshlet_vertex_offset = meshlet_vertex_offset;
+    record.meshlet_triangle_offset = meshlet_triangle_offset;
+  }
+  header.geometry_size = writer.Align() - header.geometry_offset;
+
+  writer.At<cooked::Header>(header_offset) = header;
+
+  platform::Platform::WriteFile(output, writer.GetData().data(), writer.GetData().size());
+  SPDLOG_INFO("Cooked {} -> {}: {} nodes, {} meshes, {} bytes", source, output, header.node_count,
+              header.mesh_count, writer.GetData().size());
+
+  return true;
+}
+
+}  // namespace vre::serialization
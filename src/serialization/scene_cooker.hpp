@@ -0,0 +1,17 @@
+#pragma once
+
+#include "common.hpp"
+
+#include "rendering/shader.hpp"
+
+namespace vre::serialization {
+
+class SceneCooker {
+ public:
+  // Converts a glTF scene into the cooked format described in cooked_scene_format.hpp, with GPU geometry
+  // packed in |vertex_format|.
+  static bool Cook(const std::string &source, const std::string &output,
+                   rendering::VertexFormat vertex_format = rendering::VertexFormat::kSnorm16);
+};
+
+}  // namespace vre::serialization